@@ -0,0 +1,96 @@
+#include "AtomicFile.h"
+
+#include <windows.h>
+
+
+// WriteFile takes a 32 bit size, so larger files go out in pieces of this many bytes.
+static const size_t maxWriteSize = 1u << 30;
+
+
+std::wstring GetTemporaryPath(const std::wstring& path)
+{
+	// The process ID keeps two runs writing the same output from sharing a temporary file. The extension keeps a
+	// temporary file left by a crash from passing for an FBX file.
+	return path + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+}
+
+
+static bool SyncFile(const std::wstring& path)
+{
+	HANDLE fileHandle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool isSynced = FlushFileBuffers(fileHandle) != 0;
+	CloseHandle(fileHandle);
+
+	return isSynced;
+}
+
+
+// Rename with the old file replaced in the same step. Write-through waits for the rename to reach the disk.
+static bool RenameIntoPlace(const std::wstring& temporaryPath, const std::wstring& path, bool isWriteThrough)
+{
+	DWORD flags = MOVEFILE_REPLACE_EXISTING;
+	if (isWriteThrough)
+		flags |= MOVEFILE_WRITE_THROUGH;
+
+	if (!MoveFileExW(temporaryPath.c_str(), path.c_str(), flags))
+	{
+		DeleteFileW(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+bool CommitTemporaryFile(const std::wstring& temporaryPath, const std::wstring& path, EFileSyncPolicy syncPolicy)
+{
+	if ((syncPolicy != eFileSyncNone) && !SyncFile(temporaryPath))
+	{
+		DeleteFileW(temporaryPath.c_str());
+		return false;
+	}
+
+	return RenameIntoPlace(temporaryPath, path, syncPolicy == eFileSyncFull);
+}
+
+
+bool PublishFile(const std::wstring& path, const void* pData, size_t size, EFileSyncPolicy syncPolicy)
+{
+	std::wstring temporaryPath = GetTemporaryPath(path);
+
+	HANDLE fileHandle = CreateFileW(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	const char* pBytes = static_cast<const char*>(pData);
+	bool isWritten = true;
+
+	while (isWritten && (size > 0))
+	{
+		DWORD chunkSize = static_cast<DWORD>((size < maxWriteSize) ? size : maxWriteSize);
+		DWORD written = 0;
+
+		isWritten = WriteFile(fileHandle, pBytes, chunkSize, &written, nullptr) && (written == chunkSize);
+		pBytes += written;
+		size -= written;
+	}
+
+	// Synced through the handle already open, rather than opening the file again as a commit would.
+	if (isWritten && (syncPolicy != eFileSyncNone))
+		isWritten = FlushFileBuffers(fileHandle) != 0;
+
+	CloseHandle(fileHandle);
+
+	if (!isWritten)
+	{
+		DeleteFileW(temporaryPath.c_str());
+		return false;
+	}
+
+	return RenameIntoPlace(temporaryPath, path, syncPolicy == eFileSyncFull);
+}
@@ -0,0 +1,282 @@
+#include "BinaryFbxArrays.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <streambuf>
+#include <thread>
+
+#include "BinaryFbxReader.h"
+
+
+// zlib, which is linked in with the FBX SDK. The SDK doesn't ship zlib's header, so the one function needed is
+// declared here.
+extern "C" int uncompress(unsigned char* pDest, unsigned long* pDestLength, const unsigned char* pSource,
+	unsigned long sourceLength);
+
+static const int zlibOk = 0;
+
+// Deflate can't shrink data by more than this, so a compressed array claiming more is corrupt.
+static const uint64_t zlibMaxRatio = 1032;
+
+// Arrays are stored as their length, encoding and stored size, each 32 bits, after the type code.
+static const uint64_t arrayHeaderSize = 1 + 3 * sizeof(uint32_t);
+
+
+// Lets the reader walk a file that is already in memory.
+class ByteBuffer : public std::streambuf
+{
+public:
+	explicit ByteBuffer(const std::vector<char>& bytes)
+	{
+		char* pStart = const_cast<char*>(bytes.data());
+		setg(pStart, pStart, pStart + bytes.size());
+	}
+
+protected:
+	pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode /*which*/) override
+	{
+		char* pBase = (direction == std::ios_base::beg) ? eback() : ((direction == std::ios_base::cur) ? gptr() : egptr());
+		if ((offset < eback() - pBase) || (offset > egptr() - pBase))
+			return pos_type(off_type(-1));
+
+		setg(eback(), pBase + offset, egptr());
+		return pos_type(gptr() - eback());
+	}
+
+	pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+	{
+		return seekoff(off_type(position), std::ios_base::beg, which);
+	}
+};
+
+
+static size_t GetElementSize(char type)
+{
+	return (type == 'b') ? 1 : (((type == 'f') || (type == 'i')) ? 4 : 8);
+}
+
+
+// Notes where every array is, without touching its elements.
+class ArrayFinder : public BinaryFbxVisitor
+{
+public:
+	explicit ArrayFinder(std::vector<SBinaryFbxArray>& arrays)
+		: mArrays(arrays)
+	{
+	}
+
+	bool BeginRecord(const SBinaryFbxRecord& record) override
+	{
+		for (const auto& property : record.properties)
+		{
+			if (!property.IsArray())
+				continue;
+
+			// The reader checks an uncompressed array's length against its stored size, but only inflating a
+			// compressed one would show it was wrong, after allocating whatever the header asked for.
+			uint64_t inflatedSize = static_cast<uint64_t>(property.arrayLength) * GetElementSize(property.type);
+			if ((property.encoding == 1) && (inflatedSize > static_cast<uint64_t>(property.size) * zlibMaxRatio))
+			{
+				if (mError.empty())
+				{
+					mError = "The " + record.name + " array at offset " + std::to_string(property.offset)
+						+ " claims more elements than its compressed data can hold";
+				}
+				continue;
+			}
+
+			SBinaryFbxArray array;
+			array.recordName = record.name;
+			array.type = property.type;
+			array.arrayLength = property.arrayLength;
+			array.isCompressed = (property.encoding == 1);
+			array.dataOffset = property.offset + arrayHeaderSize;
+			array.storedSize = static_cast<uint32_t>(property.size);
+			mArrays.push_back(std::move(array));
+		}
+
+		return true;
+	}
+
+	// Why an array can't be read, or empty if they all can.
+	const std::string& GetError() const { return mError; }
+
+private:
+	std::vector<SBinaryFbxArray>& mArrays;
+	std::string mError;
+};
+
+
+static bool InflateArray(const std::vector<char>& fileBytes, SBinaryFbxArray& array)
+{
+	const char* pStored = fileBytes.data() + array.dataOffset;
+	array.elements.resize(static_cast<size_t>(array.arrayLength) * GetElementSize(array.type));
+
+	if (!array.isCompressed)
+	{
+		memcpy(array.elements.data(), pStored, array.elements.size());
+		return true;
+	}
+
+	unsigned long inflatedSize = static_cast<unsigned long>(array.elements.size());
+	int result = uncompress(reinterpret_cast<unsigned char*>(array.elements.data()), &inflatedSize,
+		reinterpret_cast<const unsigned char*>(pStored), array.storedSize);
+
+	return (result == zlibOk) && (inflatedSize == array.elements.size());
+}
+
+
+bool ReadBinaryFbxArrays(const std::vector<char>& fileBytes, int threadCount, std::vector<SBinaryFbxArray>& arrays,
+	SBinaryFbxArrayStats& stats, std::string& error)
+{
+	auto findStart = std::chrono::steady_clock::now();
+
+	arrays.clear();
+	stats = SBinaryFbxArrayStats();
+
+	ByteBuffer buffer(fileBytes);
+	std::istream stream(&buffer);
+	BinaryFbxReader reader(stream);
+	ArrayFinder finder(arrays);
+
+	if (!reader.Read(finder))
+	{
+		error = reader.GetError();
+		return false;
+	}
+
+	if (!finder.GetError().empty())
+	{
+		error = finder.GetError();
+		return false;
+	}
+
+	// Biggest first, so one large mesh doesn't start last and leave the other threads idle.
+	std::vector<size_t> order(arrays.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order [i] = i;
+		stats.storedBytes += arrays [i].storedSize;
+		stats.inflatedBytes += static_cast<uint64_t>(arrays [i].arrayLength) * GetElementSize(arrays [i].type);
+		stats.compressedCount += arrays [i].isCompressed ? 1 : 0;
+	}
+	std::sort(order.begin(), order.end(), [&arrays](size_t a, size_t b) { return arrays [a].storedSize > arrays [b].storedSize; });
+
+	stats.arrayCount = arrays.size();
+	stats.findSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - findStart).count();
+
+	if (threadCount <= 0)
+		threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+	threadCount = (std::max)(1, (std::min)(threadCount, static_cast<int>(arrays.size())));
+	stats.threadCount = threadCount;
+
+	auto inflateStart = std::chrono::steady_clock::now();
+	std::atomic<size_t> nextArray { 0 };
+	std::atomic<size_t> failedArray { SIZE_MAX };
+
+	auto inflate = [&]()
+	{
+		for (size_t next = nextArray++; next < order.size(); next = nextArray++)
+		{
+			if (!InflateArray(fileBytes, arrays [order [next]]))
+			{
+				size_t none = SIZE_MAX;
+				failedArray.compare_exchange_strong(none, order [next]);
+			}
+		}
+	};
+
+	// The calling thread takes a share of the work as well.
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; i++)
+		threads.emplace_back(inflate);
+
+	inflate();
+
+	for (auto& thread : threads)
+		thread.join();
+
+	stats.inflateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - inflateStart).count();
+
+	if (failedArray != SIZE_MAX)
+	{
+		const SBinaryFbxArray& array = arrays [failedArray];
+		error = "Unable to inflate the " + array.recordName + " array at offset " + std::to_string(array.dataOffset);
+		return false;
+	}
+
+	return true;
+}
+
+
+bool BenchmarkArrayInflation(const std::wstring& path, int threadCount, int runs)
+{
+	std::ifstream fileStream(std::filesystem::path(path), std::ios::binary);
+	std::vector<char> fileBytes((std::istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
+	if (fileBytes.empty())
+	{
+		std::cerr << "Error: Unable to read the file for the inflation benchmark." << std::endl;
+		return false;
+	}
+
+	std::vector<SBinaryFbxArray> serialArrays, parallelArrays;
+	SBinaryFbxArrayStats stats;
+	std::vector<double> findTimes, serialTimes, parallelTimes;
+	int parallelThreads = 0;
+	std::string error;
+	bool isMatching = true;
+
+	for (int run = 0; run < runs; run++)
+	{
+		if (!ReadBinaryFbxArrays(fileBytes, 1, serialArrays, stats, error))
+		{
+			std::cerr << "Error: " << error << "." << std::endl;
+			return false;
+		}
+		findTimes.push_back(stats.findSeconds);
+		serialTimes.push_back(stats.inflateSeconds);
+
+		if (!ReadBinaryFbxArrays(fileBytes, threadCount, parallelArrays, stats, error))
+		{
+			std::cerr << "Error: " << error << "." << std::endl;
+			return false;
+		}
+		findTimes.push_back(stats.findSeconds);
+		parallelTimes.push_back(stats.inflateSeconds);
+		parallelThreads = stats.threadCount;
+
+		for (size_t i = 0; isMatching && (i < serialArrays.size()); i++)
+			isMatching = (serialArrays [i].elements == parallelArrays [i].elements);
+	}
+
+	auto report = [&stats](const char* pName, std::vector<double> times)
+	{
+		std::sort(times.begin(), times.end());
+		double median = times [times.size() / 2];
+		printf("    %-16s median %.3f s, best %.3f s, %.0f MB/s inflated\n", pName, median, times.front(),
+			(median > 0.0) ? stats.inflatedBytes / (1024.0 * 1024.0) / median : 0.0);
+	};
+
+	printf("\nArray inflation benchmark, %d run(s) of %.1f MB\n", runs, fileBytes.size() / (1024.0 * 1024.0));
+	printf("    %zu arrays, %zu compressed, %.1f MB stored, %.1f MB inflated\n", stats.arrayCount, stats.compressedCount,
+		stats.storedBytes / (1024.0 * 1024.0), stats.inflatedBytes / (1024.0 * 1024.0));
+
+	std::sort(findTimes.begin(), findTimes.end());
+	printf("    %-16s median %.3f s, best %.3f s\n", "Finding arrays", findTimes [findTimes.size() / 2], findTimes.front());
+
+	std::string parallelName = std::to_string(parallelThreads) + ((parallelThreads == 1) ? " thread, pooled" : " threads");
+	report("1 thread", serialTimes);
+	report(parallelName.c_str(), parallelTimes);
+
+	if (!isMatching)
+		printf("The arrays inflated in parallel don't match the ones inflated on one thread.\n");
+
+	return isMatching;
+}
@@ -0,0 +1,157 @@
+#include "BinaryFbxDisplay.h"
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "BinaryFbxReader.h"
+
+
+// FBX times are counted in ticks of 1/46186158000 of a second.
+static const double ticksPerSecond = 46186158000.0;
+
+
+struct SStackSummary
+{
+	std::string name;
+	int64_t localStart { 0 };
+	int64_t localStop { 0 };
+};
+
+
+// Picks out the few records the summary needs and skips over everything else, geometry included.
+class SceneSummaryVisitor : public BinaryFbxVisitor
+{
+public:
+	bool BeginRecord(const SBinaryFbxRecord& record) override
+	{
+		mPath.resize(record.depth);
+		mPath.push_back(record.name);
+
+		const std::vector<SBinaryFbxProperty>& properties = record.properties;
+		bool hasString = !properties.empty() && (properties [0].type == 'S');
+
+		switch (record.depth)
+		{
+			case 0:
+				if ((record.name == "Creator") && hasString)
+					mCreator = properties [0].GetString();
+
+				return (record.name == "FBXHeaderExtension") || (record.name == "Objects");
+
+			case 1:
+				if (IsUnder("Objects") && (properties.size() >= 3) && (properties [1].type == 'S'))
+				{
+					if ((record.name == "Model") && (properties [2].GetString() == "LimbNode"))
+						mBones.push_back(properties [1].GetObjectName());
+
+					if (record.name == "AnimationStack")
+					{
+						mStacks.push_back(SStackSummary());
+						mStacks.back().name = properties [1].GetObjectName();
+						return true;
+					}
+				}
+
+				return IsUnder("FBXHeaderExtension") && (record.name == "SceneInfo");
+
+			case 2:
+				return (record.name == "MetaData") || (record.name == "Properties70");
+
+			case 3:
+				if (IsUnder("FBXHeaderExtension") && (mPath [2] == "MetaData") && hasString)
+					mMetaData [record.name] = properties [0].GetString();
+
+				// Properties are stored as P records: the name, type, label and flags, then the values.
+				if ((record.name == "P") && (properties.size() >= 5) && hasString)
+				{
+					std::string name = properties [0].GetString();
+
+					if (IsUnder("Objects") && !mStacks.empty())
+					{
+						if ((name == "LocalStart") && (properties [4].type == 'L'))
+							mStacks.back().localStart = properties [4].integer;
+						else if ((name == "LocalStop") && (properties [4].type == 'L'))
+							mStacks.back().localStop = properties [4].integer;
+					}
+					else if (IsUnder("FBXHeaderExtension") && (properties [4].type == 'S'))
+					{
+						mSceneProperties [name] = properties [4].GetString();
+					}
+				}
+
+				return false;
+		}
+
+		return false;
+	}
+
+	void Display() const
+	{
+		printf("\n\n--------------------\nMeta-Data\n--------------------\n\n");
+		printf("    Title: %s\n", GetMetaData("Title").c_str());
+		printf("    Subject: %s\n", GetMetaData("Subject").c_str());
+		printf("    Author: %s\n", GetMetaData("Author").c_str());
+		printf("    Keywords: %s\n", GetMetaData("Keywords").c_str());
+		printf("    Revision: %s\n", GetMetaData("Revision").c_str());
+		printf("    Comment: %s\n", GetMetaData("Comment").c_str());
+		printf("    Creator: %s\n", mCreator.c_str());
+		printf("    Application: %s %s %s\n", GetSceneProperty("Original|ApplicationVendor").c_str(),
+			GetSceneProperty("Original|ApplicationName").c_str(), GetSceneProperty("Original|ApplicationVersion").c_str());
+
+		printf("\n\n--------------------\nAnimation Stacks\n--------------------\n\n");
+		for (const auto& stack : mStacks)
+		{
+			printf("    %s: %.3f s to %.3f s\n", stack.name.c_str(), stack.localStart / ticksPerSecond,
+				stack.localStop / ticksPerSecond);
+		}
+
+		printf("\n\n--------------------\nSkeleton\n--------------------\n\n");
+		for (const auto& bone : mBones)
+			printf("    %s\n", bone.c_str());
+	}
+
+private:
+	bool IsUnder(const char* pTopLevelName) const
+	{
+		return mPath [0] == pTopLevelName;
+	}
+
+	std::string GetMetaData(const std::string& name) const
+	{
+		auto entry = mMetaData.find(name);
+		return (entry == mMetaData.end()) ? std::string() : entry->second;
+	}
+
+	std::string GetSceneProperty(const std::string& name) const
+	{
+		auto entry = mSceneProperties.find(name);
+		return (entry == mSceneProperties.end()) ? std::string() : entry->second;
+	}
+
+	// The names of the records from the top level down to the one being visited.
+	std::vector<std::string> mPath;
+
+	std::string mCreator;
+	std::map<std::string, std::string> mMetaData;
+	std::map<std::string, std::string> mSceneProperties;
+	std::vector<SStackSummary> mStacks;
+	std::vector<std::string> mBones;
+};
+
+
+bool DisplayBinaryFbxFile(const std::wstring& path)
+{
+	SceneSummaryVisitor visitor;
+	std::string error;
+
+	if (!ReadBinaryFbxFile(path, visitor, error))
+	{
+		std::cerr << "Error: " << error << "." << std::endl;
+		return false;
+	}
+
+	visitor.Display();
+	return true;
+}
@@ -0,0 +1,561 @@
+#include "BinaryFbxPatch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "BinaryFbxReader.h"
+#include "ContentHash.h"
+
+
+// The FBX 2016 (7.5) layout has 64 bit record offsets; earlier files have to fit in 32 bits.
+static const uint32_t wideRecordVersion = 7500;
+
+// FBX 7 files refer to objects by ID rather than by name.
+static const uint32_t firstObjectIdVersion = 7000;
+
+// The last 16 bytes of every binary FBX file.
+static const unsigned char footerMagic [16] =
+	{ 0xf8, 0x5a, 0x8c, 0x6a, 0xde, 0xf5, 0xd9, 0x7e, 0xec, 0xe9, 0x0c, 0xe3, 0x75, 0x8f, 0x29, 0x0b };
+
+// The footer: an ID, zeros to align what follows to 16 bytes, the version, 120 zeros, then the magic.
+static const size_t footerIdSize = 16;
+static const size_t footerTrailerSize = 4 + 120 + sizeof(footerMagic);
+
+// Anything longer after the records isn't a footer this code understands.
+static const size_t maxFooterSize = 4096;
+
+static const size_t copyBufferSize = 1 << 20;
+
+
+// A property to be replaced, found by its offset in the input file.
+struct SPropertyPatch
+{
+	uint64_t offset { 0 };
+	uint64_t oldSize { 0 };
+	std::string bytes;
+
+	int64_t GetDelta() const { return static_cast<int64_t>(bytes.size()) - static_cast<int64_t>(oldSize); }
+};
+
+
+// A string property that holds a name, or something derived from it.
+struct SNameReference
+{
+	uint64_t offset { 0 };
+	std::string value;
+};
+
+
+static SPropertyPatch MakeStringPatch(const SNameReference& reference, const std::string& newValue)
+{
+	uint32_t length = static_cast<uint32_t>(newValue.size());
+
+	SPropertyPatch patch;
+	patch.offset = reference.offset;
+	patch.oldSize = 1 + sizeof(uint32_t) + reference.value.size();
+	patch.bytes = "S";
+	patch.bytes.append(reinterpret_cast<const char*>(&length), sizeof(length));
+	patch.bytes += newValue;
+
+	return patch;
+}
+
+
+// Replace a double property with zero.
+static SPropertyPatch MakeZeroPatch(uint64_t offset)
+{
+	SPropertyPatch patch;
+	patch.offset = offset;
+	patch.oldSize = 1 + sizeof(double);
+	patch.bytes = "D";
+	patch.bytes.append(sizeof(double), '\0');
+
+	return patch;
+}
+
+
+// Object names carry their class, as "name\x00\x01class". This is the class part, separator included.
+static std::string GetClassSuffix(const std::string& objectName)
+{
+	size_t separator = objectName.find(std::string("\x00\x01", 2));
+	return (separator == std::string::npos) ? std::string() : objectName.substr(separator);
+}
+
+
+// Finds the first animation stack and every record that names it, and the skeleton nodes being renamed, skipping over
+// the rest of the file.
+class NameVisitor : public BinaryFbxVisitor
+{
+public:
+	explicit NameVisitor(const SBinaryPatchRequest& request)
+		: mRequest(request)
+	{
+	}
+
+	bool BeginRecord(const SBinaryFbxRecord& record) override
+	{
+		mPath.resize(record.depth);
+		mPath.push_back(record.name);
+
+		const std::vector<SBinaryFbxProperty>& properties = record.properties;
+		const std::string& topLevelName = mPath [0];
+
+		switch (record.depth)
+		{
+			case 0:
+				return (topLevelName == "Documents") || (topLevelName == "Objects") || (topLevelName == "Takes");
+
+			case 1:
+				mIsCentring = false;
+
+				if (topLevelName == "Objects")
+				{
+					if ((properties.size() >= 3) && (properties [1].type == 'S'))
+					{
+						std::string type = properties [2].GetString();
+						if ((record.name == "Model") && ((type == "LimbNode") || (type == "Limb") || (type == "Root")))
+						{
+							std::string name = properties [1].GetObjectName();
+							skeletonNames.push_back(name);
+
+							std::string newName;
+							if (mRequest.renameSkeleton && mRequest.renameSkeleton(name, newName))
+							{
+								renamedNodes.push_back(std::make_pair(GetReference(properties [1]), newName));
+
+								// The translation is among the node's properties.
+								mIsCentring = mRequest.centredNames.count(newName) > 0;
+								return mIsCentring;
+							}
+						}
+
+						if ((record.name == "AnimationStack") && !hasStack)
+						{
+							hasStack = true;
+							stack = GetReference(properties [1]);
+						}
+					}
+
+					return false;
+				}
+
+				if (topLevelName == "Takes")
+				{
+					if (!properties.empty() && (properties [0].type == 'S'))
+						takeNames.push_back(GetReference(properties [0]));
+
+					return record.name == "Take";
+				}
+
+				return record.name == "Document";
+
+			case 2:
+				if ((topLevelName == "Takes") && (record.name == "FileName") && !properties.empty() && (properties [0].type == 'S'))
+					takeFileNames.push_back(GetReference(properties [0]));
+
+				return ((topLevelName == "Documents") || ((topLevelName == "Objects") && mIsCentring)) && (record.name == "Properties70");
+
+			case 3:
+				if ((record.name != "P") || (properties.size() < 5) || (properties [0].type != 'S'))
+					return false;
+
+				if ((topLevelName == "Documents") && (properties [4].type == 'S') && (properties [0].GetString() == "ActiveAnimStackName"))
+					takeNames.push_back(GetReference(properties [4]));
+
+				// Translations are stored as three doubles after the name, type, label and flags.
+				if ((topLevelName == "Objects") && (properties [0].GetString() == "Lcl Translation"))
+				{
+					if ((properties.size() == 7) && (properties [4].type == 'D') && (properties [6].type == 'D'))
+					{
+						centredOffsets.push_back(properties [4].offset);
+						centredOffsets.push_back(properties [6].offset);
+					}
+					else
+					{
+						hasUnknownTranslation = true;
+					}
+				}
+
+				return false;
+		}
+
+		return false;
+	}
+
+	bool hasStack { false };
+	SNameReference stack;
+
+	// Takes, the current take and the active stack all hold the plain name; take file names add ".tak".
+	std::vector<SNameReference> takeNames;
+	std::vector<SNameReference> takeFileNames;
+
+	std::vector<std::string> skeletonNames;
+
+	// The names of the skeleton nodes being renamed, and their new names.
+	std::vector<std::pair<SNameReference, std::string>> renamedNodes;
+
+	// The X and Z translations of the nodes being centred, and whether any were stored in a way that can't be patched.
+	std::vector<uint64_t> centredOffsets;
+	bool hasUnknownTranslation { false };
+
+private:
+	static SNameReference GetReference(const SBinaryFbxProperty& property)
+	{
+		SNameReference reference;
+		reference.offset = property.offset;
+		reference.value = property.GetString();
+		return reference;
+	}
+
+	const SBinaryPatchRequest& mRequest;
+	std::vector<std::string> mPath;
+
+	// Set while visiting a renamed node whose translation is to be centred.
+	bool mIsCentring { false };
+};
+
+
+// Copies a binary FBX file record by record, swapping in the patched properties and moving every end offset by the
+// change in length before it. Every byte of the input is read once and in order, so it is hashed on the way.
+class PatchWriter
+{
+public:
+	PatchWriter(std::istream& input, std::ostream& output, const std::vector<SPropertyPatch>& patches, uint32_t version)
+		: mInput(input), mOutput(output), mPatches(patches), mIsWide(version >= wideRecordVersion), mBuffer(copyBufferSize)
+	{
+		// A skeleton rename patches hundreds of names, and every record asks how much moved before it.
+		mDeltasBefore.reserve(patches.size() + 1);
+		mDeltasBefore.push_back(0);
+		for (const auto& patch : patches)
+			mDeltasBefore.push_back(mDeltasBefore.back() + patch.GetDelta());
+	}
+
+	bool Write(uint64_t headerSize)
+	{
+		return Copy(headerSize) && WriteRecordList(UINT64_MAX) && WriteFooter();
+	}
+
+	// The hash of the whole input, if Write copied all of it.
+	bool GetInputHash(uint64_t& hash)
+	{
+		if (mInput.peek() != std::char_traits<char>::eof())
+			return false;
+
+		hash = mInputHash.Finish();
+		return true;
+	}
+
+	std::string error;
+
+private:
+	bool WriteRecordList(uint64_t listEnd)
+	{
+		const size_t fieldSize = mIsWide ? sizeof(uint64_t) : sizeof(uint32_t);
+
+		while (mPosition < listEnd)
+		{
+			uint64_t fields [3] = { 0, 0, 0 };
+			uint8_t nameLength = 0;
+
+			for (uint64_t& field : fields)
+			{
+				if (!Read(reinterpret_cast<char*>(&field), fieldSize))
+					return Fail("The file ends part way through a record");
+			}
+			if (!Read(reinterpret_cast<char*>(&nameLength), sizeof(nameLength)))
+				return Fail("The file ends part way through a record");
+
+			uint64_t recordStart = mPosition;
+			mPosition += 3 * fieldSize + sizeof(nameLength);
+
+			uint64_t endOffset = fields [0];
+			uint64_t propertyListSize = fields [2];
+			uint64_t propertyStart = mPosition + nameLength;
+
+			// The empty record closing the list has no offsets to move.
+			if (endOffset != 0)
+			{
+				if ((endOffset <= mPosition) || (nameLength + propertyListSize > endOffset - mPosition))
+					return Fail("Damaged record at offset " + std::to_string(recordStart));
+
+				fields [0] = endOffset + GetDeltaBetween(0, endOffset);
+				fields [2] = propertyListSize + GetDeltaBetween(propertyStart, propertyStart + propertyListSize);
+
+				if (!mIsWide && ((fields [0] > UINT32_MAX) || (fields [2] > UINT32_MAX)))
+					return Fail("The renamed file would be too large for its FBX version");
+			}
+
+			for (uint64_t field : fields)
+				mOutput.write(reinterpret_cast<const char*>(&field), fieldSize);
+			mOutput.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+
+			if (endOffset == 0)
+				return true;
+
+			if (!Copy(propertyStart + propertyListSize))
+				return false;
+
+			// Whatever is left before the end offset is the list of children.
+			if ((mPosition < endOffset) && !WriteRecordList(endOffset))
+				return false;
+
+			if (!Copy(endOffset))
+				return false;
+		}
+
+		return true;
+	}
+
+	// The zeros before the version keep it aligned to 16 bytes, so their number changes with the file's length.
+	bool WriteFooter()
+	{
+		std::string footer(maxFooterSize + 1, '\0');
+		Read(footer.data(), footer.size());
+		footer.resize(static_cast<size_t>(mInput.gcount()));
+
+		int64_t delta = GetDeltaBetween(0, UINT64_MAX);
+		size_t zeroCount = 0;
+		bool isFooter = (footer.size() <= maxFooterSize) && (footer.size() > footerIdSize + footerTrailerSize)
+			&& (memcmp(footer.data() + footer.size() - sizeof(footerMagic), footerMagic, sizeof(footerMagic)) == 0);
+
+		if (isFooter)
+		{
+			zeroCount = footer.size() - footerIdSize - footerTrailerSize;
+			isFooter = std::all_of(footer.begin() + footerIdSize, footer.begin() + footerIdSize + zeroCount, [](char c) { return c == 0; });
+		}
+
+		if (!isFooter)
+		{
+			if (delta % 16 != 0)
+				return Fail("The file's footer isn't understood");
+
+			mOutput.write(footer.data(), footer.size());
+			return true;
+		}
+
+		// The same alignment at the new length. The FBX SDK writes four zeros and then from 1 to 16 more, so 5 to 20.
+		int64_t newZeroCount = static_cast<int64_t>(zeroCount) - (((delta % 16) + 16) % 16);
+		while (newZeroCount < 5)
+			newZeroCount += 16;
+
+		mOutput.write(footer.data(), footerIdSize);
+		mOutput.write(std::string(static_cast<size_t>(newZeroCount), '\0').data(), newZeroCount);
+		mOutput.write(footer.data() + footer.size() - footerTrailerSize, footerTrailerSize);
+
+		return true;
+	}
+
+	// Copy up to an offset in the input, replacing any patched properties on the way.
+	bool Copy(uint64_t endOffset)
+	{
+		while ((mNextPatch < mPatches.size()) && (mPatches [mNextPatch].offset < endOffset))
+		{
+			const SPropertyPatch& patch = mPatches [mNextPatch++];
+			if ((patch.offset < mPosition) || !CopyBytes(patch.offset - mPosition) || !SkipBytes(patch.oldSize))
+				return Fail("A renamed record overlaps another");
+
+			mOutput.write(patch.bytes.data(), patch.bytes.size());
+		}
+
+		return (endOffset >= mPosition) && CopyBytes(endOffset - mPosition);
+	}
+
+	bool CopyBytes(uint64_t size)
+	{
+		while (size > 0)
+		{
+			size_t chunkSize = static_cast<size_t>((std::min)(size, static_cast<uint64_t>(mBuffer.size())));
+			if (!Read(mBuffer.data(), chunkSize))
+				return Fail("The file ends part way through a record");
+
+			mOutput.write(mBuffer.data(), chunkSize);
+			mPosition += chunkSize;
+			size -= chunkSize;
+		}
+
+		return true;
+	}
+
+	// Skipped bytes are still read, so they make it into the hash.
+	bool SkipBytes(uint64_t size)
+	{
+		while (size > 0)
+		{
+			size_t chunkSize = static_cast<size_t>((std::min)(size, static_cast<uint64_t>(mBuffer.size())));
+			if (!Read(mBuffer.data(), chunkSize))
+				return false;
+
+			mPosition += chunkSize;
+			size -= chunkSize;
+		}
+
+		return true;
+	}
+
+	// Every read of the input goes through here. A short read hashes what it got.
+	bool Read(char* pData, size_t size)
+	{
+		mInput.read(pData, static_cast<std::streamsize>(size));
+		mInputHash.Update(pData, static_cast<size_t>(mInput.gcount()));
+
+		return static_cast<bool>(mInput);
+	}
+
+	// The change in length from the patches between two offsets in the input.
+	int64_t GetDeltaBetween(uint64_t start, uint64_t end) const
+	{
+		return GetDeltaBefore(end) - GetDeltaBefore(start);
+	}
+
+	// The change in length from the patches before an offset. The patches are sorted by offset.
+	int64_t GetDeltaBefore(uint64_t offset) const
+	{
+		auto next = std::lower_bound(mPatches.begin(), mPatches.end(), offset,
+			[](const SPropertyPatch& patch, uint64_t value) { return patch.offset < value; });
+
+		return mDeltasBefore [next - mPatches.begin()];
+	}
+
+	bool Fail(const std::string& message)
+	{
+		if (error.empty())
+			error = message;
+
+		return false;
+	}
+
+	std::istream& mInput;
+	std::ostream& mOutput;
+	const std::vector<SPropertyPatch>& mPatches;
+	bool mIsWide;
+	std::vector<char> mBuffer;
+	std::vector<int64_t> mDeltasBefore;
+	ContentHash mInputHash;
+	uint64_t mPosition { 0 };
+	size_t mNextPatch { 0 };
+};
+
+
+// Names are stored with a 32 bit length and no terminator, so anything but a null will do.
+static bool IsStorableName(const std::string& name)
+{
+	return name.find('\0') == std::string::npos;
+}
+
+
+EBinaryPatchResult PatchBinaryFbxNames(const std::wstring& inputPath, const std::wstring& outputPath,
+	const SBinaryPatchRequest& request, EFileSyncPolicy syncPolicy, SBinaryPatchInfo& info)
+{
+	if (request.animationName.empty() || !IsStorableName(request.animationName))
+	{
+		info.reason = "The new names can't be stored as they are";
+		return eBinaryPatchUnsupported;
+	}
+
+	std::ifstream inputStream(std::filesystem::path(inputPath), std::ios::binary);
+	if (!inputStream)
+	{
+		info.reason = "Unable to open the file";
+		return eBinaryPatchFailed;
+	}
+
+	// Find everything that carries the names before writing anything.
+	NameVisitor visitor(request);
+	BinaryFbxReader reader(inputStream);
+	if (!reader.Read(visitor))
+	{
+		info.reason = reader.GetError();
+		return eBinaryPatchUnsupported;
+	}
+
+	// Older files also name objects in their connections and takes.
+	if (reader.GetVersion() < firstObjectIdVersion)
+	{
+		info.reason = "The file is older than FBX 7";
+		return eBinaryPatchUnsupported;
+	}
+
+	if (!visitor.hasStack)
+	{
+		info.reason = "The file has no animation stack";
+		return eBinaryPatchUnsupported;
+	}
+
+	// Node names are only known once a rule has been applied to each.
+	bool isStorable = std::all_of(visitor.renamedNodes.begin(), visitor.renamedNodes.end(),
+		[](const std::pair<SNameReference, std::string>& node) { return IsStorableName(node.second); });
+	if (!isStorable)
+	{
+		info.reason = "The new names can't be stored as they are";
+		return eBinaryPatchUnsupported;
+	}
+
+	if (visitor.hasUnknownTranslation)
+	{
+		info.reason = "A node to be centred has a translation that can't be patched";
+		return eBinaryPatchUnsupported;
+	}
+
+	std::string stackName = visitor.stack.value;
+	std::string newName = request.animationName;
+	std::string classSuffix = GetClassSuffix(stackName);
+	info.oldName = stackName.substr(0, stackName.size() - classSuffix.size());
+	info.skeletonNames = visitor.skeletonNames;
+	info.renamedNodeCount = static_cast<int>(visitor.renamedNodes.size());
+
+	std::vector<SPropertyPatch> patches;
+	patches.push_back(MakeStringPatch(visitor.stack, newName + classSuffix));
+
+	for (const auto& reference : visitor.takeNames)
+	{
+		if (reference.value == info.oldName)
+			patches.push_back(MakeStringPatch(reference, newName));
+	}
+
+	for (const auto& reference : visitor.takeFileNames)
+	{
+		if (reference.value == info.oldName + ".tak")
+			patches.push_back(MakeStringPatch(reference, newName + ".tak"));
+	}
+
+	for (const auto& node : visitor.renamedNodes)
+		patches.push_back(MakeStringPatch(node.first, node.second + GetClassSuffix(node.first.value)));
+
+	for (uint64_t offset : visitor.centredOffsets)
+		patches.push_back(MakeZeroPatch(offset));
+
+	std::sort(patches.begin(), patches.end(), [](const SPropertyPatch& a, const SPropertyPatch& b) { return a.offset < b.offset; });
+
+	// Second pass: stream the file through to a temporary file beside the output.
+	inputStream.clear();
+	inputStream.seekg(0);
+
+	std::wstring temporaryPath = GetTemporaryPath(outputPath);
+	std::ofstream outputStream(std::filesystem::path(temporaryPath), std::ios::binary | std::ios::trunc);
+
+	PatchWriter writer(inputStream, outputStream, patches, reader.GetVersion());
+	bool isWritten = outputStream && writer.Write(binaryFbxHeaderSize);
+	info.hasContentHash = isWritten && writer.GetInputHash(info.contentHash);
+	outputStream.close();
+	inputStream.close();
+
+	if (!isWritten || !outputStream)
+	{
+		std::error_code error;
+		std::filesystem::remove(temporaryPath, error);
+
+		info.reason = writer.error.empty() ? "Unable to write the output file" : writer.error;
+		return writer.error.empty() ? eBinaryPatchFailed : eBinaryPatchUnsupported;
+	}
+
+	if (!CommitTemporaryFile(temporaryPath, outputPath, syncPolicy))
+	{
+		info.reason = "Unable to replace the output file";
+		return eBinaryPatchFailed;
+	}
+
+	return eBinaryPatchApplied;
+}
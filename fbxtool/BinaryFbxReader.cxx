@@ -0,0 +1,334 @@
+#include "BinaryFbxReader.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+
+// "Kaydara FBX Binary", two spaces, a null, then 0x1A and another null, followed by the version.
+static const char binaryFbxMagic [] = "Kaydara FBX Binary  \0\x1a";
+static const size_t binaryFbxMagicSize = sizeof(binaryFbxMagic);
+
+// FBX 2016 (7.5) widened the record offsets and sizes to 64 bits.
+static const uint32_t wideRecordVersion = 7500;
+
+// Real files nest a handful of levels deep; anything past this is damage, not data.
+static const int maxRecordDepth = 128;
+
+
+bool SBinaryFbxProperty::IsArray() const
+{
+	return (type == 'f') || (type == 'd') || (type == 'l') || (type == 'i') || (type == 'b');
+}
+
+
+std::string SBinaryFbxProperty::GetString() const
+{
+	return std::string(pData ? pData : "", size);
+}
+
+
+std::string SBinaryFbxProperty::GetObjectName() const
+{
+	std::string text = GetString();
+	size_t separator = text.find(std::string("\x00\x01", 2));
+
+	return (separator == std::string::npos) ? text : text.substr(0, separator);
+}
+
+
+BinaryFbxReader::BinaryFbxReader(std::istream& stream)
+	: mStream(stream)
+{
+}
+
+
+bool BinaryFbxReader::Read(BinaryFbxVisitor& visitor)
+{
+	mError.clear();
+	mPosition = 0;
+
+	// Records are checked against the size of the file when it can be found. A pipe relies on the final empty
+	// record to end the file instead.
+	uint64_t fileSize = UINT64_MAX;
+	std::istream::pos_type start = mStream.tellg();
+	if ((start != std::istream::pos_type(-1)) && mStream.seekg(0, std::ios::end))
+	{
+		fileSize = static_cast<uint64_t>(mStream.tellg() - start);
+		mStream.seekg(start);
+	}
+	mStream.clear();
+
+	return ReadHeader() && ReadRecordList(visitor, 0, fileSize);
+}
+
+
+bool BinaryFbxReader::ReadHeader()
+{
+	char magic [binaryFbxMagicSize];
+	if (!mStream.read(magic, binaryFbxMagicSize) || (memcmp(magic, binaryFbxMagic, binaryFbxMagicSize) != 0))
+		return Fail("Not a binary FBX file");
+
+	mPosition = binaryFbxMagicSize;
+	return ReadBytes(&mVersion, sizeof(mVersion));
+}
+
+
+bool BinaryFbxReader::ReadRecordList(BinaryFbxVisitor& visitor, int depth, uint64_t listEnd)
+{
+	if (depth > maxRecordDepth)
+		return Fail("Records are nested too deeply");
+
+	SBinaryFbxRecord record;
+	record.depth = depth;
+
+	while (mPosition < listEnd)
+	{
+		uint64_t recordStart = mPosition;
+		uint64_t endOffset, propertyCount, propertyListSize;
+		uint8_t nameLength;
+
+		if (mVersion >= wideRecordVersion)
+		{
+			uint64_t fields [3];
+			if (!ReadBytes(fields, sizeof(fields)))
+				return false;
+
+			endOffset = fields [0];
+			propertyCount = fields [1];
+			propertyListSize = fields [2];
+		}
+		else
+		{
+			uint32_t fields [3];
+			if (!ReadBytes(fields, sizeof(fields)))
+				return false;
+
+			endOffset = fields [0];
+			propertyCount = fields [1];
+			propertyListSize = fields [2];
+		}
+
+		if (!ReadBytes(&nameLength, sizeof(nameLength)))
+			return false;
+
+		// A record of zeros ends the list.
+		if (endOffset == 0)
+			return true;
+
+		if ((endOffset <= mPosition) || (endOffset > listEnd) || (nameLength + propertyListSize > endOffset - mPosition))
+			return Fail("Damaged record at offset " + std::to_string(recordStart));
+
+		record.offset = recordStart;
+		record.endOffset = endOffset;
+		record.name.resize(nameLength);
+		mPayload.resize(static_cast<size_t>(propertyListSize));
+
+		if (!ReadBytes(record.name.data(), nameLength))
+			return false;
+
+		uint64_t payloadOffset = mPosition;
+		if (!ReadBytes(mPayload.data(), mPayload.size()))
+			return false;
+
+		if (!ParseProperties(record, propertyCount, payloadOffset))
+			return Fail("Damaged properties in the " + record.name + " record at offset " + std::to_string(recordStart));
+
+		bool isVisitingChildren = visitor.BeginRecord(record);
+
+		// Whatever is left before the end offset is the list of children.
+		if (mPosition < endOffset)
+		{
+			if (isVisitingChildren && !ReadRecordList(visitor, depth + 1, endOffset))
+				return false;
+
+			if (!SkipTo(endOffset))
+				return false;
+		}
+
+		visitor.EndRecord(record.name, depth);
+	}
+
+	// Lists of children may run up to their parent's end, but the file always closes with an empty record.
+	if (depth == 0)
+		return Fail("The file ends before its last record");
+
+	return true;
+}
+
+
+bool BinaryFbxReader::ParseProperties(SBinaryFbxRecord& record, uint64_t propertyCount, uint64_t payloadOffset)
+{
+	const char* pCursor = mPayload.data();
+	size_t remaining = mPayload.size();
+
+	auto take = [&](void* pValue, size_t size)
+	{
+		if (size > remaining)
+			return false;
+
+		memcpy(pValue, pCursor, size);
+		pCursor += size;
+		remaining -= size;
+		return true;
+	};
+
+	auto skip = [&](SBinaryFbxProperty& property, size_t size)
+	{
+		if (size > remaining)
+			return false;
+
+		property.pData = pCursor;
+		property.size = size;
+		pCursor += size;
+		remaining -= size;
+		return true;
+	};
+
+	// Every property takes at least two bytes, which bounds the count before anything is allocated for it.
+	if (propertyCount > remaining / 2)
+		return false;
+
+	record.properties.clear();
+	record.properties.reserve(static_cast<size_t>(propertyCount));
+
+	for (uint64_t i = 0; i < propertyCount; i++)
+	{
+		SBinaryFbxProperty property;
+		property.offset = payloadOffset + static_cast<uint64_t>(pCursor - mPayload.data());
+		if (!take(&property.type, 1))
+			return false;
+
+		bool isRead = false;
+		switch (property.type)
+		{
+			case 'Y':
+			{
+				int16_t value = 0;
+				isRead = take(&value, sizeof(value));
+				property.integer = value;
+				break;
+			}
+
+			case 'C':
+			{
+				uint8_t value = 0;
+				isRead = take(&value, sizeof(value));
+				property.integer = value;
+				break;
+			}
+
+			case 'I':
+			{
+				int32_t value = 0;
+				isRead = take(&value, sizeof(value));
+				property.integer = value;
+				break;
+			}
+
+			case 'L':
+				isRead = take(&property.integer, sizeof(property.integer));
+				break;
+
+			case 'F':
+			{
+				float value = 0.0f;
+				isRead = take(&value, sizeof(value));
+				property.number = value;
+				break;
+			}
+
+			case 'D':
+				isRead = take(&property.number, sizeof(property.number));
+				break;
+
+			case 'S':
+			case 'R':
+			{
+				uint32_t length = 0;
+				isRead = take(&length, sizeof(length)) && skip(property, length);
+				break;
+			}
+
+			case 'f':
+			case 'd':
+			case 'l':
+			case 'i':
+			case 'b':
+			{
+				uint32_t storedSize = 0;
+				isRead = take(&property.arrayLength, sizeof(property.arrayLength)) && take(&property.encoding, sizeof(property.encoding))
+					&& take(&storedSize, sizeof(storedSize)) && skip(property, storedSize);
+
+				// Uncompressed arrays must hold exactly their elements.
+				size_t elementSize = (property.type == 'b') ? 1 : (((property.type == 'f') || (property.type == 'i')) ? 4 : 8);
+				if ((property.encoding > 1) || ((property.encoding == 0) && (storedSize != uint64_t(property.arrayLength) * elementSize)))
+					isRead = false;
+				break;
+			}
+		}
+
+		if (!isRead)
+			return false;
+
+		record.properties.push_back(property);
+	}
+
+	return remaining == 0;
+}
+
+
+bool BinaryFbxReader::ReadBytes(void* pData, size_t size)
+{
+	if (!mStream.read(static_cast<char*>(pData), size))
+		return Fail("The file ends part way through a record");
+
+	mPosition += size;
+	return true;
+}
+
+
+bool BinaryFbxReader::SkipTo(uint64_t offset)
+{
+	if (offset < mPosition)
+		return Fail("Damaged record ending at offset " + std::to_string(offset));
+
+	// Seek past what is skipped where the stream allows it, and read through it where it doesn't.
+	uint64_t distance = offset - mPosition;
+	if ((distance > 0) && !mStream.seekg(static_cast<std::streamoff>(distance), std::ios::cur))
+	{
+		mStream.clear();
+		mStream.ignore(static_cast<std::streamsize>(distance));
+		if (static_cast<uint64_t>(mStream.gcount()) != distance)
+			return Fail("The file ends part way through a record");
+	}
+
+	mPosition = offset;
+	return true;
+}
+
+
+bool BinaryFbxReader::Fail(const std::string& message)
+{
+	if (mError.empty())
+		mError = message;
+
+	return false;
+}
+
+
+bool ReadBinaryFbxFile(const std::wstring& path, BinaryFbxVisitor& visitor, std::string& error)
+{
+	std::ifstream fileStream(std::filesystem::path(path), std::ios::binary);
+	if (!fileStream)
+	{
+		error = "Unable to open the file";
+		return false;
+	}
+
+	BinaryFbxReader reader(fileStream);
+	bool isRead = reader.Read(visitor);
+	error = reader.GetError();
+
+	return isRead;
+}
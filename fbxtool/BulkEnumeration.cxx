@@ -0,0 +1,222 @@
+#include "BulkEnumeration.h"
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <windows.h>
+
+
+// Directories waiting to be listed, shared by the scanning threads. The scan is over once nothing is queued and no
+// thread is still listing a directory that might add more.
+struct SDirectoryQueue
+{
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::filesystem::path> directories;
+	int busyThreads { 0 };
+};
+
+
+static bool IsFbxFile(const std::filesystem::path& path)
+{
+	return lstrcmpiW(path.extension().wstring().c_str(), L".FBX") == 0;
+}
+
+
+static std::wstring GetOutputPath(const std::wstring& inputPath, const std::wstring& inputRootPath, const std::wstring& outputRootPath)
+{
+	std::wstring outputPath = inputPath;
+	outputPath.replace(0, inputRootPath.size(), outputRootPath);
+
+	return outputPath;
+}
+
+
+// A path made absolute with any links resolved, or just tidied up if the file system can't be asked.
+static std::filesystem::path GetNormalPath(const std::filesystem::path& path)
+{
+	std::error_code error;
+	std::filesystem::path normalPath = std::filesystem::weakly_canonical(path, error);
+
+	return error ? path.lexically_normal() : normalPath;
+}
+
+
+// The part of a listed path below the input root, compared a component at a time and ignoring case, as Windows does.
+// Fails for a path outside the root, including one that only shares the start of its name, or one that still climbs
+// out with "..", so its output can't land outside the output root.
+static bool GetPathBelowRoot(const std::filesystem::path& inputPath, const std::filesystem::path& inputRootPath,
+	std::filesystem::path& relativePath)
+{
+	std::filesystem::path normalPath = GetNormalPath(inputPath);
+	std::filesystem::path normalRootPath = GetNormalPath(inputRootPath);
+
+	auto component = normalPath.begin();
+	for (const auto& rootComponent : normalRootPath)
+	{
+		// A root given with a trailing separator ends in an empty component.
+		if (rootComponent.empty())
+			continue;
+
+		if ((component == normalPath.end()) || (lstrcmpiW(component->wstring().c_str(), rootComponent.wstring().c_str()) != 0))
+			return false;
+
+		++component;
+	}
+
+	relativePath.clear();
+	for (; component != normalPath.end(); ++component)
+	{
+		if (*component == L"..")
+			return false;
+
+		relativePath /= *component;
+	}
+
+	return !relativePath.empty();
+}
+
+
+static void ListDirectory(const std::filesystem::path& directory, SDirectoryQueue& queue, const std::wstring& inputRootPath,
+	const std::wstring& outputRootPath, const BulkFileVisitor& visitor)
+{
+	std::error_code error;
+	std::filesystem::directory_iterator entries(directory, std::filesystem::directory_options::skip_permission_denied, error);
+	if (error)
+	{
+		std::wcerr << L"Unable to list " << directory.wstring() << std::endl;
+		return;
+	}
+
+	// The non-throwing increment, so a directory that vanishes or a share that drops mid-listing can't take down a
+	// scan thread, and with it the whole run.
+	std::error_code listError;
+	for (; entries != std::filesystem::directory_iterator(); entries.increment(listError))
+	{
+		const std::filesystem::directory_entry& entry = *entries;
+
+		// Links to directories are not followed, so a link back up the tree can't send the scan round in circles.
+		if (entry.is_directory(error) && !entry.is_symlink(error))
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.directories.push_back(entry.path());
+			queue.changed.notify_one();
+		}
+		else if (IsFbxFile(entry.path()))
+		{
+			// The listing already carries the size on Windows, so this costs no extra round trip.
+			uintmax_t fileSize = entry.file_size(error);
+			std::wstring inputPath = entry.path().wstring();
+
+			visitor({ inputPath, GetOutputPath(inputPath, inputRootPath, outputRootPath), error ? 0 : fileSize });
+		}
+	}
+
+	// A failed step ends the listing; the files found so far are kept and the rest of the directory is skipped.
+	if (listError)
+		std::wcerr << L"Unable to finish listing " << directory.wstring() << std::endl;
+}
+
+
+void EnumerateBulkDirectory(const std::wstring& inputRootPath, const std::wstring& outputRootPath, int threadCount,
+	BulkFileVisitor visitor)
+{
+	std::error_code error;
+	if (!std::filesystem::is_directory(inputRootPath, error))
+	{
+		std::wcerr << L"Folder not found: " << inputRootPath << std::endl;
+		return;
+	}
+
+	SDirectoryQueue queue;
+	queue.directories.push_back(std::filesystem::path(inputRootPath));
+
+	auto scan = [&]()
+	{
+		for (;;)
+		{
+			std::filesystem::path directory;
+			{
+				std::unique_lock<std::mutex> lock(queue.mutex);
+				queue.changed.wait(lock, [&queue]() { return !queue.directories.empty() || (queue.busyThreads == 0); });
+
+				if (queue.directories.empty())
+					return;
+
+				directory = std::move(queue.directories.front());
+				queue.directories.pop_front();
+				queue.busyThreads++;
+			}
+
+			ListDirectory(directory, queue, inputRootPath, outputRootPath, visitor);
+
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if ((--queue.busyThreads == 0) && queue.directories.empty())
+				queue.changed.notify_all();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; i++)
+		threads.emplace_back(scan);
+
+	scan();
+
+	for (auto& thread : threads)
+		thread.join();
+}
+
+
+size_t ReadBulkFileList(std::istream& listStream, const std::wstring& inputRootPath, const std::wstring& outputRootPath,
+	BulkFileVisitor visitor)
+{
+	size_t badLines = 0;
+	std::string line;
+
+	while (std::getline(listStream, line))
+	{
+		while (!line.empty() && ((line.back() == '\r') || (line.back() == ' ')))
+			line.pop_back();
+
+		if (line.empty())
+			continue;
+
+		std::wstring listedPath;
+		wchar_t* pListedPath = nullptr;
+		FbxUTF8ToWC(line.c_str(), pListedPath);
+		if (pListedPath)
+		{
+			listedPath = pListedPath;
+			delete[] pListedPath;
+		}
+
+		std::filesystem::path inputPath(listedPath);
+		if (inputPath.is_relative())
+			inputPath = std::filesystem::path(inputRootPath) / inputPath;
+
+		std::filesystem::path relativePath;
+		if (!GetPathBelowRoot(inputPath, inputRootPath, relativePath))
+		{
+			std::cerr << "Error: " << line << " is not inside the input folder." << std::endl;
+			badLines++;
+			continue;
+		}
+
+		std::error_code error;
+		uintmax_t fileSize = std::filesystem::file_size(inputPath, error);
+		if (error)
+		{
+			std::cerr << "Error: " << line << " was not found." << std::endl;
+			badLines++;
+			continue;
+		}
+
+		visitor({ inputPath.wstring(), (std::filesystem::path(outputRootPath) / relativePath).wstring(), fileSize });
+	}
+
+	return badLines;
+}
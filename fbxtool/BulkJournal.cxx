@@ -0,0 +1,192 @@
+#include "BulkJournal.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <windows.h>
+
+
+static const std::wstring journalFileName = L".fbxtool-journal";
+static const std::wstring quarantineFileStem = L".fbxtool-quarantine";
+
+// Records written between forced syncs of the journal to disk.
+static const int journalSyncInterval = 64;
+
+int gQuarantineCrashCount { 2 };
+
+
+BulkJournal::BulkJournal(const std::wstring& inputRootPath, const std::wstring& outputRootPath, const std::wstring& shardTag)
+	: mInputRootPath(inputRootPath), mOutputRootPath(outputRootPath), mShardTag(shardTag)
+{
+}
+
+
+BulkJournal::~BulkJournal()
+{
+	Close();
+}
+
+
+std::wstring BulkJournal::GetJournalPath() const
+{
+	return (std::filesystem::path(mOutputRootPath) / (journalFileName + mShardTag)).wstring();
+}
+
+
+bool BulkJournal::Open(bool isResuming)
+{
+	if (isResuming)
+	{
+		// Each line is an event and a path. A file started and never finished was in flight when the process died.
+		std::ifstream journalStream(std::filesystem::path(GetJournalPath()), std::ios::binary);
+		std::map<std::string, bool> isInFlight;
+		std::string line;
+
+		while (std::getline(journalStream, line))
+		{
+			if ((line.size() < 3) || (line [1] != '\t'))
+				continue;
+
+			std::string relativePath = line.substr(2);
+			SJournalState& state = mStates [relativePath];
+
+			switch (line [0])
+			{
+				case 'S':
+					if (isInFlight [relativePath])
+						state.crashes++;
+					isInFlight [relativePath] = true;
+					break;
+
+				case 'C':
+					state.isCompleted = true;
+					isInFlight [relativePath] = false;
+					break;
+
+				case 'F':
+					state.isFailed = true;
+					isInFlight [relativePath] = false;
+					break;
+			}
+		}
+
+		for (const auto& inFlight : isInFlight)
+		{
+			if (inFlight.second)
+				mStates [inFlight.first].crashes++;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(mOutputRootPath, error);
+
+	HANDLE fileHandle = CreateFileW(GetJournalPath().c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr,
+		isResuming ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	mFileHandle = fileHandle;
+
+	// The crash may have cut the last record short; start on a fresh line.
+	if (isResuming)
+	{
+		DWORD written;
+		WriteFile(fileHandle, "\n", 1, &written, nullptr);
+	}
+
+	return true;
+}
+
+
+void BulkJournal::Close()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (mFileHandle)
+	{
+		FlushFileBuffers(static_cast<HANDLE>(mFileHandle));
+		CloseHandle(static_cast<HANDLE>(mFileHandle));
+		mFileHandle = nullptr;
+	}
+}
+
+
+SJournalState BulkJournal::GetState(const SBulkFile& file) const
+{
+	auto state = mStates.find(GetBulkRelativePath(mInputRootPath, file.inputPath));
+	return (state == mStates.end()) ? SJournalState() : state->second;
+}
+
+
+bool BulkJournal::IsCompleted(const SBulkFile& file) const
+{
+	return GetState(file).isCompleted;
+}
+
+
+bool BulkJournal::IsQuarantined(const SBulkFile& file) const
+{
+	return GetState(file).crashes >= gQuarantineCrashCount;
+}
+
+
+bool BulkJournal::IsSuspect(const SBulkFile& file) const
+{
+	int crashes = GetState(file).crashes;
+	return (crashes > 0) && (crashes < gQuarantineCrashCount);
+}
+
+
+void BulkJournal::Started(const SBulkFile& file)
+{
+	Append('S', GetBulkRelativePath(mInputRootPath, file.inputPath));
+}
+
+
+void BulkJournal::Finished(const SBulkFile& file, bool succeeded)
+{
+	Append(succeeded ? 'C' : 'F', GetBulkRelativePath(mInputRootPath, file.inputPath));
+}
+
+
+void BulkJournal::Append(char event, const std::string& relativePath)
+{
+	std::string record;
+	record += event;
+	record += '\t';
+	record += relativePath;
+	record += '\n';
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (!mFileHandle)
+		return;
+
+	// Straight to the OS with no buffering in the process, so the record survives the process crashing.
+	DWORD written;
+	WriteFile(static_cast<HANDLE>(mFileHandle), record.data(), static_cast<DWORD>(record.size()), &written, nullptr);
+
+	if (++mUnsyncedRecords >= journalSyncInterval)
+	{
+		FlushFileBuffers(static_cast<HANDLE>(mFileHandle));
+		mUnsyncedRecords = 0;
+	}
+}
+
+
+void ReportQuarantinedFiles(const std::wstring& outputRootPath, const std::vector<SBulkFile>& files,
+	const std::wstring& inputRootPath, const std::wstring& shardTag)
+{
+	if (files.empty())
+		return;
+
+	std::ofstream quarantineStream(std::filesystem::path(outputRootPath) / (quarantineFileStem + shardTag + L".txt"), std::ios::binary | std::ios::trunc);
+
+	std::cerr << files.size() << " file(s) quarantined after crashing " << gQuarantineCrashCount << " times:" << std::endl;
+	for (const auto& file : files)
+	{
+		std::string relativePath = GetBulkRelativePath(inputRootPath, file.inputPath);
+		std::cerr << "    " << relativePath << std::endl;
+		quarantineStream << relativePath << "\n";
+	}
+}
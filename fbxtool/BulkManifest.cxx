@@ -0,0 +1,446 @@
+#include "BulkManifest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "ContentHash.h"
+
+
+static const int manifestVersion = 1;
+static const std::wstring manifestFileStem = L".fbxtool-manifest";
+static const std::wstring manifestFileExtension = L".json";
+
+
+static int64_t GetModifiedTime(const std::wstring& path)
+{
+	std::error_code error;
+	auto modifiedTime = std::filesystem::last_write_time(path, error);
+
+	return error ? 0 : static_cast<int64_t>(modifiedTime.time_since_epoch().count());
+}
+
+
+BulkManifest::BulkManifest(const std::wstring& inputRootPath, const std::wstring& outputRootPath, const SManifestConfig& config,
+	const std::wstring& shardTag)
+	: mInputRootPath(inputRootPath), mOutputRootPath(outputRootPath), mShardTag(shardTag), mConfig(config)
+{
+}
+
+
+std::wstring BulkManifest::GetManifestPath() const
+{
+	return GetManifestPath(mShardTag);
+}
+
+
+std::wstring BulkManifest::GetManifestPath(const std::wstring& shardTag) const
+{
+	return (std::filesystem::path(mOutputRootPath) / (manifestFileStem + shardTag + manifestFileExtension)).wstring();
+}
+
+
+std::string BulkManifest::GetRelativePath(const SBulkFile& file) const
+{
+	return GetBulkRelativePath(mInputRootPath, file.inputPath);
+}
+
+
+// Read and check the shape of a manifest. Prints a warning only if the file exists but can't be used.
+static bool ReadManifest(const std::wstring& path, rapidjson::Document& manifest)
+{
+	std::ifstream manifestStream(std::filesystem::path(path), std::ios::binary);
+	if (!manifestStream)
+		return false;
+
+	std::stringstream manifestText;
+	manifestText << manifestStream.rdbuf();
+	std::string manifestString = manifestText.str();
+
+	if (manifest.Parse(manifestString.c_str()).HasParseError() || !manifest.IsObject()
+		|| !manifest.HasMember("version") || !manifest["version"].IsInt() || manifest["version"].GetInt() != manifestVersion
+		|| !manifest.HasMember("tool-version") || !manifest["tool-version"].IsString()
+		|| !manifest.HasMember("options-hash") || !manifest["options-hash"].IsString()
+		|| !manifest.HasMember("rules") || !manifest["rules"].IsObject()
+		|| !manifest.HasMember("skeletons") || !manifest["skeletons"].IsArray()
+		|| !manifest.HasMember("files") || !manifest["files"].IsObject())
+	{
+		std::cerr << "Ignoring unreadable manifest " << std::filesystem::path(path).filename().string() << "." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+static std::map<std::string, uint64_t> ReadRuleHashes(const rapidjson::Value& manifest)
+{
+	std::map<std::string, uint64_t> ruleHashes;
+	for (auto& rule : manifest["rules"].GetObject())
+	{
+		if (rule.value.IsString())
+			ruleHashes [rule.name.GetString()] = HexToHash(rule.value.GetString());
+	}
+
+	return ruleHashes;
+}
+
+
+static void ReadEntries(const rapidjson::Value& manifest, std::map<std::string, SManifestEntry>& entries)
+{
+	std::vector<std::shared_ptr<const std::set<std::string>>> skeletons;
+	for (auto& skeleton : manifest["skeletons"].GetArray())
+	{
+		auto pNames = std::make_shared<std::set<std::string>>();
+		if (skeleton.IsArray())
+		{
+			for (auto& name : skeleton.GetArray())
+			{
+				if (name.IsString())
+					pNames->insert(name.GetString());
+			}
+		}
+		skeletons.push_back(pNames);
+	}
+
+	for (auto& file : manifest["files"].GetObject())
+	{
+		const rapidjson::Value& value = file.value;
+		if (!value.IsObject() || !value.HasMember("size") || !value ["size"].IsUint64()
+			|| !value.HasMember("modified") || !value ["modified"].IsInt64()
+			|| !value.HasMember("hash") || !value ["hash"].IsString()
+			|| !value.HasMember("skeleton") || !value ["skeleton"].IsUint()
+			|| value ["skeleton"].GetUint() >= skeletons.size())
+		{
+			continue;
+		}
+
+		SManifestEntry entry;
+		entry.size = value ["size"].GetUint64();
+		entry.modifiedTime = value ["modified"].GetInt64();
+		entry.contentHash = HexToHash(value ["hash"].GetString());
+		entry.pSkeletonNames = skeletons [value ["skeleton"].GetUint()];
+
+		entries [file.name.GetString()] = entry;
+	}
+}
+
+
+void BulkManifest::Load()
+{
+	rapidjson::Document manifest;
+	if (!ReadManifest(GetManifestPath(), manifest))
+	{
+		std::error_code error;
+		if (mShardTag.empty() || std::filesystem::exists(GetManifestPath(), error) || !ReadManifest(GetManifestPath(L""), manifest))
+			return;
+	}
+
+	// A new tool version or a change to any global option can affect every file.
+	if ((mConfig.toolVersion != manifest["tool-version"].GetString())
+		|| (mConfig.optionsHash != HexToHash(manifest["options-hash"].GetString())))
+	{
+		mIsEverythingChanged = true;
+	}
+
+	// Otherwise only files containing a joint whose rule was added, removed or edited need redoing.
+	std::map<std::string, uint64_t> previousRules = ReadRuleHashes(manifest);
+
+	for (const auto& rule : mConfig.ruleHashes)
+	{
+		auto previous = previousRules.find(rule.first);
+		if ((previous == previousRules.end()) || (previous->second != rule.second))
+			mChangedRules.insert(rule.first);
+	}
+
+	for (const auto& rule : previousRules)
+	{
+		if (mConfig.ruleHashes.find(rule.first) == mConfig.ruleHashes.end())
+			mChangedRules.insert(rule.first);
+	}
+
+	ReadEntries(manifest, mEntries);
+}
+
+
+void BulkManifest::RetainOnly(const std::vector<SBulkFile>& files)
+{
+	std::set<std::string> relativePaths;
+	for (const auto& file : files)
+		relativePaths.insert(GetRelativePath(file));
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	for (auto entry = mEntries.begin(); entry != mEntries.end();)
+	{
+		if (relativePaths.find(entry->first) == relativePaths.end())
+			entry = mEntries.erase(entry);
+		else
+			++entry;
+	}
+}
+
+
+bool BulkManifest::MergeFrom(const std::wstring& path, SBulkResult* pRun)
+{
+	rapidjson::Document manifest;
+	if (!ReadManifest(path, manifest))
+		return false;
+
+	// Entries are only valid for the settings that produced them, so a node run with different options can't be merged.
+	if ((mConfig.toolVersion != manifest["tool-version"].GetString())
+		|| (mConfig.optionsHash != HexToHash(manifest["options-hash"].GetString()))
+		|| (mConfig.ruleHashes != ReadRuleHashes(manifest)))
+	{
+		std::cerr << "Error: " << std::filesystem::path(path).filename().string() << " was written with different settings." << std::endl;
+		return false;
+	}
+
+	if (pRun && manifest.HasMember("run") && manifest["run"].IsObject())
+	{
+		const rapidjson::Value& run = manifest["run"];
+		*pRun = SBulkResult();
+
+		if (run.HasMember("succeeded") && run["succeeded"].IsUint64())
+			pRun->succeeded = static_cast<size_t>(run["succeeded"].GetUint64());
+		if (run.HasMember("failed") && run["failed"].IsUint64())
+			pRun->failed = static_cast<size_t>(run["failed"].GetUint64());
+		if (run.HasMember("skipped") && run["skipped"].IsUint64())
+			pRun->skipped = static_cast<size_t>(run["skipped"].GetUint64());
+		if (run.HasMember("quarantined") && run["quarantined"].IsUint64())
+			pRun->quarantined = static_cast<size_t>(run["quarantined"].GetUint64());
+		if (run.HasMember("workers") && run["workers"].IsInt())
+			pRun->workers = run["workers"].GetInt();
+		if (run.HasMember("makespan") && run["makespan"].IsNumber())
+			pRun->makespanSeconds = run["makespan"].GetDouble();
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	ReadEntries(manifest, mEntries);
+
+	return true;
+}
+
+
+bool BulkManifest::NeedsProcessing(const SBulkFile& file)
+{
+	if (mIsEverythingChanged)
+		return true;
+
+	// Streamed runs check files while workers are recording others, so take a copy of the entry.
+	SManifestEntry entry;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto found = mEntries.find(GetRelativePath(file));
+		if (found == mEntries.end())
+			return true;
+
+		entry = found->second;
+	}
+
+	std::error_code error;
+	if (!std::filesystem::exists(file.outputPath, error))
+		return true;
+
+	// Same size and timestamp is taken as unchanged; otherwise the contents decide, so a touched file is skipped.
+	int64_t modifiedTime = GetModifiedTime(file.inputPath);
+	if ((entry.size != file.size) || (entry.modifiedTime != modifiedTime))
+	{
+		uint64_t contentHash;
+		if (!HashFile(file.inputPath, contentHash) || (contentHash != entry.contentHash))
+			return true;
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto found = mEntries.find(GetRelativePath(file));
+		if (found != mEntries.end())
+		{
+			found->second.size = file.size;
+			found->second.modifiedTime = modifiedTime;
+		}
+	}
+
+	for (const auto& name : *entry.pSkeletonNames)
+	{
+		if (mChangedRules.find(name) != mChangedRules.end())
+			return true;
+	}
+
+	return false;
+}
+
+
+void BulkManifest::Forget(const SBulkFile& file)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mEntries.erase(GetRelativePath(file));
+}
+
+
+void BulkManifest::RecordSkeleton(const SBulkFile& file, const std::vector<std::string>& skeletonNames)
+{
+	auto pNames = std::make_shared<const std::set<std::string>>(skeletonNames.begin(), skeletonNames.end());
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mPendingSkeletons [GetRelativePath(file)] = pNames;
+}
+
+
+void BulkManifest::RecordContentHash(const SBulkFile& file, uint64_t contentHash)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mPendingHashes [GetRelativePath(file)] = contentHash;
+}
+
+
+void BulkManifest::RecordResult(const SBulkFile& file, bool succeeded)
+{
+	std::string relativePath = GetRelativePath(file);
+
+	bool isHashed = false;
+	SManifestEntry entry;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto pendingHash = mPendingHashes.find(relativePath);
+		if (pendingHash != mPendingHashes.end())
+		{
+			entry.contentHash = pendingHash->second;
+			isHashed = true;
+			mPendingHashes.erase(pendingHash);
+		}
+	}
+
+	if (succeeded)
+	{
+		entry.size = file.size;
+		entry.modifiedTime = GetModifiedTime(file.inputPath);
+		if (!isHashed)
+			succeeded = HashFile(file.inputPath, entry.contentHash);
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto pending = mPendingSkeletons.find(relativePath);
+	if (succeeded && (pending != mPendingSkeletons.end()))
+	{
+		entry.pSkeletonNames = pending->second;
+		mEntries [relativePath] = entry;
+	}
+	else
+	{
+		mEntries.erase(relativePath);
+	}
+
+	if (pending != mPendingSkeletons.end())
+		mPendingSkeletons.erase(pending);
+}
+
+
+bool BulkManifest::Save(const SBulkResult* pRun) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.Key("version");
+	writer.Int(manifestVersion);
+	writer.Key("tool-version");
+	writer.String(mConfig.toolVersion.c_str());
+	writer.Key("options-hash");
+	writer.String(HashToHex(mConfig.optionsHash).c_str());
+
+	writer.Key("rules");
+	writer.StartObject();
+	for (const auto& rule : mConfig.ruleHashes)
+	{
+		writer.Key(rule.first.c_str());
+		writer.String(HashToHex(rule.second).c_str());
+	}
+	writer.EndObject();
+
+	// Most files in a library share a handful of rigs, so each distinct skeleton is written once and referenced.
+	std::map<std::set<std::string>, unsigned> skeletonIndices;
+	std::map<std::string, unsigned> fileSkeletons;
+	writer.Key("skeletons");
+	writer.StartArray();
+	for (const auto& entry : mEntries)
+	{
+		const auto& names = *entry.second.pSkeletonNames;
+		auto skeleton = skeletonIndices.find(names);
+		if (skeleton == skeletonIndices.end())
+		{
+			skeleton = skeletonIndices.emplace(names, static_cast<unsigned>(skeletonIndices.size())).first;
+
+			writer.StartArray();
+			for (const auto& name : names)
+				writer.String(name.c_str());
+			writer.EndArray();
+		}
+		fileSkeletons [entry.first] = skeleton->second;
+	}
+	writer.EndArray();
+
+	writer.Key("files");
+	writer.StartObject();
+	for (const auto& entry : mEntries)
+	{
+		writer.Key(entry.first.c_str());
+		writer.StartObject();
+		writer.Key("size");
+		writer.Uint64(entry.second.size);
+		writer.Key("modified");
+		writer.Int64(entry.second.modifiedTime);
+		writer.Key("hash");
+		writer.String(HashToHex(entry.second.contentHash).c_str());
+		writer.Key("skeleton");
+		writer.Uint(fileSkeletons [entry.first]);
+		writer.EndObject();
+	}
+	writer.EndObject();
+
+	if (pRun)
+	{
+		writer.Key("run");
+		writer.StartObject();
+		writer.Key("succeeded");
+		writer.Uint64(pRun->succeeded);
+		writer.Key("failed");
+		writer.Uint64(pRun->failed);
+		writer.Key("skipped");
+		writer.Uint64(pRun->skipped);
+		writer.Key("quarantined");
+		writer.Uint64(pRun->quarantined);
+		writer.Key("workers");
+		writer.Int(pRun->workers);
+		writer.Key("makespan");
+		writer.Double(pRun->makespanSeconds);
+		writer.EndObject();
+	}
+
+	writer.EndObject();
+
+	// Write beside the real manifest and swap it in, so an interrupted save leaves the old one intact.
+	std::filesystem::path manifestPath(GetManifestPath());
+	std::filesystem::path tempPath(manifestPath);
+	tempPath += L".tmp";
+
+	std::error_code error;
+	std::filesystem::create_directories(manifestPath.parent_path(), error);
+
+	{
+		std::ofstream manifestStream(tempPath, std::ios::binary | std::ios::trunc);
+		manifestStream.write(buffer.GetString(), buffer.GetSize());
+		if (!manifestStream)
+			return false;
+	}
+
+	std::filesystem::rename(tempPath, manifestPath, error);
+	return !error;
+}
@@ -0,0 +1,644 @@
+#include "BulkProcessing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "Common.h"
+#include "ContentHash.h"
+
+
+typedef std::chrono::steady_clock BulkClock;
+
+
+// The files dealt to one worker. The owner and any thieves both take from the front, which holds the largest
+// file still pending; with the queue already in LPT order that is the file most worth moving off a busy worker.
+struct SWorkerQueue
+{
+	std::mutex mutex;
+	std::deque<size_t> files;
+	uintmax_t pendingBytes { 0 };
+};
+
+
+static bool PopFile(SWorkerQueue& queue, const std::vector<SBulkFile>& files, size_t& fileIndex)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	if (queue.files.empty())
+		return false;
+
+	fileIndex = queue.files.front();
+	queue.files.pop_front();
+	queue.pendingBytes -= files [fileIndex].size;
+
+	return true;
+}
+
+
+static bool StealFile(std::vector<SWorkerQueue>& queues, int thief, const std::vector<SBulkFile>& files, size_t& fileIndex)
+{
+	// Pick the victim with the most work left. Each queue is only locked while it is inspected, so the victim may have
+	// emptied by the time we pop from it; in that case look again.
+	for (;;)
+	{
+		int victim = -1;
+		uintmax_t victimBytes = 0;
+		bool anyPending = false;
+
+		for (int i = 0; i < static_cast<int>(queues.size()); i++)
+		{
+			if (i == thief)
+				continue;
+
+			std::lock_guard<std::mutex> lock(queues [i].mutex);
+			if (queues [i].files.empty())
+				continue;
+
+			anyPending = true;
+			if ((victim < 0) || (queues [i].pendingBytes > victimBytes))
+			{
+				victim = i;
+				victimBytes = queues [i].pendingBytes;
+			}
+		}
+
+		if (!anyPending)
+			return false;
+
+		if (PopFile(queues [victim], files, fileIndex))
+			return true;
+	}
+}
+
+
+typedef std::function<void(int workerIndex, FbxManager*& pWorkerManager, FbxScene*& pWorkerScene)> BulkWorker;
+
+
+// Worker zero runs on the calling thread with the caller's manager and scene; the rest get their own.
+static void RunWorkers(FbxManager*& pFbxManager, FbxScene*& pFbxScene, int jobCount, const BulkWorker& worker)
+{
+	std::vector<std::thread> threads;
+	for (int i = 1; i < jobCount; i++)
+	{
+		threads.emplace_back([&worker, i]()
+		{
+			FbxManager* pWorkerManager = nullptr;
+			FbxScene* pWorkerScene = nullptr;
+			InitializeSdkObjects(pWorkerManager, pWorkerScene);
+
+			worker(i, pWorkerManager, pWorkerScene);
+
+			DestroySdkObjects(pWorkerManager, false);
+		});
+	}
+
+	worker(0, pFbxManager, pFbxScene);
+
+	for (auto& thread : threads)
+		thread.join();
+}
+
+
+// Run the processor on one file, treating an exception as a failure.
+static bool RunProcessor(const BulkFileProcessor& processor, FbxManager* pFbxManager, FbxScene* pFbxScene, const SBulkFile& file)
+{
+	try
+	{
+		return processor(pFbxManager, pFbxScene, file);
+	}
+	catch (const std::exception& e)
+	{
+		FBXSDK_printf("\n\nAn exception occurred while processing the file: %s\n", e.what());
+	}
+	catch (...)
+	{
+		FBXSDK_printf("\n\nAn unknown exception occurred while processing the file.\n");
+	}
+
+	return false;
+}
+
+
+// A worker only finishes once there is no work left, so the time between its finish and the last worker's finish is
+// time spent waiting on stragglers.
+static void SetFinishTimes(SBulkResult& result, BulkClock::time_point startTime, const std::vector<BulkClock::time_point>& finishTimes)
+{
+	BulkClock::time_point lastFinish = *std::max_element(finishTimes.begin(), finishTimes.end());
+	result.makespanSeconds = std::chrono::duration<double>(lastFinish - startTime).count();
+	for (const auto& finishTime : finishTimes)
+		result.stragglerSeconds += std::chrono::duration<double>(lastFinish - finishTime).count();
+}
+
+
+SBulkResult ProcessBulkFiles(FbxManager*& pFbxManager, FbxScene*& pFbxScene, std::vector<SBulkFile> files, int jobCount,
+	BulkFileProcessor processor)
+{
+	if (jobCount <= 0)
+		jobCount = (std::max)(1u, std::thread::hardware_concurrency());
+	if (static_cast<size_t>(jobCount) > files.size())
+		jobCount = (std::max)(1, static_cast<int>(files.size()));
+
+	// Largest first, then deal each file to the worker with the least work so far.
+	std::stable_sort(files.begin(), files.end(), [](const SBulkFile& a, const SBulkFile& b) { return a.size > b.size; });
+
+	std::vector<SWorkerQueue> queues(jobCount);
+	std::vector<uintmax_t> assignedBytes(jobCount, 0);
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		int target = static_cast<int>(std::min_element(assignedBytes.begin(), assignedBytes.end()) - assignedBytes.begin());
+		assignedBytes [target] += files [i].size;
+		queues [target].files.push_back(i);
+		queues [target].pendingBytes += files [i].size;
+	}
+
+	std::atomic<size_t> succeeded { 0 };
+	std::atomic<size_t> failed { 0 };
+	std::atomic<size_t> steals { 0 };
+	std::vector<BulkClock::time_point> finishTimes(jobCount);
+	std::mutex statsMutex;
+	SBulkResult result;
+	const BulkClock::time_point startTime = BulkClock::now();
+
+	auto worker = [&](int workerIndex, FbxManager*& pWorkerManager, FbxScene*& pWorkerScene)
+	{
+		SSceneLifecycleStats sceneStats;
+
+		for (;;)
+		{
+			size_t fileIndex;
+			if (!PopFile(queues [workerIndex], files, fileIndex))
+			{
+				if (!StealFile(queues, workerIndex, files, fileIndex))
+					break;
+				++steals;
+			}
+
+			if (RunProcessor(processor, pWorkerManager, pWorkerScene, files [fileIndex]))
+				++succeeded;
+			else
+				++failed;
+
+			ResetScene(pWorkerManager, pWorkerScene, sceneStats);
+		}
+
+		finishTimes [workerIndex] = BulkClock::now();
+
+		std::lock_guard<std::mutex> lock(statsMutex);
+		result.sceneStats.Merge(sceneStats);
+	};
+
+	RunWorkers(pFbxManager, pFbxScene, jobCount, worker);
+
+	result.succeeded = succeeded;
+	result.failed = failed;
+	result.steals = steals;
+	result.workers = jobCount;
+	SetFinishTimes(result, startTime, finishTimes);
+
+	return result;
+}
+
+
+static bool IsSmallerFile(const SBulkFile& a, const SBulkFile& b)
+{
+	return a.size < b.size;
+}
+
+
+void BulkFileFeed::Push(const SBulkFile& file)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	mFiles.push_back(file);
+	std::push_heap(mFiles.begin(), mFiles.end(), IsSmallerFile);
+	mNotEmpty.notify_one();
+}
+
+
+void BulkFileFeed::Close()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	mIsClosed = true;
+	mNotEmpty.notify_all();
+}
+
+
+bool BulkFileFeed::Pop(SBulkFile& file)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	mNotEmpty.wait(lock, [this]() { return !mFiles.empty() || mIsClosed; });
+	if (mFiles.empty())
+		return false;
+
+	std::pop_heap(mFiles.begin(), mFiles.end(), IsSmallerFile);
+	file = std::move(mFiles.back());
+	mFiles.pop_back();
+
+	return true;
+}
+
+
+SBulkResult ProcessBulkStream(FbxManager*& pFbxManager, FbxScene*& pFbxScene, BulkFileFeed& feed, int jobCount,
+	BulkFileProcessor processor)
+{
+	if (jobCount <= 0)
+		jobCount = (std::max)(1u, std::thread::hardware_concurrency());
+
+	std::atomic<size_t> succeeded { 0 };
+	std::atomic<size_t> failed { 0 };
+	std::vector<BulkClock::time_point> finishTimes(jobCount);
+	std::mutex statsMutex;
+	SBulkResult result;
+	const BulkClock::time_point startTime = BulkClock::now();
+
+	auto worker = [&](int workerIndex, FbxManager*& pWorkerManager, FbxScene*& pWorkerScene)
+	{
+		SSceneLifecycleStats sceneStats;
+		SBulkFile file;
+
+		while (feed.Pop(file))
+		{
+			if (RunProcessor(processor, pWorkerManager, pWorkerScene, file))
+				++succeeded;
+			else
+				++failed;
+
+			ResetScene(pWorkerManager, pWorkerScene, sceneStats);
+		}
+
+		finishTimes [workerIndex] = BulkClock::now();
+
+		std::lock_guard<std::mutex> lock(statsMutex);
+		result.sceneStats.Merge(sceneStats);
+	};
+
+	RunWorkers(pFbxManager, pFbxScene, jobCount, worker);
+
+	result.succeeded = succeeded;
+	result.failed = failed;
+	result.workers = jobCount;
+	SetFinishTimes(result, startTime, finishTimes);
+
+	return result;
+}
+
+
+// A blocking queue with a fixed capacity, placed between pipeline stages. Time spent blocked is added to the
+// caller's stall counter.
+template <typename T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity) : mCapacity(capacity) {}
+
+	void Push(T item, double& stallSeconds)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		BulkClock::time_point waitStart = BulkClock::now();
+		mNotFull.wait(lock, [this]() { return mItems.size() < mCapacity; });
+		stallSeconds += std::chrono::duration<double>(BulkClock::now() - waitStart).count();
+
+		mItems.push_back(item);
+		mNotEmpty.notify_one();
+	}
+
+	// Returns false once the queue is closed and drained.
+	bool Pop(T& item, double& stallSeconds)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		BulkClock::time_point waitStart = BulkClock::now();
+		mNotEmpty.wait(lock, [this]() { return !mItems.empty() || mIsClosed; });
+		stallSeconds += std::chrono::duration<double>(BulkClock::now() - waitStart).count();
+
+		if (mItems.empty())
+			return false;
+
+		item = mItems.front();
+		mItems.pop_front();
+		mNotFull.notify_one();
+
+		return true;
+	}
+
+	void Close()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mIsClosed = true;
+		mNotEmpty.notify_all();
+	}
+
+private:
+	std::mutex mMutex;
+	std::condition_variable mNotEmpty;
+	std::condition_variable mNotFull;
+	std::deque<T> mItems;
+	size_t mCapacity;
+	bool mIsClosed { false };
+};
+
+
+// A manager and scene on loan to whichever file is moving through the pipeline.
+struct SPipelineContext
+{
+	FbxManager* pManager { nullptr };
+	FbxScene* pScene { nullptr };
+	size_t fileIndex { 0 };
+};
+
+
+SBulkResult ProcessBulkPipeline(FbxManager*& pFbxManager, FbxScene*& pFbxScene, std::vector<SBulkFile> files,
+	const SPipelineWidths& widths, SBulkStages stages)
+{
+	enum { eLoad, eTransform, eSave, eStageCount };
+
+	const int stageWidths [eStageCount] = { widths.load, widths.transform, widths.save };
+	const BulkFileProcessor* stageProcessors [eStageCount] = { nullptr, &stages.transform, &stages.save };
+
+	// Start the largest files first, so a big file doesn't end up alone at the tail of the run.
+	std::stable_sort(files.begin(), files.end(), [](const SBulkFile& a, const SBulkFile& b) { return a.size > b.size; });
+
+	// One context for every worker and every queue slot is enough that no stage ever waits for a free scene.
+	size_t poolSize = widths.load + widths.transform + widths.save + 2 * widths.queueDepth;
+	std::vector<SPipelineContext> contexts(poolSize);
+	BoundedQueue<SPipelineContext*> freeContexts(poolSize);
+	BoundedQueue<SPipelineContext*> transformQueue(widths.queueDepth);
+	BoundedQueue<SPipelineContext*> saveQueue(widths.queueDepth);
+	BoundedQueue<SPipelineContext*>* stageInputs [eStageCount] = { nullptr, &transformQueue, &saveQueue };
+
+	double unusedStall = 0.0;
+	for (size_t i = 0; i < poolSize; i++)
+	{
+		if (i == 0)
+		{
+			contexts [i].pManager = pFbxManager;
+			contexts [i].pScene = pFbxScene;
+		}
+		else
+		{
+			InitializeSdkObjects(contexts [i].pManager, contexts [i].pScene);
+		}
+
+		freeContexts.Push(&contexts [i], unusedStall);
+	}
+
+	std::atomic<size_t> nextFile { 0 };
+	std::atomic<size_t> succeeded { 0 };
+	std::atomic<size_t> failed { 0 };
+	std::atomic<int> stageWorkersLeft [eStageCount];
+	std::mutex statsMutex;
+	SBulkResult result;
+	const BulkClock::time_point startTime = BulkClock::now();
+
+	for (int stage = 0; stage < eStageCount; stage++)
+		stageWorkersLeft [stage] = stageWidths [stage];
+
+	auto runStage = [&](int stage)
+	{
+		double busySeconds = 0.0;
+		double stallSeconds = 0.0;
+		SSceneLifecycleStats sceneStats;
+
+		for (;;)
+		{
+			SPipelineContext* pContext = nullptr;
+
+			if (stage == eLoad)
+			{
+				size_t fileIndex = nextFile++;
+				if (fileIndex >= files.size())
+					break;
+
+				freeContexts.Pop(pContext, stallSeconds);
+				pContext->fileIndex = fileIndex;
+			}
+			else if (!stageInputs [stage]->Pop(pContext, stallSeconds))
+			{
+				break;
+			}
+
+			bool stageResult = false;
+			bool isFinished = (stage == eSave);
+			BulkClock::time_point workStart = BulkClock::now();
+
+			try
+			{
+				if (stage == eLoad)
+				{
+					EBulkLoadResult loadResult = stages.load(pContext->pManager, pContext->pScene, files [pContext->fileIndex]);
+					stageResult = (loadResult != eBulkLoadFailed);
+					isFinished = (loadResult == eBulkLoadFinished);
+				}
+				else
+				{
+					stageResult = (*stageProcessors [stage])(pContext->pManager, pContext->pScene, files [pContext->fileIndex]);
+				}
+			}
+			catch (const std::exception& e)
+			{
+				FBXSDK_printf("\n\nAn exception occurred while processing the file: %s\n", e.what());
+			}
+			catch (...)
+			{
+				FBXSDK_printf("\n\nAn unknown exception occurred while processing the file.\n");
+			}
+
+			busySeconds += std::chrono::duration<double>(BulkClock::now() - workStart).count();
+
+			if (!stageResult || isFinished)
+			{
+				if (stageResult)
+					++succeeded;
+				else
+					++failed;
+
+				ResetScene(pContext->pManager, pContext->pScene, sceneStats);
+				freeContexts.Push(pContext, stallSeconds);
+			}
+			else
+			{
+				stageInputs [stage + 1]->Push(pContext, stallSeconds);
+			}
+		}
+
+		// The last worker out of a stage lets the next stage know nothing more is coming.
+		if ((--stageWorkersLeft [stage] == 0) && (stage + 1 < eStageCount))
+			stageInputs [stage + 1]->Close();
+
+		std::lock_guard<std::mutex> lock(statsMutex);
+		result.stageBusySeconds [stage] += busySeconds;
+		result.stageStallSeconds [stage] += stallSeconds;
+		result.sceneStats.Merge(sceneStats);
+	};
+
+	std::vector<std::thread> threads;
+	for (int stage = 0; stage < eStageCount; stage++)
+	{
+		for (int i = 0; i < stageWidths [stage]; i++)
+			threads.emplace_back(runStage, stage);
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	result.makespanSeconds = std::chrono::duration<double>(BulkClock::now() - startTime).count();
+	result.succeeded = succeeded;
+	result.failed = failed;
+	result.workers = widths.load + widths.transform + widths.save;
+	result.isPipelined = true;
+	for (int stage = 0; stage < eStageCount; stage++)
+		result.stageWidths [stage] = stageWidths [stage];
+
+	// The caller's manager and scene may have been replaced by a reset.
+	pFbxManager = contexts [0].pManager;
+	pFbxScene = contexts [0].pScene;
+
+	for (size_t i = 1; i < poolSize; i++)
+		DestroySdkObjects(contexts [i].pManager, false);
+
+	return result;
+}
+
+
+std::string GetBulkRelativePath(const std::wstring& inputRootPath, const std::wstring& inputPath)
+{
+	std::wstring relativePath = inputPath;
+	if (relativePath.compare(0, inputRootPath.size(), inputRootPath) == 0)
+		relativePath.erase(0, inputRootPath.size());
+
+	for (auto& c : relativePath)
+	{
+		if (c == L'\\')
+			c = L'/';
+	}
+
+	while (!relativePath.empty() && relativePath [0] == L'/')
+		relativePath.erase(0, 1);
+
+	std::string result;
+	char* pUtf8 = nullptr;
+	FbxWCToUTF8(relativePath.c_str(), pUtf8);
+	if (pUtf8)
+	{
+		result = pUtf8;
+		delete[] pUtf8;
+	}
+
+	return result;
+}
+
+
+bool IsInHashShard(const std::string& relativePath, const SBulkShard& shard)
+{
+	if (shard.count <= 1)
+		return true;
+
+	return HashString(relativePath) % static_cast<uint64_t>(shard.count) == static_cast<uint64_t>(shard.index);
+}
+
+
+std::vector<SBulkFile> SelectShard(const std::vector<SBulkFile>& files, const std::wstring& inputRootPath, const SBulkShard& shard)
+{
+	if (shard.count <= 1)
+		return files;
+
+	// Enumeration order depends on the file system, so everything below works from the relative paths instead.
+	std::vector<std::pair<std::string, size_t>> keys;
+	keys.reserve(files.size());
+	for (size_t i = 0; i < files.size(); i++)
+		keys.emplace_back(GetBulkRelativePath(inputRootPath, files [i].inputPath), i);
+
+	std::vector<size_t> selected;
+	if (!shard.isBySize)
+	{
+		for (const auto& key : keys)
+		{
+			if (IsInHashShard(key.first, shard))
+				selected.push_back(key.second);
+		}
+	}
+	else
+	{
+		std::sort(keys.begin(), keys.end(), [&files](const auto& a, const auto& b)
+		{
+			if (files [a.second].size != files [b.second].size)
+				return files [a.second].size > files [b.second].size;
+			return a.first < b.first;
+		});
+
+		// Ties go to the lowest bin, so the deal is the same on every node.
+		std::vector<uintmax_t> binBytes(shard.count, 0);
+		for (const auto& key : keys)
+		{
+			int bin = static_cast<int>(std::min_element(binBytes.begin(), binBytes.end()) - binBytes.begin());
+			binBytes [bin] += files [key.second].size;
+
+			if (bin == shard.index)
+				selected.push_back(key.second);
+		}
+	}
+
+	// Keep the enumeration order for the scheduler, which does its own sorting.
+	std::sort(selected.begin(), selected.end());
+
+	std::vector<SBulkFile> shardFiles;
+	shardFiles.reserve(selected.size());
+	for (size_t fileIndex : selected)
+		shardFiles.push_back(files [fileIndex]);
+
+	return shardFiles;
+}
+
+
+std::wstring GetShardTag(const SBulkShard& shard)
+{
+	if (shard.count <= 1)
+		return std::wstring();
+
+	return L".shard-" + std::to_wstring(shard.index + 1) + L"-of-" + std::to_wstring(shard.count);
+}
+
+
+void DisplayBulkResult(const SBulkResult& result)
+{
+	FBXSDK_printf("\n\nBulk run complete: %zu files, %zu succeeded, %zu failed, %zu skipped, %zu quarantined.\n",
+		result.succeeded + result.failed + result.skipped + result.quarantined, result.succeeded, result.failed, result.skipped,
+		result.quarantined);
+
+	double workerSeconds = result.makespanSeconds * result.workers;
+	double stragglerPercent = (workerSeconds > 0.0) ? (100.0 * result.stragglerSeconds / workerSeconds) : 0.0;
+
+	FBXSDK_printf("    Workers: %d\n", result.workers);
+	FBXSDK_printf("    Makespan: %.2f s\n", result.makespanSeconds);
+	if (result.scanSeconds > 0.0)
+		FBXSDK_printf("    Input scan: %.2f s\n", result.scanSeconds);
+	DisplaySceneLifecycleStats(result.sceneStats);
+
+	if (result.isPipelined)
+	{
+		// Busy near 100% marks the bottleneck stage; a stage that mostly stalls can give up workers.
+		const char* stageNames [] = { "Load", "Transform", "Save" };
+		for (int stage = 0; stage < 3; stage++)
+		{
+			double stageSeconds = result.makespanSeconds * result.stageWidths [stage];
+			double busyPercent = (stageSeconds > 0.0) ? (100.0 * result.stageBusySeconds [stage] / stageSeconds) : 0.0;
+
+			FBXSDK_printf("    %s stage: %d workers, %.1f%% busy, %.2f s waiting on other stages\n", stageNames [stage],
+				result.stageWidths [stage], busyPercent, result.stageStallSeconds [stage]);
+		}
+
+		return;
+	}
+
+	FBXSDK_printf("    Waiting on stragglers: %.2f worker-seconds (%.1f%% of worker time)\n", result.stragglerSeconds, stragglerPercent);
+	FBXSDK_printf("    Files stolen between workers: %zu\n", result.steals);
+}
@@ -10,12 +10,63 @@
 ****************************************************************************************/
 
 #include "include/Common.h"
+#include "include/MemoryStream.h"
+#include "include/StartupProfile.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <set>
 
 #ifdef IOS_REF
 	#undef  IOS_REF
 	#define IOS_REF (*(pManager->GetIOSettings()))
 #endif
 
+bool gIsLoadingPluginsLazily = true;
+bool gIsMappingInput = false;
+bool gIsExtractingEmbeddedMedia = true;
+SExportSettings gExportSettings;
+SSceneElements gSceneElements;
+
+// Managers that have loaded the plugin directory already. Bulk workers each have their own manager.
+static std::mutex gPluginMutex;
+static std::set<FbxManager*> gPluginManagers;
+
+void LoadPlugins(FbxManager* pManager)
+{
+    std::lock_guard<std::mutex> lLock(gPluginMutex);
+    if (!gPluginManagers.insert(pManager).second)
+        return;
+
+    auto lStart = std::chrono::steady_clock::now();
+
+	//Load plugins from the executable directory
+	FbxString lPath = FbxGetApplicationDirectory();
+	pManager->LoadPluginsDirectory(lPath.Buffer());
+
+    if (gIsProfilingStartup && gIsLoadingPluginsLazily)
+        FBXSDK_printf("Loaded plugins on demand in %.1f ms\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lStart).count());
+}
+
+// True if one of the readers built into the SDK handles files with this name's extension.
+static bool HasBuiltInReader(FbxManager* pManager, const char* pFilename)
+{
+    const char* lExtension = strrchr(pFilename, '.');
+    if (!lExtension)
+        return false;
+
+    return pManager->GetIOPluginRegistry()->FindReaderIDByExtension(lExtension + 1) >= 0;
+}
+
+// The FBX writer works out the relative paths of texture and video files from the name of the file it is writing,
+// which it doesn't have when it writes to a stream.
+static bool HasMediaFiles(FbxDocument* pScene)
+{
+    return (pScene->GetSrcObjectCount<FbxFileTexture>() > 0) || (pScene->GetSrcObjectCount<FbxVideo>() > 0);
+}
+
 void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
 {
     //The first thing to do is to create the FBX Manager which is the object allocator for almost all the classes in the SDK
@@ -26,14 +77,20 @@ void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
         exit(1);
     }
 	else FBXSDK_printf("Autodesk FBX SDK version %s\n", pManager->GetVersion());
+	MarkStartupPhase("Create FBX manager");
 
 	//Create an IOSettings object. This object holds all import/export settings.
 	FbxIOSettings* ios = FbxIOSettings::Create(pManager, IOSROOT);
 	pManager->SetIOSettings(ios);
+	MarkStartupPhase("Create IO settings");
 
-	//Load plugins from the executable directory (optional)
-	FbxString lPath = FbxGetApplicationDirectory();
-	pManager->LoadPluginsDirectory(lPath.Buffer());
+	//Plugins are only needed for formats the SDK can't read by itself, so they are normally left until LoadScene or
+	//SaveScene asks for one
+	if (!gIsLoadingPluginsLazily)
+	{
+		LoadPlugins(pManager);
+		MarkStartupPhase("Load plugins");
+	}
 
     //Create an FBX scene. This object holds most objects imported/exported from/to files.
     pScene = FbxScene::Create(pManager, "My Scene");
@@ -42,12 +99,20 @@ void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
         FBXSDK_printf("Error: Unable to create FBX scene!\n");
         exit(1);
     }
+	MarkStartupPhase("Create scene");
 }
 
 void DestroySdkObjects(FbxManager* pManager, bool pExitStatus)
 {
     //Delete the FBX Manager. All the objects that have been allocated using the FBX Manager and that haven't been explicitly destroyed are also automatically destroyed.
-    if( pManager ) pManager->Destroy();
+    if( pManager )
+    {
+        {
+            std::lock_guard<std::mutex> lLock(gPluginMutex);
+            gPluginManagers.erase(pManager);
+        }
+        pManager->Destroy();
+    }
 	if( pExitStatus ) FBXSDK_printf("Program Success!\n");
 }
 
@@ -59,13 +124,17 @@ bool SaveScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename,
     // Create an exporter.
     FbxExporter* lExporter = FbxExporter::Create(pManager, "");
 
+    // A format the built in writers don't cover may come from a plugin.
+    if( pFileFormat >= pManager->GetIOPluginRegistry()->GetWriterFormatCount() )
+        LoadPlugins(pManager);
+
     if( pFileFormat < 0 || pFileFormat >= pManager->GetIOPluginRegistry()->GetWriterFormatCount() )
     {
-        // Write in fall back format in less no ASCII format found
+        // The native writer is binary FBX, which is also the fall back if no ASCII format is found
         pFileFormat = pManager->GetIOPluginRegistry()->GetNativeWriterFormat();
 
-        //Try to export in ASCII if possible
-        int lFormatIndex, lFormatCount = pManager->GetIOPluginRegistry()->GetWriterFormatCount();
+        //Export in ASCII only when asked to
+        int lFormatIndex, lFormatCount = gExportSettings.isBinary ? 0 : pManager->GetIOPluginRegistry()->GetWriterFormatCount();
 
         for (lFormatIndex=0; lFormatIndex<lFormatCount; lFormatIndex++)
         {
@@ -85,34 +154,99 @@ bool SaveScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename,
     // Set the export states. By default, the export states are always set to 
     // true except for the option eEXPORT_TEXTURE_AS_EMBEDDED. The code below 
     // shows how to change these states.
-    IOS_REF.SetBoolProp(EXP_FBX_MATERIAL,        true);
-    IOS_REF.SetBoolProp(EXP_FBX_TEXTURE,         true);
+    IOS_REF.SetBoolProp(EXP_FBX_MATERIAL,        gSceneElements.materials);
+    IOS_REF.SetBoolProp(EXP_FBX_TEXTURE,         gSceneElements.textures);
     IOS_REF.SetBoolProp(EXP_FBX_EMBEDDED,        pEmbedMedia);
-    IOS_REF.SetBoolProp(EXP_FBX_SHAPE,           true);
-    IOS_REF.SetBoolProp(EXP_FBX_GOBO,            true);
-    IOS_REF.SetBoolProp(EXP_FBX_ANIMATION,       true);
-    IOS_REF.SetBoolProp(EXP_FBX_GLOBAL_SETTINGS, true);
-
-    // Initialize the exporter by providing a filename.
-    if(lExporter->Initialize(pFilename, pFileFormat, pManager->GetIOSettings()) == false)
+    IOS_REF.SetBoolProp(EXP_FBX_SHAPE,           gSceneElements.shapes);
+    IOS_REF.SetBoolProp(EXP_FBX_GOBO,            gSceneElements.gobos);
+    IOS_REF.SetBoolProp(EXP_FBX_ANIMATION,       gSceneElements.animation);
+    IOS_REF.SetBoolProp(EXP_FBX_GLOBAL_SETTINGS, gSceneElements.globalSettings);
+
+    // Large arrays such as keys and vertices are zlib compressed in binary files. The level trades export time
+    // against size.
+    IOS_REF.SetBoolProp(EXP_FBX_COMPRESS_ARRAYS, gExportSettings.isCompressingArrays);
+    IOS_REF.SetIntProp(EXP_FBX_COMPRESS_LEVEL,   gExportSettings.compressionLevel);
+    IOS_REF.SetIntProp(EXP_FBX_COMPRESS_MINSIZE, gExportSettings.compressionMinSize);
+
+    // FBX files are exported into memory and published with a single write. Anything else is exported to a temporary
+    // file, which is renamed over the output once it is complete.
+    wchar_t* lWidePath = nullptr;
+    FbxUTF8ToWC(pFilename, lWidePath);
+    const std::wstring lPath = lWidePath ? lWidePath : L"";
+    delete[] lWidePath;
+
+    const bool lIsPublishing = gExportSettings.isPublishingAtomically && !lPath.empty();
+    const bool lIsBuffered = lIsPublishing && pManager->GetIOPluginRegistry()->WriterIsFBX(pFileFormat) && !HasMediaFiles(pScene);
+    const std::wstring lTemporaryPath = GetTemporaryPath(lPath);
+    MemoryWriteStream lStream(pFileFormat);
+
+    char* lTemporaryName = nullptr;
+    FbxWCToUTF8(lTemporaryPath.c_str(), lTemporaryName);
+    const FbxString lExportName = (lIsPublishing && lTemporaryName) ? lTemporaryName : pFilename;
+    delete[] lTemporaryName;
+
+    // Initialize the exporter by providing a stream or a filename.
+    const bool lIsInitialized = lIsBuffered
+        ? lExporter->Initialize(&lStream, nullptr, pFileFormat, pManager->GetIOSettings())
+        : lExporter->Initialize(lExportName.Buffer(), pFileFormat, pManager->GetIOSettings());
+
+    if(lIsInitialized == false)
     {
         FBXSDK_printf("Call to FbxExporter::Initialize() failed.\n");
         FBXSDK_printf("Error returned: %s\n\n", lExporter->GetStatus().GetErrorString());
+        lExporter->Destroy();
+        return false;
+    }
+
+    if (!gExportSettings.fileVersion.IsEmpty() && !lExporter->SetFileExportVersion(gExportSettings.fileVersion, FbxSceneRenamer::eNone))
+    {
+        FBXSDK_printf("The FBX SDK can't write file version %s.\n\n", gExportSettings.fileVersion.Buffer());
+        lExporter->Destroy();
         return false;
     }
 
     FbxManager::GetFileFormatVersion(lMajor, lMinor, lRevision);
-    FBXSDK_printf("FBX file format version %d.%d.%d\n\n", lMajor, lMinor, lRevision);
+    FBXSDK_printf("FBX file format version %d.%d.%d, writing %s\n\n", lMajor, lMinor, lRevision,
+        gExportSettings.fileVersion.IsEmpty() ? "the current version" : gExportSettings.fileVersion.Buffer());
 
     // Export the scene.
     lStatus = lExporter->Export(pScene); 
 
     // Destroy the exporter.
     lExporter->Destroy();
+
+    // Nothing reaches the output path unless the export succeeded.
+    bool lIsPublished = true;
+    if (lIsBuffered)
+    {
+        lIsPublished = !lStatus || PublishFile(lPath, lStream.GetData(), lStream.GetSize(), gExportSettings.syncPolicy);
+    }
+    else if (lIsPublishing)
+    {
+        if (lStatus)
+        {
+            lIsPublished = CommitTemporaryFile(lTemporaryPath, lPath, gExportSettings.syncPolicy);
+        }
+        else
+        {
+            std::error_code lError;
+            std::filesystem::remove(lTemporaryPath, lError);
+        }
+    }
+
+    if (!lIsPublished)
+    {
+        FBXSDK_printf("Unable to replace %s with the exported file.\n", pFilename);
+        lStatus = false;
+    }
+
     return lStatus;
 }
 
-bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename)
+// Import from the stream if there is one, otherwise have the SDK read the file itself. The filename is still used
+// for reporting.
+static bool ImportScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, FbxStream* pStream,
+    const SSceneElements& pElements)
 {
     int lFileMajor, lFileMinor, lFileRevision;
     int lSDKMajor,  lSDKMinor,  lSDKRevision;
@@ -124,11 +258,17 @@ bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename)
     // Get the file version number generate by the FBX SDK.
     FbxManager::GetFileFormatVersion(lSDKMajor, lSDKMinor, lSDKRevision);
 
+    // Only load the plugins once a file turns up that the built in readers don't recognise.
+    if (!pStream && !HasBuiltInReader(pManager, pFilename))
+        LoadPlugins(pManager);
+
     // Create an importer.
     FbxImporter* lImporter = FbxImporter::Create(pManager,"");
 
-    // Initialize the importer by providing a filename.
-    const bool lImportStatus = lImporter->Initialize(pFilename, -1, pManager->GetIOSettings());
+    // Initialize the importer by providing a stream or a filename.
+    const bool lImportStatus = pStream
+        ? lImporter->Initialize(pStream, nullptr, pStream->GetReaderID(), pManager->GetIOSettings())
+        : lImporter->Initialize(pFilename, -1, pManager->GetIOSettings());
     lImporter->GetFileVersion(lFileMajor, lFileMinor, lFileRevision);
 
     if( !lImportStatus )
@@ -182,14 +322,15 @@ bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename)
         }
 
         // Set the import states. By default, the import states are always set to 
-        // true. The code below shows how to change these states.
-        IOS_REF.SetBoolProp(IMP_FBX_MATERIAL,        true);
-        IOS_REF.SetBoolProp(IMP_FBX_TEXTURE,         true);
-        IOS_REF.SetBoolProp(IMP_FBX_LINK,            true);
-        IOS_REF.SetBoolProp(IMP_FBX_SHAPE,           true);
-        IOS_REF.SetBoolProp(IMP_FBX_GOBO,            true);
-        IOS_REF.SetBoolProp(IMP_FBX_ANIMATION,       true);
-        IOS_REF.SetBoolProp(IMP_FBX_GLOBAL_SETTINGS, true);
+        // true; a selective import leaves out whatever the requested operations don't need.
+        IOS_REF.SetBoolProp(IMP_FBX_MATERIAL,        pElements.materials);
+        IOS_REF.SetBoolProp(IMP_FBX_TEXTURE,         pElements.textures);
+        IOS_REF.SetBoolProp(IMP_FBX_LINK,            pElements.links);
+        IOS_REF.SetBoolProp(IMP_FBX_SHAPE,           pElements.shapes);
+        IOS_REF.SetBoolProp(IMP_FBX_GOBO,            pElements.gobos);
+        IOS_REF.SetBoolProp(IMP_FBX_ANIMATION,       pElements.animation);
+        IOS_REF.SetBoolProp(IMP_FBX_GLOBAL_SETTINGS, pElements.globalSettings);
+        IOS_REF.SetBoolProp(IMP_FBX_EXTRACT_EMBEDDED_DATA, gIsExtractingEmbeddedMedia);
     }
 
     // Import the scene.
@@ -223,3 +364,32 @@ bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename)
 
     return lStatus;
 }
+
+
+bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, const SSceneElements& pElements)
+{
+    // Only FBX files go through the mapping; the readers for other formats are left to read files by name.
+    const char* lExtension = strrchr(pFilename, '.');
+    if (gIsMappingInput && lExtension && (FBXSDK_stricmp(lExtension, ".fbx") == 0))
+    {
+        wchar_t* lWidePath = nullptr;
+        FbxUTF8ToWC(pFilename, lWidePath);
+
+        MemoryReadStream lStream(pManager);
+        const bool lIsMapped = lWidePath && lStream.MapFile(lWidePath);
+        delete[] lWidePath;
+
+        if (lIsMapped)
+            return ImportScene(pManager, pScene, pFilename, &lStream, pElements);
+    }
+
+    return ImportScene(pManager, pScene, pFilename, nullptr, pElements);
+}
+
+
+bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const void* pData, size_t pSize, const char* pName,
+    const SSceneElements& pElements)
+{
+    MemoryReadStream lStream(pManager, pData, pSize);
+    return ImportScene(pManager, pScene, pName, &lStream, pElements);
+}
@@ -0,0 +1,144 @@
+#include "ContentHash.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+
+static const uint64_t hashPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t hashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t hashPrime3 = 0x165667B19E3779F9ULL;
+
+
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+
+ContentHash::ContentHash(uint64_t seed)
+	: mState(seed ^ hashPrime3)
+{
+}
+
+
+void ContentHash::MixBlock(uint64_t block)
+{
+	mState ^= RotateLeft(block * hashPrime2, 31) * hashPrime1;
+	mState = RotateLeft(mState, 27) * hashPrime1 + hashPrime3;
+}
+
+
+void ContentHash::Update(const void* pData, size_t size)
+{
+	const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+	mTotalSize += size;
+
+	// Top up a partial block left by the previous call.
+	if (mTailSize > 0)
+	{
+		size_t take = (size < 8 - mTailSize) ? size : 8 - mTailSize;
+		memcpy(mTail + mTailSize, pBytes, take);
+		mTailSize += take;
+		pBytes += take;
+		size -= take;
+
+		if (mTailSize < 8)
+			return;
+
+		uint64_t block;
+		memcpy(&block, mTail, 8);
+		MixBlock(block);
+		mTailSize = 0;
+	}
+
+	for (; size >= 8; pBytes += 8, size -= 8)
+	{
+		uint64_t block;
+		memcpy(&block, pBytes, 8);
+		MixBlock(block);
+	}
+
+	memcpy(mTail, pBytes, size);
+	mTailSize = size;
+}
+
+
+void ContentHash::Update(const std::string& text)
+{
+	Update(text.data(), text.size());
+}
+
+
+void ContentHash::UpdateField(const std::string& text)
+{
+	uint64_t length = text.size();
+	Update(&length, sizeof(length));
+	Update(text);
+}
+
+
+uint64_t ContentHash::Finish() const
+{
+	uint64_t hash = mState;
+
+	for (size_t i = 0; i < mTailSize; i++)
+		hash = RotateLeft(hash ^ (mTail [i] * hashPrime3), 11) * hashPrime1;
+
+	hash ^= mTotalSize;
+	hash ^= hash >> 33;
+	hash *= hashPrime2;
+	hash ^= hash >> 29;
+	hash *= hashPrime3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+
+uint64_t HashString(const std::string& text)
+{
+	ContentHash hash;
+	hash.Update(text);
+	return hash.Finish();
+}
+
+
+bool HashFile(const std::wstring& path, uint64_t& hash)
+{
+	std::ifstream fileStream(std::filesystem::path(path), std::ios::binary);
+	if (!fileStream)
+		return false;
+
+	ContentHash fileHash;
+	std::vector<char> buffer(1 << 20);
+
+	while (fileStream)
+	{
+		fileStream.read(buffer.data(), buffer.size());
+		fileHash.Update(buffer.data(), static_cast<size_t>(fileStream.gcount()));
+	}
+
+	if (fileStream.bad())
+		return false;
+
+	hash = fileHash.Finish();
+	return true;
+}
+
+
+std::string HashToHex(uint64_t hash)
+{
+	char text [17];
+	snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+	return text;
+}
+
+
+uint64_t HexToHash(const char* pText)
+{
+	return strtoull(pText, nullptr, 16);
+}
@@ -11,6 +11,8 @@
 
 #include "GeometryUtility.h"
 
+#include <cmath>
+
 FbxNode * CreatePyramid(FbxScene * pScene, const char * pName, double pBottomWidth, double pHeight)
 {
     FbxMesh * lPyramid = FbxMesh::Create(pScene, pName);
@@ -185,3 +187,62 @@ FbxNode* CreateCube(FbxScene* pScene, const char* pName, FbxDouble3& pLclTransla
     return lNode;
 }
 
+
+// Create a grid.
+FbxNode* CreateGrid(FbxScene* pScene, const char* pName, int pSide)
+{
+    FbxMesh* lMesh = FbxMesh::Create(pScene, pName);
+
+    // Control points on a gentle ripple, so the positions and normals don't compress down to nothing.
+    lMesh->InitControlPoints(pSide * pSide);
+    FbxVector4* lControlPoints = lMesh->GetControlPoints();
+
+    FbxGeometryElementNormal* lNormalElement = lMesh->CreateElementNormal();
+    lNormalElement->SetMappingMode(FbxGeometryElement::eByControlPoint);
+    lNormalElement->SetReferenceMode(FbxGeometryElement::eDirect);
+    lNormalElement->GetDirectArray().Resize(pSide * pSide);
+
+    FbxGeometryElementUV* lUVElement = lMesh->CreateElementUV("UVSet1");
+    lUVElement->SetMappingMode(FbxGeometryElement::eByControlPoint);
+    lUVElement->SetReferenceMode(FbxGeometryElement::eDirect);
+    lUVElement->GetDirectArray().Resize(pSide * pSide);
+
+    const double lStep = 1.0 / (pSide - 1);
+    for (int lRow = 0; lRow < pSide; ++lRow)
+    {
+        for (int lColumn = 0; lColumn < pSide; ++lColumn)
+        {
+            const int lIndex = lRow * pSide + lColumn;
+            const double lU = lColumn * lStep;
+            const double lV = lRow * lStep;
+            const double lHeight = 0.02 * sin(lU * 40.0) * cos(lV * 40.0);
+
+            lControlPoints[lIndex] = FbxVector4(lU * 100.0, lHeight * 100.0, lV * 100.0);
+
+            FbxVector4 lNormal(-0.8 * cos(lU * 40.0) * cos(lV * 40.0), 1.0, 0.8 * sin(lU * 40.0) * sin(lV * 40.0));
+            lNormal.Normalize();
+            lNormalElement->GetDirectArray().SetAt(lIndex, lNormal);
+            lUVElement->GetDirectArray().SetAt(lIndex, FbxVector2(lU, lV));
+        }
+    }
+
+    for (int lRow = 0; lRow < pSide - 1; ++lRow)
+    {
+        for (int lColumn = 0; lColumn < pSide - 1; ++lColumn)
+        {
+            const int lCorner = lRow * pSide + lColumn;
+            lMesh->BeginPolygon();
+            lMesh->AddPolygon(lCorner);
+            lMesh->AddPolygon(lCorner + pSide);
+            lMesh->AddPolygon(lCorner + pSide + 1);
+            lMesh->AddPolygon(lCorner + 1);
+            lMesh->EndPolygon();
+        }
+    }
+
+    FbxNode* lNode = FbxNode::Create(pScene, pName);
+    lNode->SetNodeAttribute(lMesh);
+    pScene->GetRootNode()->AddChild(lNode);
+
+    return lNode;
+}
@@ -0,0 +1,373 @@
+#include "JobServer.h"
+
+#include <fbxsdk.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <windows.h>
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+
+// Large enough for any request; longer lines are refused rather than buffered without limit.
+static const size_t maxMessageSize = 64 * 1024;
+
+// How long a client has to send its request, and to take the reply, before the server drops it and moves on. The
+// pipe has a single instance, so a client that connects and says nothing would otherwise hold up every other client.
+static const DWORD clientTimeoutMs = 10000;
+
+
+static std::wstring GetPipePath(const std::string& pipeName)
+{
+	std::wstring pipePath = L"\\\\.\\pipe\\";
+	wchar_t* pName = nullptr;
+	FbxUTF8ToWC(pipeName.c_str(), pName);
+	if (pName)
+	{
+		pipePath += pName;
+		delete[] pName;
+	}
+
+	return pipePath;
+}
+
+
+// The server's end of the pipe is overlapped, so every read and write on it can be given a deadline. The client's end
+// isn't, and passes no overlapped state.
+struct SPipeDeadline
+{
+	OVERLAPPED* pOverlapped { nullptr };
+	std::chrono::steady_clock::time_point time;
+};
+
+
+// Finish an overlapped read or write, cancelling it if the deadline passes first.
+static bool FinishOverlapped(HANDLE pipeHandle, BOOL isStarted, const SPipeDeadline& deadline, DWORD& bytes)
+{
+	if (!isStarted && (GetLastError() != ERROR_IO_PENDING))
+		return false;
+
+	auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline.time - std::chrono::steady_clock::now());
+	DWORD timeoutMs = static_cast<DWORD>((std::max)(remaining.count(), decltype(remaining.count())(0)));
+
+	if (WaitForSingleObject(deadline.pOverlapped->hEvent, timeoutMs) != WAIT_OBJECT_0)
+	{
+		// The operation has to be over before the overlapped state can be reused.
+		CancelIo(pipeHandle);
+		GetOverlappedResult(pipeHandle, deadline.pOverlapped, &bytes, TRUE);
+		return false;
+	}
+
+	return GetOverlappedResult(pipeHandle, deadline.pOverlapped, &bytes, FALSE) != FALSE;
+}
+
+
+// Read up to the end of the line. The line feed is not included.
+static bool ReadMessage(HANDLE pipeHandle, std::string& message, const SPipeDeadline& deadline = SPipeDeadline())
+{
+	message.clear();
+
+	char buffer [4096];
+	for (;;)
+	{
+		DWORD bytesRead = 0;
+		BOOL isRead = ReadFile(pipeHandle, buffer, sizeof(buffer), deadline.pOverlapped ? nullptr : &bytesRead, deadline.pOverlapped);
+		if (deadline.pOverlapped)
+			isRead = FinishOverlapped(pipeHandle, isRead, deadline, bytesRead);
+
+		if (!isRead || (bytesRead == 0))
+			return false;
+
+		message.append(buffer, bytesRead);
+
+		size_t lineEnd = message.find('\n');
+		if (lineEnd != std::string::npos)
+		{
+			message.resize(lineEnd);
+			return true;
+		}
+
+		if (message.size() > maxMessageSize)
+			return false;
+	}
+}
+
+
+static bool WriteMessage(HANDLE pipeHandle, const std::string& message, const SPipeDeadline& deadline = SPipeDeadline())
+{
+	std::string line = message + "\n";
+
+	DWORD written = 0;
+	BOOL isWritten = WriteFile(pipeHandle, line.data(), static_cast<DWORD>(line.size()), deadline.pOverlapped ? nullptr : &written,
+		deadline.pOverlapped);
+	if (deadline.pOverlapped)
+		isWritten = FinishOverlapped(pipeHandle, isWritten, deadline, written);
+
+	return isWritten && (written == line.size());
+}
+
+
+static std::string WriteJob(const SServerJob& job)
+{
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	if (job.isShutdown)
+	{
+		writer.Key("command");
+		writer.String("shutdown");
+	}
+	else
+	{
+		writer.Key("input");
+		writer.String(job.inputPath.c_str());
+		writer.Key("output");
+		writer.String(job.outputPath.c_str());
+		writer.Key("joints");
+		writer.String(job.jointFilePath.c_str());
+		writer.Key("scale");
+		writer.Double(job.scale);
+		writer.Key("fixamo");
+		writer.Bool(job.applyMixamoFixes);
+		writer.Key("add-ik");
+		writer.Bool(job.addIK);
+	}
+	writer.EndObject();
+
+	return buffer.GetString();
+}
+
+
+static bool ReadJob(const std::string& message, SServerJob& job)
+{
+	rapidjson::Document request;
+	if (request.Parse(message.c_str()).HasParseError() || !request.IsObject())
+		return false;
+
+	if (request.HasMember("command") && request["command"].IsString())
+	{
+		job.isShutdown = (std::string(request["command"].GetString()) == "shutdown");
+		return job.isShutdown;
+	}
+
+	if (!request.HasMember("input") || !request["input"].IsString())
+		return false;
+
+	job.inputPath = request["input"].GetString();
+	job.outputPath = job.inputPath;
+	if (request.HasMember("output") && request["output"].IsString() && (request["output"].GetStringLength() > 0))
+		job.outputPath = request["output"].GetString();
+	if (request.HasMember("joints") && request["joints"].IsString())
+		job.jointFilePath = request["joints"].GetString();
+	if (request.HasMember("scale") && request["scale"].IsNumber())
+		job.scale = request["scale"].GetDouble();
+	if (request.HasMember("fixamo") && request["fixamo"].IsBool())
+		job.applyMixamoFixes = request["fixamo"].GetBool();
+	if (request.HasMember("add-ik") && request["add-ik"].IsBool())
+		job.addIK = request["add-ik"].GetBool();
+
+	return true;
+}
+
+
+static std::string WriteResult(const SServerJobResult& result)
+{
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.Key("succeeded");
+	writer.Bool(result.succeeded);
+	writer.Key("error");
+	writer.String(result.error.c_str());
+
+	writer.Key("timing");
+	writer.StartObject();
+	writer.Key("config");
+	writer.Double(result.configSeconds);
+	writer.Key("load");
+	writer.Double(result.loadSeconds);
+	writer.Key("transform");
+	writer.Double(result.transformSeconds);
+	writer.Key("save");
+	writer.Double(result.saveSeconds);
+	writer.Key("total");
+	writer.Double(result.totalSeconds);
+	writer.EndObject();
+
+	writer.EndObject();
+
+	return buffer.GetString();
+}
+
+
+static bool ReadResult(const std::string& message, SServerJobResult& result)
+{
+	rapidjson::Document reply;
+	if (reply.Parse(message.c_str()).HasParseError() || !reply.IsObject()
+		|| !reply.HasMember("succeeded") || !reply["succeeded"].IsBool())
+	{
+		return false;
+	}
+
+	result.succeeded = reply["succeeded"].GetBool();
+	if (reply.HasMember("error") && reply["error"].IsString())
+		result.error = reply["error"].GetString();
+
+	if (reply.HasMember("timing") && reply["timing"].IsObject())
+	{
+		const rapidjson::Value& timing = reply["timing"];
+		const char* stepNames [] = { "config", "load", "transform", "save", "total" };
+		double* stepSeconds [] = { &result.configSeconds, &result.loadSeconds, &result.transformSeconds, &result.saveSeconds,
+			&result.totalSeconds };
+
+		for (int step = 0; step < 5; step++)
+		{
+			if (timing.HasMember(stepNames [step]) && timing [stepNames [step]].IsNumber())
+				*stepSeconds [step] = timing [stepNames [step]].GetDouble();
+		}
+	}
+
+	return true;
+}
+
+
+bool RunJobServer(const std::string& pipeName, ServerJobHandler handler)
+{
+	std::wstring pipePath = GetPipePath(pipeName);
+	FBXSDK_printf("Serving jobs on \\\\.\\pipe\\%s\n", pipeName.c_str());
+
+	// A single instance, reused for every client, so the pipe never disappears between jobs; a client arriving while
+	// a job runs sees it busy and waits. It also stops a second server starting on the same name.
+	HANDLE pipeHandle = CreateNamedPipeW(pipePath.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1,
+		static_cast<DWORD>(maxMessageSize), static_cast<DWORD>(maxMessageSize), 0, nullptr);
+	if (pipeHandle == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Error: Unable to create the pipe " << pipeName << ", is another server using it?" << std::endl;
+		return false;
+	}
+
+	OVERLAPPED overlapped {};
+	overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+	bool isShutdown = false;
+	while (!isShutdown)
+	{
+		// Waiting for a client has no deadline. A client may connect between the pipe being made ready and waiting on
+		// it, which is reported as an error.
+		ResetEvent(overlapped.hEvent);
+		if (!ConnectNamedPipe(pipeHandle, &overlapped))
+		{
+			DWORD connectError = GetLastError();
+			DWORD unused = 0;
+			bool isConnected = (connectError == ERROR_PIPE_CONNECTED)
+				|| ((connectError == ERROR_IO_PENDING) && GetOverlappedResult(pipeHandle, &overlapped, &unused, TRUE));
+
+			if (!isConnected)
+			{
+				DisconnectNamedPipe(pipeHandle);
+				continue;
+			}
+		}
+
+		SPipeDeadline deadline { &overlapped, std::chrono::steady_clock::now() + std::chrono::milliseconds(clientTimeoutMs) };
+
+		std::string message;
+		if (!ReadMessage(pipeHandle, message, deadline))
+		{
+			FBXSDK_printf("Dropped a client that didn't send a request in time.\n");
+		}
+		else
+		{
+			auto startTime = std::chrono::steady_clock::now();
+			SServerJob job;
+			SServerJobResult result;
+
+			if (!ReadJob(message, job))
+			{
+				result.error = "Malformed request.";
+			}
+			else if (job.isShutdown)
+			{
+				isShutdown = true;
+				result.succeeded = true;
+			}
+			else
+			{
+				FBXSDK_printf("\n\nJob: %s\n", job.inputPath.c_str());
+
+				// The handler is expected to catch its own failures, which leaves it able to reset its scene; this only
+				// keeps anything that still escapes from ending the server.
+				try
+				{
+					handler(job, result);
+				}
+				catch (const std::exception& exception)
+				{
+					result.succeeded = false;
+					result.error = std::string("The job failed: ") + exception.what();
+				}
+				catch (...)
+				{
+					result.succeeded = false;
+					result.error = "The job failed with an unknown exception.";
+				}
+			}
+
+			// The reply gets a deadline of its own, as the job itself may have taken any amount of time.
+			result.totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+			deadline.time = std::chrono::steady_clock::now() + std::chrono::milliseconds(clientTimeoutMs);
+			WriteMessage(pipeHandle, WriteResult(result), deadline);
+			FlushFileBuffers(pipeHandle);
+		}
+
+		DisconnectNamedPipe(pipeHandle);
+	}
+
+	CloseHandle(overlapped.hEvent);
+	CloseHandle(pipeHandle);
+	return true;
+}
+
+
+bool SendServerJob(const std::string& pipeName, const SServerJob& job, SServerJobResult& result)
+{
+	std::wstring pipePath = GetPipePath(pipeName);
+	HANDLE pipeHandle = INVALID_HANDLE_VALUE;
+
+	// Every pipe instance is busy while the server works on another job, so wait for one to free up.
+	for (;;)
+	{
+		pipeHandle = CreateFileW(pipePath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+		if (pipeHandle != INVALID_HANDLE_VALUE)
+			break;
+
+		if ((GetLastError() != ERROR_PIPE_BUSY) || !WaitNamedPipeW(pipePath.c_str(), NMPWAIT_WAIT_FOREVER))
+			return false;
+	}
+
+	std::string message;
+	bool isReplied = WriteMessage(pipeHandle, WriteJob(job)) && ReadMessage(pipeHandle, message) && ReadResult(message, result);
+
+	CloseHandle(pipeHandle);
+	return isReplied;
+}
+
+
+void DisplayServerJobResult(const SServerJobResult& result)
+{
+	if (result.succeeded)
+		FBXSDK_printf("Job succeeded.\n");
+	else
+		FBXSDK_printf("Job failed. %s\n", result.error.c_str());
+
+	FBXSDK_printf("    Config: %.3f s\n", result.configSeconds);
+	FBXSDK_printf("    Load: %.3f s\n", result.loadSeconds);
+	FBXSDK_printf("    Transform: %.3f s\n", result.transformSeconds);
+	FBXSDK_printf("    Save: %.3f s\n", result.saveSeconds);
+	FBXSDK_printf("    Total: %.3f s\n", result.totalSeconds);
+}
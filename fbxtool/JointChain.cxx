@@ -0,0 +1,174 @@
+#include "JointChain.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+
+
+static std::string Trim(const std::string& text)
+{
+	const char* pWhitespace = " \t\r\n";
+	size_t first = text.find_first_not_of(pWhitespace);
+	if (first == std::string::npos)
+		return "";
+
+	return text.substr(first, text.find_last_not_of(pWhitespace) - first + 1);
+}
+
+
+std::vector<std::string> SplitJointFileList(const std::string& list)
+{
+	std::vector<std::string> paths;
+	size_t start = 0;
+
+	while (start <= list.size())
+	{
+		size_t end = list.find(',', start);
+		if (end == std::string::npos)
+			end = list.size();
+
+		std::string path = Trim(list.substr(start, end - start));
+		if (!path.empty())
+			paths.push_back(path);
+
+		start = end + 1;
+	}
+
+	return paths;
+}
+
+
+bool AddJointRename(SJointMapping& mapping, const std::string& oldName, const std::string& newName, std::string& error)
+{
+	auto existing = std::find_if(mapping.renames.begin(), mapping.renames.end(),
+		[&oldName](const std::pair<std::string, std::string>& rename) { return rename.first == oldName; });
+
+	if (existing == mapping.renames.end())
+	{
+		mapping.renames.emplace_back(oldName, newName);
+		return true;
+	}
+
+	if (existing->second == newName)
+		return true;
+
+	error = mapping.path + " renames " + oldName + " to both " + existing->second + " and " + newName;
+	return false;
+}
+
+
+bool ReadJointTextFile(const std::string& path, SJointMapping& mapping, std::string& error)
+{
+	std::ifstream textStream(path);
+	if (!textStream)
+	{
+		error = "Unable to open " + path;
+		return false;
+	}
+
+	mapping.path = path;
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(textStream, line); lineNumber++)
+	{
+		line = Trim(line);
+		if (line.empty() || (line [0] == '#'))
+			continue;
+
+		size_t equals = line.find('=');
+		std::string oldName = (equals != std::string::npos) ? Trim(line.substr(0, equals)) : "";
+		if (oldName.empty())
+		{
+			error = path + " line " + std::to_string(lineNumber) + " isn't an old=new pair";
+			return false;
+		}
+
+		if (!AddJointRename(mapping, oldName, Trim(line.substr(equals + 1)), error))
+			return false;
+	}
+
+	return true;
+}
+
+
+bool ComposeJointChain(const std::vector<SJointMapping>& mappings, SComposedJointChain& chain, std::string& error)
+{
+	chain = SComposedJointChain();
+
+	std::vector<std::map<std::string, std::string>> stages;
+	std::vector<std::string> domain;
+	std::set<std::string> seen;
+
+	for (size_t stage = 0; stage < mappings.size(); stage++)
+	{
+		if ((stage > 0) && !mappings [stage].patterns.empty())
+		{
+			error = mappings [stage].path + " has pattern rules, which only the first joint file of a chain may have";
+			return false;
+		}
+
+		stages.emplace_back(mappings [stage].renames.begin(), mappings [stage].renames.end());
+
+		// Any name a file renames might be in a scene, so each is followed through the whole chain.
+		for (const auto& rename : mappings [stage].renames)
+		{
+			if (seen.insert(rename.first).second)
+				domain.push_back(rename.first);
+		}
+	}
+
+	JointPatternSet patterns;
+	if (!mappings.empty() && !patterns.Compile(mappings [0].patterns, error))
+		return false;
+
+	for (const auto& name : domain)
+	{
+		SComposedJoint joint;
+		joint.names.push_back(name);
+
+		for (size_t stage = 0; stage < stages.size(); stage++)
+		{
+			const std::string& current = joint.names.back();
+			std::string next = current;
+
+			auto rename = stages [stage].find(current);
+			if (rename != stages [stage].end())
+			{
+				next = rename->second;
+			}
+			else
+			{
+				uint32_t rule = (stage == 0) ? patterns.Match(current.c_str()) : JointPatternSet::notFound;
+				if (rule != JointPatternSet::notFound)
+					next = patterns.Rename(rule, current.c_str());
+			}
+
+			// A file that gives a name back to one the chain already took it from undoes an earlier file.
+			if ((next != current) && (std::find(joint.names.begin(), joint.names.end(), next) != joint.names.end()))
+			{
+				error = "The joint files go round in a circle:";
+				for (const auto& step : joint.names)
+					error += " " + step + " ->";
+				error += " " + next;
+				return false;
+			}
+
+			joint.names.push_back(next);
+		}
+
+		chain.joints.push_back(std::move(joint));
+	}
+
+	if (mappings.size() > 1)
+	{
+		SComposedJointChain tail;
+		if (!ComposeJointChain(std::vector<SJointMapping>(mappings.begin() + 1, mappings.end()), tail, error))
+			return false;
+
+		for (const auto& joint : tail.joints)
+			chain.tail.emplace_back(joint.names.front(), joint.names.back());
+	}
+
+	return true;
+}
@@ -0,0 +1,477 @@
+#include "JointFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "rapidjson/document.h"
+#include "rapidjson/error/en.h"
+#include "rapidjson/schema.h"
+#include "rapidjson/stringbuffer.h"
+#include "AtomicFile.h"
+#include "ContentHash.h"
+
+
+// Bump whenever SJointFile or the layout below changes, so older cache files are ignored rather than misread.
+static const uint32_t jointCacheVersion = 1;
+static const char jointCacheMagic [8] = { 'F', 'B', 'X', 'J', 'O', 'I', 'N', 'T' };
+static const std::string jointCacheExtension = ".jointcache";
+
+// Each exact entry is one of a joint's names with its enhancements, and each rule one of the pattern kinds.
+static const char* jointFileSchema = R"({
+	"type": "object",
+	"properties": {
+		"axis": { "type": "string" },
+		"applyWeaponFix": { "type": "boolean" },
+		"addRoot": { "type": "boolean" },
+		"addRootChildName": { "type": "string" },
+		"addRootRootName": { "type": "string" },
+		"removeLeafName": { "type": "string" },
+		"joints": {
+			"type": "array",
+			"items": {
+				"oneOf": [
+					{
+						"type": "object",
+						"required": [ "old-name", "new-name" ],
+						"properties": {
+							"old-name": { "type": "string" },
+							"new-name": { "type": "string" },
+							"physics-proxy": { "type": "string" },
+							"ragdoll-proxy": { "type": "string" },
+							"primitive-type": { "type": "string" },
+							"parent-node": { "type": "string" }
+						}
+					},
+					{
+						"type": "object",
+						"required": [ "old-prefix", "new-prefix" ],
+						"properties": {
+							"old-prefix": { "type": "string" },
+							"new-prefix": { "type": "string" }
+						}
+					},
+					{
+						"type": "object",
+						"required": [ "old-suffix", "new-suffix" ],
+						"properties": {
+							"old-suffix": { "type": "string" },
+							"new-suffix": { "type": "string" }
+						}
+					},
+					{
+						"type": "object",
+						"required": [ "old-pattern", "new-name" ],
+						"properties": {
+							"old-pattern": { "type": "string" },
+							"new-name": { "type": "string" }
+						}
+					}
+				]
+			}
+		}
+	}
+})";
+
+
+// The parsed schema, shared by every load. Only read once built, so any thread can validate against it.
+static const rapidjson::SchemaDocument& GetJointFileSchema()
+{
+	static const rapidjson::SchemaDocument schema = []()
+	{
+		rapidjson::Document schemaDocument;
+		schemaDocument.Parse(jointFileSchema);
+		return rapidjson::SchemaDocument(schemaDocument);
+	}();
+
+	return schema;
+}
+
+
+static std::string GetString(const rapidjson::Value& object, const char* pName)
+{
+	auto member = object.FindMember(pName);
+	return (member != object.MemberEnd()) ? std::string(member->value.GetString(), member->value.GetStringLength()) : std::string();
+}
+
+
+static void ReadOptionalString(const rapidjson::Value& object, const char* pName, std::optional<std::string>& value)
+{
+	if (object.HasMember(pName))
+		value = GetString(object, pName);
+}
+
+
+static void ReadOptionalBool(const rapidjson::Value& object, const char* pName, std::optional<bool>& value)
+{
+	auto member = object.FindMember(pName);
+	if (member != object.MemberEnd())
+		value = member->value.GetBool();
+}
+
+
+// Parse the file's text, which is overwritten in the process, and check it against the schema.
+static bool ParseJointFile(const std::string& path, std::vector<char>& text, SJointFile& jointFile, std::string& error)
+{
+	text.push_back('\0');
+
+	rapidjson::Document document;
+	if (document.ParseInsitu(text.data()).HasParseError())
+	{
+		error = path + " isn't valid JSON at offset " + std::to_string(document.GetErrorOffset()) + ": "
+			+ rapidjson::GetParseError_En(document.GetParseError());
+		return false;
+	}
+
+	rapidjson::SchemaValidator validator(GetJointFileSchema());
+	if (!document.Accept(validator))
+	{
+		rapidjson::StringBuffer location;
+		validator.GetInvalidDocumentPointer().Stringify(location);
+
+		error = path + " doesn't match the joint file schema at " + (location.GetSize() ? location.GetString() : "the top level")
+			+ ", failing its " + validator.GetInvalidSchemaKeyword() + " rule";
+		return false;
+	}
+
+	auto joints = document.FindMember("joints");
+	if (joints != document.MemberEnd())
+	{
+		for (const auto& entry : joints->value.GetArray())
+		{
+			if (entry.HasMember("old-prefix"))
+			{
+				jointFile.patterns.push_back(MakePrefixPattern(GetString(entry, "old-prefix"), GetString(entry, "new-prefix")));
+			}
+			else if (entry.HasMember("old-suffix"))
+			{
+				jointFile.patterns.push_back(MakeSuffixPattern(GetString(entry, "old-suffix"), GetString(entry, "new-suffix")));
+			}
+			else if (entry.HasMember("old-pattern"))
+			{
+				jointFile.patterns.push_back(SJointPattern { GetString(entry, "old-pattern"), GetString(entry, "new-name") });
+			}
+			else
+			{
+				SJointFileJoint joint;
+				joint.oldName = GetString(entry, "old-name");
+				joint.newName = GetString(entry, "new-name");
+				joint.physicsProxy = GetString(entry, "physics-proxy");
+				joint.ragdollProxy = GetString(entry, "ragdoll-proxy");
+				joint.primitiveType = GetString(entry, "primitive-type");
+				joint.parentNode = GetString(entry, "parent-node");
+				jointFile.joints.push_back(std::move(joint));
+			}
+		}
+	}
+
+	ReadOptionalString(document, "axis", jointFile.axis);
+	ReadOptionalBool(document, "applyWeaponFix", jointFile.applyWeaponFix);
+	ReadOptionalBool(document, "addRoot", jointFile.addRoot);
+	ReadOptionalString(document, "addRootChildName", jointFile.addRootChildName);
+	ReadOptionalString(document, "addRootRootName", jointFile.addRootRootName);
+	ReadOptionalString(document, "removeLeafName", jointFile.removeLeafName);
+
+	return true;
+}
+
+
+// The cache's layout: the magic, version, the joint file's hash and size, then the contents, with integers little
+// endian and strings as a 32 bit length and their bytes. Settings a file leaves out are flagged as absent. A hash of
+// all that comes last, so a damaged name is caught rather than used.
+class CacheWriter
+{
+public:
+	void Write(const void* pData, size_t size) { mBytes.append(static_cast<const char*>(pData), size); }
+
+	void WriteU32(uint32_t value)
+	{
+		unsigned char bytes [4] = { static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8),
+			static_cast<unsigned char>(value >> 16), static_cast<unsigned char>(value >> 24) };
+		Write(bytes, sizeof(bytes));
+	}
+
+	void WriteU64(uint64_t value)
+	{
+		WriteU32(static_cast<uint32_t>(value));
+		WriteU32(static_cast<uint32_t>(value >> 32));
+	}
+
+	void WriteString(const std::string& text)
+	{
+		WriteU32(static_cast<uint32_t>(text.size()));
+		Write(text.data(), text.size());
+	}
+
+	void WriteOptional(const std::optional<std::string>& value)
+	{
+		WriteU32(value.has_value() ? 1 : 0);
+		WriteString(value.value_or(""));
+	}
+
+	void WriteOptional(const std::optional<bool>& value)
+	{
+		WriteU32(value.has_value() ? (*value ? 2 : 1) : 0);
+	}
+
+	const std::string& GetBytes() const { return mBytes; }
+
+private:
+	std::string mBytes;
+};
+
+
+// Reads what CacheWriter wrote, failing rather than reading past the end of a damaged file.
+class CacheReader
+{
+public:
+	CacheReader(const std::vector<char>& bytes) : mBytes(bytes) {}
+
+	bool Read(void* pData, size_t size)
+	{
+		if (mBytes.size() - mPosition < size)
+			return false;
+
+		memcpy(pData, mBytes.data() + mPosition, size);
+		mPosition += size;
+		return true;
+	}
+
+	bool ReadU32(uint32_t& value)
+	{
+		unsigned char bytes [4];
+		if (!Read(bytes, sizeof(bytes)))
+			return false;
+
+		value = bytes [0] | (bytes [1] << 8) | (bytes [2] << 16) | (static_cast<uint32_t>(bytes [3]) << 24);
+		return true;
+	}
+
+	bool ReadU64(uint64_t& value)
+	{
+		uint32_t low = 0, high = 0;
+		if (!ReadU32(low) || !ReadU32(high))
+			return false;
+
+		value = low | (static_cast<uint64_t>(high) << 32);
+		return true;
+	}
+
+	bool ReadString(std::string& text)
+	{
+		uint32_t size = 0;
+		if (!ReadU32(size) || (mBytes.size() - mPosition < size))
+			return false;
+
+		text.assign(mBytes.data() + mPosition, size);
+		mPosition += size;
+		return true;
+	}
+
+	bool ReadOptional(std::optional<std::string>& value)
+	{
+		uint32_t isPresent = 0;
+		std::string text;
+		if (!ReadU32(isPresent) || !ReadString(text))
+			return false;
+
+		if (isPresent)
+			value = text;
+		return true;
+	}
+
+	bool ReadOptional(std::optional<bool>& value)
+	{
+		uint32_t state = 0;
+		if (!ReadU32(state))
+			return false;
+
+		if (state != 0)
+			value = (state == 2);
+		return true;
+	}
+
+	// Counts are checked against what's left, so a damaged count can't ask for a huge allocation.
+	bool ReadCount(uint32_t& count, size_t minimumEntrySize)
+	{
+		return ReadU32(count) && ((mBytes.size() - mPosition) / minimumEntrySize >= count);
+	}
+
+	bool IsAtEnd() const { return mPosition == mBytes.size(); }
+
+private:
+	const std::vector<char>& mBytes;
+	size_t mPosition { 0 };
+};
+
+
+static std::string WriteJointCache(const SJointFile& jointFile, uint64_t hash, uint64_t size)
+{
+	CacheWriter writer;
+	writer.Write(jointCacheMagic, sizeof(jointCacheMagic));
+	writer.WriteU32(jointCacheVersion);
+	writer.WriteU64(hash);
+	writer.WriteU64(size);
+
+	writer.WriteU32(static_cast<uint32_t>(jointFile.joints.size()));
+	for (const auto& joint : jointFile.joints)
+	{
+		writer.WriteString(joint.oldName);
+		writer.WriteString(joint.newName);
+		writer.WriteString(joint.physicsProxy);
+		writer.WriteString(joint.ragdollProxy);
+		writer.WriteString(joint.primitiveType);
+		writer.WriteString(joint.parentNode);
+	}
+
+	writer.WriteU32(static_cast<uint32_t>(jointFile.patterns.size()));
+	for (const auto& pattern : jointFile.patterns)
+	{
+		writer.WriteString(pattern.pattern);
+		writer.WriteString(pattern.newName);
+	}
+
+	writer.WriteOptional(jointFile.axis);
+	writer.WriteOptional(jointFile.applyWeaponFix);
+	writer.WriteOptional(jointFile.addRoot);
+	writer.WriteOptional(jointFile.addRootChildName);
+	writer.WriteOptional(jointFile.addRootRootName);
+	writer.WriteOptional(jointFile.removeLeafName);
+
+	ContentHash check;
+	check.Update(writer.GetBytes());
+	writer.WriteU64(check.Finish());
+
+	return writer.GetBytes();
+}
+
+
+// False if the cache file is missing, from another version, for other content, or damaged.
+static bool ReadJointCache(const std::filesystem::path& cachePath, uint64_t hash, uint64_t size, SJointFile& jointFile)
+{
+	std::ifstream cacheStream(cachePath, std::ios::binary);
+	if (!cacheStream)
+		return false;
+
+	std::vector<char> bytes((std::istreambuf_iterator<char>(cacheStream)), std::istreambuf_iterator<char>());
+	if (bytes.size() < sizeof(uint64_t))
+		return false;
+
+	std::vector<char> checkBytes(bytes.end() - sizeof(uint64_t), bytes.end());
+	bytes.resize(bytes.size() - sizeof(uint64_t));
+
+	uint64_t check = 0;
+	ContentHash expectedCheck;
+	expectedCheck.Update(bytes.data(), bytes.size());
+	if (!CacheReader(checkBytes).ReadU64(check) || (check != expectedCheck.Finish()))
+		return false;
+
+	CacheReader reader(bytes);
+
+	char magic [sizeof(jointCacheMagic)];
+	uint32_t version = 0;
+	uint64_t cachedHash = 0, cachedSize = 0;
+	if (!reader.Read(magic, sizeof(magic)) || (memcmp(magic, jointCacheMagic, sizeof(magic)) != 0)
+		|| !reader.ReadU32(version) || (version != jointCacheVersion)
+		|| !reader.ReadU64(cachedHash) || (cachedHash != hash) || !reader.ReadU64(cachedSize) || (cachedSize != size))
+	{
+		return false;
+	}
+
+	SJointFile cached;
+	uint32_t jointCount = 0;
+	if (!reader.ReadCount(jointCount, 6 * sizeof(uint32_t)))
+		return false;
+
+	cached.joints.resize(jointCount);
+	for (auto& joint : cached.joints)
+	{
+		if (!reader.ReadString(joint.oldName) || !reader.ReadString(joint.newName) || !reader.ReadString(joint.physicsProxy)
+			|| !reader.ReadString(joint.ragdollProxy) || !reader.ReadString(joint.primitiveType) || !reader.ReadString(joint.parentNode))
+		{
+			return false;
+		}
+	}
+
+	uint32_t patternCount = 0;
+	if (!reader.ReadCount(patternCount, 2 * sizeof(uint32_t)))
+		return false;
+
+	cached.patterns.resize(patternCount);
+	for (auto& pattern : cached.patterns)
+	{
+		if (!reader.ReadString(pattern.pattern) || !reader.ReadString(pattern.newName))
+			return false;
+	}
+
+	if (!reader.ReadOptional(cached.axis) || !reader.ReadOptional(cached.applyWeaponFix) || !reader.ReadOptional(cached.addRoot)
+		|| !reader.ReadOptional(cached.addRootChildName) || !reader.ReadOptional(cached.addRootRootName)
+		|| !reader.ReadOptional(cached.removeLeafName) || !reader.IsAtEnd())
+	{
+		return false;
+	}
+
+	jointFile = std::move(cached);
+	return true;
+}
+
+
+bool LoadJointFile(const std::string& path, const std::filesystem::path& cacheDirectory, SJointFile& jointFile, bool& isFromCache,
+	std::string& error)
+{
+	isFromCache = false;
+	jointFile = SJointFile();
+
+	// One read of the whole file, which is both hashed and parsed in place.
+	std::ifstream jointStream(path, std::ios::binary);
+	if (!jointStream)
+	{
+		error = "Unable to open " + path;
+		return false;
+	}
+
+	std::vector<char> text((std::istreambuf_iterator<char>(jointStream)), std::istreambuf_iterator<char>());
+	jointStream.close();
+
+	// The hash has to be taken before parsing, which overwrites the text.
+	ContentHash contentHash;
+	contentHash.Update(text.data(), text.size());
+	uint64_t hash = contentHash.Finish();
+	uint64_t size = text.size();
+
+	std::filesystem::path cachePath;
+	if (!cacheDirectory.empty())
+	{
+		cachePath = cacheDirectory / (HashToHex(hash) + jointCacheExtension);
+		if (ReadJointCache(cachePath, hash, size, jointFile))
+		{
+			isFromCache = true;
+			return true;
+		}
+	}
+
+	if (!ParseJointFile(path, text, jointFile, error))
+		return false;
+
+	// The cache only saves time, so failing to write it isn't an error.
+	if (!cachePath.empty())
+	{
+		std::error_code directoryError;
+		std::filesystem::create_directories(cacheDirectory, directoryError);
+
+		std::string bytes = WriteJointCache(jointFile, hash, size);
+		PublishFile(cachePath.wstring(), bytes.data(), bytes.size(), eFileSyncNone);
+	}
+
+	return true;
+}
+
+
+std::filesystem::path GetDefaultJointCacheDirectory()
+{
+	std::error_code error;
+	std::filesystem::path temporaryDirectory = std::filesystem::temp_directory_path(error);
+
+	return error ? std::filesystem::path() : temporaryDirectory / "fbxtool-joint-cache";
+}
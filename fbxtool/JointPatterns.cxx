@@ -0,0 +1,286 @@
+#include "JointPatterns.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+
+// Pattern tokens other than plain bytes.
+static const int anyRunToken = -1;
+static const int anyCharToken = -2;
+
+// Enough for hundreds of rules of the usual shapes; only many overlapping wildcards get near it.
+static const size_t maxDfaStates = 20000;
+
+
+// A backslash makes the next character literal, so names with * or ? in them can still be matched.
+static std::vector<int> Tokenize(const std::string& pattern)
+{
+	std::vector<int> tokens;
+	for (size_t i = 0; i < pattern.size(); i++)
+	{
+		if ((pattern [i] == '\\') && (i + 1 < pattern.size()))
+			tokens.push_back(static_cast<unsigned char>(pattern [++i]));
+		else if (pattern [i] == '*')
+			tokens.push_back(anyRunToken);
+		else if (pattern [i] == '?')
+			tokens.push_back(anyCharToken);
+		else
+			tokens.push_back(static_cast<unsigned char>(pattern [i]));
+	}
+
+	return tokens;
+}
+
+
+static std::string EscapePattern(const std::string& text)
+{
+	std::string escaped;
+	for (char c : text)
+	{
+		if ((c == '\\') || (c == '*') || (c == '?'))
+			escaped += '\\';
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+
+static std::string EscapeNewName(const std::string& text)
+{
+	std::string escaped;
+	for (char c : text)
+	{
+		if (c == '$')
+			escaped += '$';
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+
+SJointPattern MakePrefixPattern(const std::string& oldPrefix, const std::string& newPrefix)
+{
+	return SJointPattern { EscapePattern(oldPrefix) + "*", EscapeNewName(newPrefix) + "$1" };
+}
+
+
+SJointPattern MakeSuffixPattern(const std::string& oldSuffix, const std::string& newSuffix)
+{
+	return SJointPattern { "*" + EscapePattern(oldSuffix), "$1" + EscapeNewName(newSuffix) };
+}
+
+
+// Match a name against one rule's tokens, recording where each group starts and ends. Wildcards take as little as
+// they can, leaving the rest to the literal text after them.
+static bool MatchGroups(const std::vector<int>& tokens, size_t token, const char* pName,
+	std::vector<std::pair<const char*, const char*>>& groups)
+{
+	for (; token < tokens.size(); token++)
+	{
+		if (tokens [token] == anyRunToken)
+		{
+			for (const char* pEnd = pName; ; pEnd++)
+			{
+				groups.emplace_back(pName, pEnd);
+				if (MatchGroups(tokens, token + 1, pEnd, groups))
+					return true;
+				groups.pop_back();
+
+				if (*pEnd == '\0')
+					return false;
+			}
+		}
+
+		if (*pName == '\0')
+			return false;
+
+		if (tokens [token] == anyCharToken)
+			groups.emplace_back(pName, pName + 1);
+		else if (tokens [token] != static_cast<unsigned char>(*pName))
+			return false;
+
+		pName++;
+	}
+
+	return *pName == '\0';
+}
+
+
+JointPatternSet::JointPatternSet()
+	: mTransitions(1, 0), mAccepts(1, notFound)
+{
+	memset(mByteClasses, 0, sizeof(mByteClasses));
+}
+
+
+bool JointPatternSet::Compile(const std::vector<SJointPattern>& patterns, std::string& error)
+{
+	*this = JointPatternSet();
+	mPatterns = patterns;
+
+	for (const auto& pattern : patterns)
+	{
+		mTokens.push_back(Tokenize(pattern.pattern));
+		size_t groupCount = std::count_if(mTokens.back().begin(), mTokens.back().end(), [](int token) { return token < 0; });
+
+		for (size_t i = 0; i + 1 < pattern.newName.size(); i++)
+		{
+			if (pattern.newName [i] != '$')
+				continue;
+
+			char next = pattern.newName [++i];
+			if ((next != '$') && ((next < '1') || (next > '9') || (static_cast<size_t>(next - '0') > groupCount)))
+			{
+				error = "The rule for " + pattern.pattern + " uses a group it doesn't have";
+				return false;
+			}
+		}
+
+		for (int token : mTokens.back())
+		{
+			if ((token >= 0) && (mByteClasses [token] == 0))
+				mByteClasses [token] = static_cast<uint8_t>(mClassCount++);
+		}
+	}
+
+	// A byte for each class, to step the NFA with. Class 0 needs one no pattern uses, if there is such a byte.
+	std::vector<int> classBytes(mClassCount, -1);
+	for (int byte = 255; byte > 0; byte--)
+		classBytes [mByteClasses [byte]] = byte;
+
+	// NFA states are a rule and a position in its tokens, numbered from each rule's base.
+	std::vector<uint32_t> ruleBases;
+	uint32_t nfaStateCount = 0;
+	for (const auto& tokens : mTokens)
+	{
+		ruleBases.push_back(nfaStateCount);
+		nfaStateCount += static_cast<uint32_t>(tokens.size() + 1);
+	}
+
+	auto close = [&](std::vector<uint32_t>& states)
+	{
+		// A run wildcard can match nothing, so being before one is also being after it.
+		for (size_t i = 0; i < states.size(); i++)
+		{
+			uint32_t rule = static_cast<uint32_t>(std::upper_bound(ruleBases.begin(), ruleBases.end(), states [i]) - ruleBases.begin() - 1);
+			uint32_t position = states [i] - ruleBases [rule];
+			if ((position < mTokens [rule].size()) && (mTokens [rule][position] == anyRunToken))
+				states.push_back(states [i] + 1);
+		}
+
+		std::sort(states.begin(), states.end());
+		states.erase(std::unique(states.begin(), states.end()), states.end());
+	};
+
+	std::map<std::vector<uint32_t>, uint32_t> stateIds;
+	std::vector<std::vector<uint32_t>> stateSets;
+
+	auto addState = [&](std::vector<uint32_t> states)
+	{
+		auto existing = stateIds.find(states);
+		if (existing != stateIds.end())
+			return existing->second;
+
+		uint32_t id = static_cast<uint32_t>(stateSets.size());
+		stateIds.emplace(states, id);
+		stateSets.push_back(std::move(states));
+		return id;
+	};
+
+	// State 0 is the empty set, which matches nothing.
+	addState(std::vector<uint32_t>());
+
+	std::vector<uint32_t> startStates(ruleBases.begin(), ruleBases.end());
+	close(startStates);
+	mStartState = addState(startStates);
+
+	mTransitions.clear();
+	mAccepts.clear();
+
+	for (uint32_t id = 0; id < stateSets.size(); id++)
+	{
+		if (stateSets.size() > maxDfaStates)
+		{
+			error = "The joint patterns are too tangled to compile; try fewer wildcards";
+			return false;
+		}
+
+		uint32_t accept = notFound;
+		std::vector<std::vector<uint32_t>> nextStates(mClassCount);
+
+		for (uint32_t state : stateSets [id])
+		{
+			uint32_t rule = static_cast<uint32_t>(std::upper_bound(ruleBases.begin(), ruleBases.end(), state) - ruleBases.begin() - 1);
+			uint32_t position = state - ruleBases [rule];
+			const std::vector<int>& tokens = mTokens [rule];
+
+			if (position == tokens.size())
+			{
+				accept = (std::min)(accept, rule);
+				continue;
+			}
+
+			for (size_t byteClass = 0; byteClass < mClassCount; byteClass++)
+			{
+				int byte = classBytes [byteClass];
+				if (byte < 0)
+					continue;
+
+				if (tokens [position] == anyRunToken)
+					nextStates [byteClass].push_back(state);
+				else if ((tokens [position] == anyCharToken) || (tokens [position] == byte))
+					nextStates [byteClass].push_back(state + 1);
+			}
+		}
+
+		mAccepts.push_back(accept);
+		for (auto& next : nextStates)
+		{
+			close(next);
+			mTransitions.push_back(addState(std::move(next)));
+		}
+	}
+
+	return true;
+}
+
+
+uint32_t JointPatternSet::Match(const char* pName) const
+{
+	uint32_t state = mStartState;
+	for (const unsigned char* pCursor = reinterpret_cast<const unsigned char*>(pName); *pCursor && (state != 0); pCursor++)
+		state = mTransitions [state * mClassCount + mByteClasses [*pCursor]];
+
+	return mAccepts [state];
+}
+
+
+std::string JointPatternSet::Rename(uint32_t rule, const char* pName) const
+{
+	std::vector<std::pair<const char*, const char*>> groups;
+	if (!MatchGroups(mTokens [rule], 0, pName, groups))
+		return pName;
+
+	const std::string& newName = mPatterns [rule].newName;
+	std::string renamed;
+
+	for (size_t i = 0; i < newName.size(); i++)
+	{
+		if ((newName [i] != '$') || (i + 1 == newName.size()))
+		{
+			renamed += newName [i];
+			continue;
+		}
+
+		char next = newName [++i];
+		if (next == '$')
+			renamed += '$';
+		else
+			renamed.append(groups [next - '1'].first, groups [next - '1'].second);
+	}
+
+	return renamed;
+}
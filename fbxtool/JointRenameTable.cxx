@@ -0,0 +1,199 @@
+#include "JointRenameTable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+
+// FNV-1a, which also measures the name as it goes, so a lookup reads the name once.
+static uint64_t HashName(const char* pName, size_t& length)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	const char* pCursor = pName;
+
+	for (; *pCursor; pCursor++)
+	{
+		hash ^= static_cast<unsigned char>(*pCursor);
+		hash *= 0x100000001b3ull;
+	}
+
+	length = static_cast<size_t>(pCursor - pName);
+	return hash;
+}
+
+
+JointRenameTable::JointRenameTable()
+	: mSlots(1, notFound)
+{
+}
+
+
+JointRenameTable::JointRenameTable(const std::vector<std::pair<std::string, std::string>>& renames)
+{
+	size_t slotCount = 2;
+	while (slotCount < renames.size() * 2)
+		slotCount *= 2;
+
+	mSlots.assign(slotCount, notFound);
+	mSlotMask = slotCount - 1;
+
+	for (const auto& rename : renames)
+	{
+		uint32_t existing = Find(rename.first.c_str());
+		if (existing != notFound)
+		{
+			mEntries [existing].newName = Intern(rename.second);
+			continue;
+		}
+
+		SEntry entry;
+		size_t length = 0;
+		entry.hash = HashName(rename.first.c_str(), length);
+		entry.oldLength = static_cast<uint32_t>(length);
+		entry.oldName = Intern(rename.first);
+		entry.newName = Intern(rename.second);
+
+		uint64_t slot = entry.hash & mSlotMask;
+		while (mSlots [slot] != notFound)
+			slot = (slot + 1) & mSlotMask;
+
+		mSlots [slot] = static_cast<uint32_t>(mEntries.size());
+		mEntries.push_back(entry);
+	}
+}
+
+
+uint32_t JointRenameTable::Find(const char* pName) const
+{
+	size_t length = 0;
+	uint64_t hash = HashName(pName, length);
+
+	// The table is never more than half full, so there is always an empty slot to stop at.
+	for (uint64_t slot = hash & mSlotMask; mSlots [slot] != notFound; slot = (slot + 1) & mSlotMask)
+	{
+		const SEntry& entry = mEntries [mSlots [slot]];
+		if ((entry.hash == hash) && (entry.oldLength == length) && (memcmp(mNames.data() + entry.oldName, pName, length) == 0))
+			return mSlots [slot];
+	}
+
+	return notFound;
+}
+
+
+const char* JointRenameTable::GetOldName(uint32_t index) const
+{
+	return mNames.c_str() + mEntries [index].oldName;
+}
+
+
+const char* JointRenameTable::GetNewName(uint32_t index) const
+{
+	return mNames.c_str() + mEntries [index].newName;
+}
+
+
+uint32_t JointRenameTable::Intern(const std::string& name)
+{
+	uint32_t offset = static_cast<uint32_t>(mNames.size());
+	mNames += name;
+	mNames += '\0';
+
+	return offset;
+}
+
+
+// Shaped like the joint file's entries, so the copies cost what they used to.
+struct SBenchmarkJoint
+{
+	std::string oldName;
+	std::string newName;
+	std::string physicsProxy;
+	std::string ragdollProxy;
+	std::string primitiveType;
+	std::string parentNode;
+};
+
+using BenchmarkJointMap = std::map<std::string, SBenchmarkJoint>;
+
+
+// The old path: the map is passed by value to each step, and searched by string in each.
+static size_t RenameByMap(BenchmarkJointMap jointMap, const std::string& indexName)
+{
+	return (jointMap.find(indexName) != jointMap.end()) ? jointMap [indexName].newName.size() : 0;
+}
+
+static size_t EnhanceByMap(BenchmarkJointMap jointMap, const std::string& indexName)
+{
+	return (jointMap.find(indexName) != jointMap.end()) ? 1 : 0;
+}
+
+static size_t LookUpByMap(BenchmarkJointMap jointMap, const char* pName)
+{
+	if (jointMap.find(std::string(pName)) == jointMap.end())
+		return 0;
+
+	std::string indexName = jointMap [std::string(pName)].oldName;
+	return RenameByMap(jointMap, indexName) + EnhanceByMap(jointMap, indexName);
+}
+
+
+void BenchmarkJointRenames(const std::vector<std::pair<std::string, std::string>>& renames, int boneCount, int runs)
+{
+	BenchmarkJointMap jointMap;
+	for (const auto& rename : renames)
+	{
+		SBenchmarkJoint& joint = jointMap [rename.first];
+		joint.oldName = rename.first;
+		joint.newName = rename.second;
+	}
+
+	std::vector<std::string> bones;
+	for (const auto& rename : renames)
+	{
+		if (bones.size() < static_cast<size_t>(boneCount))
+			bones.push_back(rename.first);
+	}
+	while (bones.size() < static_cast<size_t>(boneCount))
+		bones.push_back("Unmapped_Bone_" + std::to_string(bones.size()));
+
+	auto compileStart = std::chrono::steady_clock::now();
+	JointRenameTable table(renames);
+	double compileSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - compileStart).count();
+
+	std::vector<double> mapTimes, tableTimes;
+	size_t mapChecksum = 0, tableChecksum = 0;
+
+	for (int run = 0; run < runs; run++)
+	{
+		auto mapStart = std::chrono::steady_clock::now();
+		for (const auto& bone : bones)
+			mapChecksum += LookUpByMap(jointMap, bone.c_str());
+		mapTimes.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - mapStart).count());
+
+		auto tableStart = std::chrono::steady_clock::now();
+		for (const auto& bone : bones)
+		{
+			uint32_t index = table.Find(bone.c_str());
+			tableChecksum += (index != JointRenameTable::notFound) ? strlen(table.GetNewName(index)) + 1 : 0;
+		}
+		tableTimes.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - tableStart).count());
+	}
+
+	auto report = [boneCount](const char* pName, std::vector<double> times)
+	{
+		std::sort(times.begin(), times.end());
+		double median = times [times.size() / 2];
+		printf("    %-16s median %.3f ms, best %.3f ms, %.0f ns per bone\n", pName, median * 1000.0, times.front() * 1000.0,
+			median * 1e9 / boneCount);
+	};
+
+	printf("\nJoint rename benchmark, %d run(s) of a %d bone rig with %zu renames\n", runs, boneCount, table.GetSize());
+	printf("    %-16s %.3f ms\n", "Compiling table", compileSeconds * 1000.0);
+	report("Map copies", mapTimes);
+	report("Compiled table", tableTimes);
+
+	if (mapChecksum != tableChecksum)
+		printf("The compiled table found different renames from the map.\n");
+}
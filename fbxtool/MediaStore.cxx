@@ -0,0 +1,195 @@
+#include "MediaStore.h"
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+#include "BinaryFbxReader.h"
+#include "ContentHash.h"
+
+
+// Extensions are kept so the blobs still open in image viewers, but only if they look like extensions.
+static const size_t maxExtensionLength = 8;
+
+
+static std::wstring GetExtension(const std::string& fileName)
+{
+	size_t dot = fileName.find_last_of('.');
+	size_t separator = fileName.find_last_of("/\\");
+	if ((dot == std::string::npos) || ((separator != std::string::npos) && (dot < separator)))
+		return std::wstring();
+
+	std::wstring extension = L".";
+	for (size_t i = dot + 1; i < fileName.size(); i++)
+	{
+		unsigned char c = static_cast<unsigned char>(fileName [i]);
+		if (!isalnum(c) || (extension.size() > maxExtensionLength))
+			return std::wstring();
+
+		extension += static_cast<wchar_t>(tolower(c));
+	}
+
+	return (extension.size() > 1) ? extension : std::wstring();
+}
+
+
+// Finds the Video objects in a binary FBX file and stores the content of those with media embedded in them.
+class EmbeddedMediaVisitor : public BinaryFbxVisitor
+{
+public:
+	EmbeddedMediaVisitor(std::map<std::string, std::wstring>& extracted, const std::function<bool(const char*, size_t,
+		const std::string&, std::wstring&)>& store)
+		: mExtracted(extracted), mStore(store)
+	{
+	}
+
+	bool BeginRecord(const SBinaryFbxRecord& record) override
+	{
+		const std::vector<SBinaryFbxProperty>& properties = record.properties;
+
+		switch (record.depth)
+		{
+			case 0:
+				return record.name == "Objects";
+
+			case 1:
+				mFileNames.clear();
+				mBlobPath.clear();
+				return record.name == "Video";
+
+			case 2:
+				if (properties.empty())
+					return false;
+
+				if (((record.name == "Filename") || (record.name == "RelativeFilename")) && (properties [0].type == 'S'))
+					mFileNames.push_back(properties [0].GetString());
+
+				// Videos that only refer to a file have no content, or an empty one.
+				if ((record.name == "Content") && (properties [0].type == 'R') && (properties [0].size > 0))
+				{
+					std::string fileName = mFileNames.empty() ? std::string() : mFileNames.front();
+					if (!mStore(properties [0].pData, properties [0].size, fileName, mBlobPath))
+						isStoreFailed = true;
+				}
+
+				return false;
+		}
+
+		return false;
+	}
+
+	void EndRecord(const std::string& name, int depth) override
+	{
+		if ((depth != 1) || (name != "Video") || mBlobPath.empty())
+			return;
+
+		for (const auto& fileName : mFileNames)
+		{
+			if (!fileName.empty())
+				mExtracted [fileName] = mBlobPath;
+		}
+	}
+
+	bool isStoreFailed { false };
+
+private:
+	std::map<std::string, std::wstring>& mExtracted;
+	std::function<bool(const char*, size_t, const std::string&, std::wstring&)> mStore;
+
+	// The names and stored content of the Video being visited.
+	std::vector<std::string> mFileNames;
+	std::wstring mBlobPath;
+};
+
+
+MediaStore::MediaStore(const std::wstring& directory, EFileSyncPolicy syncPolicy)
+	: mDirectory(directory), mSyncPolicy(syncPolicy)
+{
+}
+
+
+EMediaExtractResult MediaStore::ExtractEmbeddedMedia(const std::wstring& fbxPath,
+	std::map<std::string, std::wstring>& extracted, std::string& error)
+{
+	std::ifstream fileStream(std::filesystem::path(fbxPath), std::ios::binary);
+	if (!fileStream)
+	{
+		error = "Unable to open the file";
+		return eMediaFailed;
+	}
+
+	std::error_code directoryError;
+	std::filesystem::create_directories(mDirectory, directoryError);
+
+	EmbeddedMediaVisitor visitor(extracted, [this](const char* pData, size_t size, const std::string& fileName,
+		std::wstring& blobPath)
+	{
+		return StoreBlob(pData, size, fileName, blobPath);
+	});
+
+	// The version is only set once the header has been recognised.
+	BinaryFbxReader reader(fileStream);
+	if (!reader.Read(visitor))
+	{
+		error = reader.GetError();
+		return (reader.GetVersion() == 0) ? eMediaUnsupported : eMediaFailed;
+	}
+
+	if (visitor.isStoreFailed)
+	{
+		error = "Unable to write to the media store";
+		return eMediaFailed;
+	}
+
+	return eMediaExtracted;
+}
+
+
+bool MediaStore::StoreBlob(const char* pData, size_t size, const std::string& fileName, std::wstring& blobPath)
+{
+	ContentHash hash;
+	hash.Update(pData, size);
+
+	std::wstring hexName;
+	for (char c : HashToHex(hash.Finish()))
+		hexName += static_cast<wchar_t>(c);
+
+	blobPath = (std::filesystem::path(mDirectory) / (hexName + GetExtension(fileName))).wstring();
+
+	// Workers share a temporary name for the same blob, so only one writes at a time. Once a library has been through
+	// the store, almost every blob is already there and nothing is written.
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// The same content always lands on the same name, so a blob of the right size is the one wanted.
+	std::error_code sizeError;
+	uintmax_t storedSize = std::filesystem::file_size(blobPath, sizeError);
+	bool isStored = !sizeError && (storedSize == size);
+
+	if (!isStored && !PublishFile(blobPath, pData, size, mSyncPolicy))
+		return false;
+
+	mStats.mediaCount++;
+	mStats.mediaBytes += size;
+
+	if (isStored)
+	{
+		mStats.reusedCount++;
+		mStats.reusedBytes += size;
+	}
+	else
+	{
+		mStats.writtenCount++;
+		mStats.writtenBytes += size;
+	}
+
+	return true;
+}
+
+
+SMediaStoreStats MediaStore::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
@@ -0,0 +1,325 @@
+#include "MemoryStream.h"
+
+#include <cstring>
+#include <windows.h>
+
+
+MemoryReadStream::MemoryReadStream(FbxManager* pManager)
+{
+	mReaderID = pManager->GetIOPluginRegistry()->FindReaderIDByExtension("fbx");
+}
+
+
+MemoryReadStream::MemoryReadStream(FbxManager* pManager, const void* pData, size_t size)
+	: MemoryReadStream(pManager)
+{
+	mpData = static_cast<const char*>(pData);
+	mSize = size;
+}
+
+
+MemoryReadStream::~MemoryReadStream()
+{
+	Unmap();
+}
+
+
+bool MemoryReadStream::MapFile(const std::wstring& path)
+{
+	Unmap();
+
+	HANDLE fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	// A file of nothing can't be mapped, and isn't an FBX file anyway.
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || (fileSize.QuadPart <= 0))
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	// The mapping holds the file open by itself.
+	HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(fileHandle);
+	if (!mappingHandle)
+		return false;
+
+	void* pView = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!pView)
+	{
+		CloseHandle(mappingHandle);
+		return false;
+	}
+
+	mMappingHandle = mappingHandle;
+	mpData = static_cast<const char*>(pView);
+	mSize = static_cast<size_t>(fileSize.QuadPart);
+
+	// The importer reads the whole file from front to back, so ask for all of it to be read in ahead of the page
+	// faults, in large requests. Only a hint: if it fails the pages are faulted in as they are reached.
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = pView;
+	range.NumberOfBytes = mSize;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+	return true;
+}
+
+
+void MemoryReadStream::Unmap()
+{
+	if (mMappingHandle)
+	{
+		UnmapViewOfFile(mpData);
+		CloseHandle(static_cast<HANDLE>(mMappingHandle));
+		mMappingHandle = nullptr;
+	}
+
+	mpData = nullptr;
+	mSize = 0;
+	mPosition = 0;
+	mState = eClosed;
+}
+
+
+FbxStream::EState MemoryReadStream::GetState()
+{
+	return mState;
+}
+
+
+bool MemoryReadStream::Open(void* /*pStreamData*/)
+{
+	if (!mpData)
+		return false;
+
+	mState = eOpen;
+	mPosition = 0;
+	return true;
+}
+
+
+bool MemoryReadStream::Close()
+{
+	// The data outlives the close; the importer opens the stream again between reading the header and the scene.
+	mState = eClosed;
+	mPosition = 0;
+	return true;
+}
+
+
+bool MemoryReadStream::Flush()
+{
+	return true;
+}
+
+
+size_t MemoryReadStream::Write(const void* /*pData*/, FbxUInt64 /*pSize*/)
+{
+	mError = 1;
+	return 0;
+}
+
+
+size_t MemoryReadStream::Read(void* pData, FbxUInt64 pSize) const
+{
+	size_t available = mSize - mPosition;
+	size_t size = (pSize < available) ? static_cast<size_t>(pSize) : available;
+
+	memcpy(pData, mpData + mPosition, size);
+	mPosition += size;
+
+	return size;
+}
+
+
+// Reads a line like fgets, keeping the newline, or a single word.
+char* MemoryReadStream::ReadString(char* pBuffer, int pMaxSize, bool pStopAtFirstWhiteSpace)
+{
+	if ((pMaxSize <= 0) || (mPosition >= mSize))
+		return nullptr;
+
+	int length = 0;
+	while ((length < pMaxSize - 1) && (mPosition < mSize))
+	{
+		char c = mpData [mPosition++];
+
+		if (pStopAtFirstWhiteSpace && ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n')))
+			break;
+
+		pBuffer [length++] = c;
+
+		if (c == '\n')
+			break;
+	}
+
+	pBuffer [length] = '\0';
+	return pBuffer;
+}
+
+
+int MemoryReadStream::GetReaderID() const
+{
+	return mReaderID;
+}
+
+
+int MemoryReadStream::GetWriterID() const
+{
+	return -1;
+}
+
+
+void MemoryReadStream::Seek(const FbxInt64& pOffset, const FbxFile::ESeekPos& pSeekPos)
+{
+	FbxInt64 base = 0;
+	if (pSeekPos == FbxFile::eCurrent)
+		base = static_cast<FbxInt64>(mPosition);
+	else if (pSeekPos == FbxFile::eEnd)
+		base = static_cast<FbxInt64>(mSize);
+
+	SetPosition(static_cast<FbxStreamPosition>(base + pOffset));
+}
+
+
+FbxStreamPosition MemoryReadStream::GetPosition() const
+{
+	return static_cast<FbxStreamPosition>(mPosition);
+}
+
+
+void MemoryReadStream::SetPosition(FbxStreamPosition pPosition)
+{
+	if (pPosition < 0)
+		mPosition = 0;
+	else if (static_cast<FbxUInt64>(pPosition) > mSize)
+		mPosition = mSize;
+	else
+		mPosition = static_cast<size_t>(pPosition);
+}
+
+
+int MemoryReadStream::GetError() const
+{
+	return mError;
+}
+
+
+void MemoryReadStream::ClearError()
+{
+	mError = 0;
+}
+
+
+MemoryWriteStream::MemoryWriteStream(int writerID)
+	: mWriterID(writerID)
+{
+}
+
+
+FbxStream::EState MemoryWriteStream::GetState()
+{
+	return mState;
+}
+
+
+bool MemoryWriteStream::Open(void* /*pStreamData*/)
+{
+	mBuffer.clear();
+	mState = eOpen;
+	mPosition = 0;
+	return true;
+}
+
+
+bool MemoryWriteStream::Close()
+{
+	mState = eClosed;
+	mPosition = 0;
+	return true;
+}
+
+
+bool MemoryWriteStream::Flush()
+{
+	return true;
+}
+
+
+size_t MemoryWriteStream::Write(const void* pData, FbxUInt64 pSize)
+{
+	size_t size = static_cast<size_t>(pSize);
+
+	// Growing through resize keeps the vector's geometric growth, so a large export isn't copied on every write.
+	if (mPosition + size > mBuffer.size())
+		mBuffer.resize(mPosition + size);
+
+	memcpy(mBuffer.data() + mPosition, pData, size);
+	mPosition += size;
+
+	return size;
+}
+
+
+size_t MemoryWriteStream::Read(void* pData, FbxUInt64 pSize) const
+{
+	size_t available = (mPosition < mBuffer.size()) ? mBuffer.size() - mPosition : 0;
+	size_t size = (pSize < available) ? static_cast<size_t>(pSize) : available;
+
+	memcpy(pData, mBuffer.data() + mPosition, size);
+	mPosition += size;
+
+	return size;
+}
+
+
+int MemoryWriteStream::GetReaderID() const
+{
+	return -1;
+}
+
+
+int MemoryWriteStream::GetWriterID() const
+{
+	return mWriterID;
+}
+
+
+void MemoryWriteStream::Seek(const FbxInt64& pOffset, const FbxFile::ESeekPos& pSeekPos)
+{
+	FbxInt64 base = 0;
+	if (pSeekPos == FbxFile::eCurrent)
+		base = static_cast<FbxInt64>(mPosition);
+	else if (pSeekPos == FbxFile::eEnd)
+		base = static_cast<FbxInt64>(mBuffer.size());
+
+	SetPosition(static_cast<FbxStreamPosition>(base + pOffset));
+}
+
+
+FbxStreamPosition MemoryWriteStream::GetPosition() const
+{
+	return static_cast<FbxStreamPosition>(mPosition);
+}
+
+
+// Seeking past the end is allowed, as it is for a file; the gap is filled with zeros by the next write.
+void MemoryWriteStream::SetPosition(FbxStreamPosition pPosition)
+{
+	mPosition = (pPosition < 0) ? 0 : static_cast<size_t>(pPosition);
+}
+
+
+int MemoryWriteStream::GetError() const
+{
+	return mError;
+}
+
+
+void MemoryWriteStream::ClearError()
+{
+	mError = 0;
+}
@@ -0,0 +1,145 @@
+#include "SceneInspection.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+
+typedef rapidjson::Writer<rapidjson::StringBuffer> InspectionWriter;
+
+
+static void WriteApplication(InspectionWriter& writer, const char* pKey, const FbxString& name, const FbxString& vendor,
+	const FbxString& version)
+{
+	writer.Key(pKey);
+	writer.StartObject();
+	writer.Key("name");
+	writer.String(name.Buffer());
+	writer.Key("vendor");
+	writer.String(vendor.Buffer());
+	writer.Key("version");
+	writer.String(version.Buffer());
+	writer.EndObject();
+}
+
+
+static void WriteTimeSpan(InspectionWriter& writer, const char* pKey, const FbxTimeSpan& timeSpan)
+{
+	writer.Key(pKey);
+	writer.StartArray();
+	writer.Double(timeSpan.GetStart().GetSecondDouble());
+	writer.Double(timeSpan.GetStop().GetSecondDouble());
+	writer.EndArray();
+}
+
+
+bool InspectFile(FbxManager* pManager, const char* pFilename, const std::string& name, std::string& line)
+{
+	rapidjson::StringBuffer buffer;
+	InspectionWriter writer(buffer);
+
+	writer.StartObject();
+	writer.Key("file");
+	writer.String(name.c_str());
+
+	FbxImporter* pImporter = FbxImporter::Create(pManager, "");
+	bool isInitialized = pImporter->Initialize(pFilename, -1, pManager->GetIOSettings());
+	if (!isInitialized)
+	{
+		writer.Key("error");
+		writer.String(pImporter->GetStatus().GetErrorString());
+	}
+	else
+	{
+		int major, minor, revision;
+		pImporter->GetFileVersion(major, minor, revision);
+
+		char version [32];
+		snprintf(version, sizeof(version), "%d.%d.%d", major, minor, revision);
+		writer.Key("version");
+		writer.String(version);
+		writer.Key("fbx");
+		writer.Bool(pImporter->IsFBX());
+
+		// Times are in seconds, as the frame rate is only known once the global settings are imported.
+		writer.Key("stacks");
+		writer.StartArray();
+		for (int i = 0; i < pImporter->GetAnimStackCount(); i++)
+		{
+			FbxTakeInfo* pTakeInfo = pImporter->GetTakeInfo(i);
+			if (!pTakeInfo)
+				continue;
+
+			writer.StartObject();
+			writer.Key("name");
+			writer.String(pTakeInfo->mName.Buffer());
+			WriteTimeSpan(writer, "local", pTakeInfo->mLocalTimeSpan);
+			WriteTimeSpan(writer, "reference", pTakeInfo->mReferenceTimeSpan);
+			writer.EndObject();
+		}
+		writer.EndArray();
+
+		if (FbxDocumentInfo* pSceneInfo = pImporter->GetSceneInfo())
+		{
+			WriteApplication(writer, "creator", pSceneInfo->Original_ApplicationName.Get(),
+				pSceneInfo->Original_ApplicationVendor.Get(), pSceneInfo->Original_ApplicationVersion.Get());
+			WriteApplication(writer, "last-saved", pSceneInfo->LastSaved_ApplicationName.Get(),
+				pSceneInfo->LastSaved_ApplicationVendor.Get(), pSceneInfo->LastSaved_ApplicationVersion.Get());
+		}
+	}
+	pImporter->Destroy();
+
+	writer.EndObject();
+
+	line = buffer.GetString();
+	return isInitialized;
+}
+
+
+size_t InspectFiles(BulkFileFeed& feed, int jobCount, const std::wstring& inputRootPath, std::ostream& outputStream)
+{
+	if (jobCount <= 0)
+		jobCount = (std::max)(1u, std::thread::hardware_concurrency());
+
+	std::mutex outputMutex;
+	std::atomic<size_t> failed { 0 };
+
+	// No scene is needed, and InitializeSdkObjects would print its banner into the output.
+	auto worker = [&]()
+	{
+		FbxManager* pManager = FbxManager::Create();
+		pManager->SetIOSettings(FbxIOSettings::Create(pManager, IOSROOT));
+
+		SBulkFile file;
+		while (feed.Pop(file))
+		{
+			char* pFilename = nullptr;
+			FbxWCToUTF8(file.inputPath.c_str(), pFilename);
+			std::string line;
+			if (!InspectFile(pManager, pFilename ? pFilename : "", GetBulkRelativePath(inputRootPath, file.inputPath), line))
+				++failed;
+			delete[] pFilename;
+
+			std::lock_guard<std::mutex> lock(outputMutex);
+			outputStream << line << "\n";
+		}
+
+		pManager->Destroy();
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < jobCount; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& thread : threads)
+		thread.join();
+
+	outputStream.flush();
+	return failed;
+}
@@ -0,0 +1,109 @@
+#include "SceneLifecycle.h"
+
+#include <algorithm>
+#include <chrono>
+#include <windows.h>
+#include <psapi.h>
+
+#include "Common.h"
+
+
+ESceneResetMode gSceneResetMode { eSceneRecycle };
+size_t gMaxResidentBytes { 0 };
+
+// In recycle mode, every Nth reset is a full recreate to measure what recycling saves.
+const size_t recreateSampleInterval = 32;
+
+
+void SSceneLifecycleStats::Merge(const SSceneLifecycleStats& other)
+{
+	recycles += other.recycles;
+	recreates += other.recreates;
+	managerRecreates += other.managerRecreates;
+	recycleSeconds += other.recycleSeconds;
+	recreateSeconds += other.recreateSeconds;
+	recycleResidentBytes += other.recycleResidentBytes;
+	recreateResidentBytes += other.recreateResidentBytes;
+	peakResidentBytes = (std::max)(peakResidentBytes, other.peakResidentBytes);
+}
+
+
+size_t GetResidentBytes()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.WorkingSetSize;
+}
+
+
+void ResetScene(FbxManager*& pManager, FbxScene*& pScene, SSceneLifecycleStats& stats)
+{
+	typedef std::chrono::steady_clock ResetClock;
+
+	size_t resets = stats.recycles + stats.recreates;
+	bool recreate = (gSceneResetMode == eSceneRecreate) || ((resets + 1) % recreateSampleInterval == 0);
+
+	ResetClock::time_point resetStart = ResetClock::now();
+
+	if (recreate)
+	{
+		FbxString sceneName = pScene->GetName();
+		pScene->Destroy(true);
+		pScene = FbxScene::Create(pManager, sceneName.Buffer());
+	}
+	else
+	{
+		pScene->Clear();
+	}
+
+	double seconds = std::chrono::duration<double>(ResetClock::now() - resetStart).count();
+	size_t residentBytes = GetResidentBytes();
+
+	if (recreate)
+	{
+		stats.recreates++;
+		stats.recreateSeconds += seconds;
+		stats.recreateResidentBytes += residentBytes;
+	}
+	else
+	{
+		stats.recycles++;
+		stats.recycleSeconds += seconds;
+		stats.recycleResidentBytes += residentBytes;
+	}
+
+	stats.peakResidentBytes = (std::max)(stats.peakResidentBytes, residentBytes);
+
+	// Memory the SDK has pooled inside the manager only goes back when the manager does.
+	if ((gMaxResidentBytes > 0) && (residentBytes > gMaxResidentBytes))
+	{
+		FBXSDK_printf("Resident memory %zu MB is over the cap, rebuilding the FBX manager.\n", residentBytes >> 20);
+
+		DestroySdkObjects(pManager, false);
+		InitializeSdkObjects(pManager, pScene);
+		stats.managerRecreates++;
+	}
+}
+
+
+void DisplaySceneLifecycleStats(const SSceneLifecycleStats& stats)
+{
+	FBXSDK_printf("    Scene resets: %zu recycled, %zu recreated, %zu manager rebuilds\n", stats.recycles, stats.recreates,
+		stats.managerRecreates);
+	FBXSDK_printf("    Peak resident memory: %zu MB\n", stats.peakResidentBytes >> 20);
+
+	if ((stats.recycles == 0) || (stats.recreates == 0))
+		return;
+
+	double recycleAverage = stats.recycleSeconds / stats.recycles;
+	double recreateAverage = stats.recreateSeconds / stats.recreates;
+	double recycleResident = stats.recycleResidentBytes / stats.recycles;
+	double recreateResident = stats.recreateResidentBytes / stats.recreates;
+
+	FBXSDK_printf("    Recycle: %.3f ms per file, %.0f MB resident after reset\n", recycleAverage * 1000.0, recycleResident / (1 << 20));
+	FBXSDK_printf("    Recreate: %.3f ms per file, %.0f MB resident after reset\n", recreateAverage * 1000.0, recreateResident / (1 << 20));
+	FBXSDK_printf("    Saved by recycling: %.2f s, %.0f MB resident\n", (recreateAverage - recycleAverage) * stats.recycles,
+		(recreateResident - recycleResident) / (1 << 20));
+}
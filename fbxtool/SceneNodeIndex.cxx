@@ -0,0 +1,150 @@
+#include "SceneNodeIndex.h"
+
+#include <algorithm>
+
+
+void SceneNodeIndex::Build(FbxScene* pFbxScene)
+{
+	Clear();
+
+	for (int i = 0; i < pFbxScene->GetNodeCount(); i++)
+		Add(pFbxScene->GetNode(i));
+}
+
+
+void SceneNodeIndex::Clear()
+{
+	mOrders.clear();
+	mNodes.clear();
+	mNextOrder = 0;
+}
+
+
+FbxNode* SceneNodeIndex::Find(const char* pName) const
+{
+	auto nodes = mNodes.find(pName);
+	return (nodes != mNodes.end()) ? nodes->second.begin()->second : nullptr;
+}
+
+
+// The child indices leading from pRoot down to the node, or false if the node isn't below pRoot.
+static bool GetPathBelow(FbxNode* pRoot, FbxNode* pNode, std::vector<int>& path)
+{
+	path.clear();
+
+	for (FbxNode* pCurrent = pNode; pCurrent != pRoot; pCurrent = pCurrent->GetParent())
+	{
+		FbxNode* pParent = pCurrent->GetParent();
+		if (!pParent)
+			return false;
+
+		int index = 0;
+		while ((index < pParent->GetChildCount()) && (pParent->GetChild(index) != pCurrent))
+			index++;
+		path.push_back(index);
+	}
+
+	std::reverse(path.begin(), path.end());
+	return !path.empty();
+}
+
+
+// Whether FindChild reaches the node at path a before the one at path b. Where the paths part, a node that is a child
+// there is checked before anything below the other children, and otherwise the earlier child is searched first.
+static bool IsFoundBefore(const std::vector<int>& a, const std::vector<int>& b)
+{
+	for (size_t level = 0; ; level++)
+	{
+		bool isAChild = (level + 1 == a.size());
+		bool isBChild = (level + 1 == b.size());
+
+		if (isAChild && isBChild)
+			return a [level] < b [level];
+		if (isAChild || isBChild)
+			return isAChild;
+		if (a [level] != b [level])
+			return a [level] < b [level];
+	}
+}
+
+
+FbxNode* SceneNodeIndex::FindBelow(FbxNode* pRoot, const char* pName) const
+{
+	auto nodes = mNodes.find(pName);
+	if (nodes == mNodes.end())
+		return nullptr;
+
+	FbxNode* pFound = nullptr;
+	std::vector<int> foundPath, path;
+
+	for (const auto& node : nodes->second)
+	{
+		if (GetPathBelow(pRoot, node.second, path) && (!pFound || IsFoundBefore(path, foundPath)))
+		{
+			pFound = node.second;
+			foundPath.swap(path);
+		}
+	}
+
+	return pFound;
+}
+
+
+void SceneNodeIndex::Add(FbxNode* pNode)
+{
+	if (!pNode || !mOrders.emplace(pNode, mNextOrder).second)
+		return;
+
+	mNodes [pNode->GetName()].emplace(mNextOrder, pNode);
+	mNextOrder++;
+}
+
+
+void SceneNodeIndex::Remove(FbxNode* pNode)
+{
+	auto order = mOrders.find(pNode);
+	if (order == mOrders.end())
+		return;
+
+	auto nodes = mNodes.find(pNode->GetName());
+	if (nodes != mNodes.end())
+	{
+		nodes->second.erase(order->second);
+		if (nodes->second.empty())
+			mNodes.erase(nodes);
+	}
+
+	mOrders.erase(order);
+}
+
+
+void SceneNodeIndex::Rename(FbxNode* pNode, const char* pNewName)
+{
+	auto order = mOrders.find(pNode);
+	if (order == mOrders.end())
+	{
+		pNode->SetName(pNewName);
+		return;
+	}
+
+	uint64_t position = order->second;
+	Remove(pNode);
+	pNode->SetName(pNewName);
+
+	mOrders.emplace(pNode, position);
+	mNodes [pNode->GetName()].emplace(position, pNode);
+}
+
+
+std::vector<std::pair<std::string, size_t>> SceneNodeIndex::GetDuplicateNames() const
+{
+	std::vector<std::pair<std::string, size_t>> duplicates;
+	for (const auto& nodes : mNodes)
+	{
+		if (nodes.second.size() > 1)
+			duplicates.emplace_back(nodes.first, nodes.second.size());
+	}
+
+	std::sort(duplicates.begin(), duplicates.end());
+	return duplicates;
+}
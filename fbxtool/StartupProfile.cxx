@@ -0,0 +1,72 @@
+#include "StartupProfile.h"
+
+#include <fbxsdk.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include <windows.h>
+
+
+bool gIsProfilingStartup { false };
+
+static std::atomic<bool> gIsStartupOver { false };
+static std::chrono::steady_clock::time_point gPhaseStart;
+static std::vector<std::pair<std::string, double>> gStartupPhases;
+
+
+// Time since the OS created the process, in seconds.
+static double GetProcessAge()
+{
+	FILETIME creationTime, exitTime, kernelTime, userTime, now;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+		return 0.0;
+
+	GetSystemTimePreciseAsFileTime(&now);
+
+	// FILETIME counts in 100 nanosecond ticks.
+	auto ticks = [](const FILETIME& time) { return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+	unsigned long long creationTicks = ticks(creationTime);
+	unsigned long long nowTicks = ticks(now);
+
+	return (nowTicks > creationTicks) ? (nowTicks - creationTicks) / 1.0e7 : 0.0;
+}
+
+
+void BeginStartupProfile()
+{
+	gStartupPhases.clear();
+	gStartupPhases.emplace_back("Process launch", GetProcessAge());
+	gPhaseStart = std::chrono::steady_clock::now();
+}
+
+
+void MarkStartupPhase(const char* pPhaseName)
+{
+	if (gIsStartupOver)
+		return;
+
+	auto now = std::chrono::steady_clock::now();
+	gStartupPhases.emplace_back(pPhaseName, std::chrono::duration<double>(now - gPhaseStart).count());
+	gPhaseStart = now;
+}
+
+
+void EndStartupProfile()
+{
+	if (gIsStartupOver.exchange(true) || !gIsProfilingStartup)
+		return;
+
+	double totalSeconds = 0.0;
+	for (const auto& phase : gStartupPhases)
+		totalSeconds += phase.second;
+
+	FBXSDK_printf("\nStart-up profile:\n");
+	for (const auto& phase : gStartupPhases)
+	{
+		double percent = (totalSeconds > 0.0) ? (100.0 * phase.second / totalSeconds) : 0.0;
+		FBXSDK_printf("    %-24s %8.1f ms  %5.1f%%\n", phase.first.c_str(), phase.second * 1000.0, percent);
+	}
+	FBXSDK_printf("    %-24s %8.1f ms\n\n", "Total", totalSeconds * 1000.0);
+}
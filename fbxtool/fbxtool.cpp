@@ -1,22 +1,46 @@
 #include "stdafx.h"
 
 #include "fbxtool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <stdlib.h>
 #include <fbxsdk.h>
 #include <map>
+#include <memory>
 #include <list>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <filesystem>
-
-#include "rapidjson/document.h"
-#include "rapidjson/prettywriter.h"
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <windows.h>
+
+#include "BinaryFbxArrays.h"
+#include "BinaryFbxDisplay.h"
+#include "BinaryFbxPatch.h"
+#include "BulkEnumeration.h"
+#include "BulkJournal.h"
+#include "BulkManifest.h"
+#include "BulkProcessing.h"
+#include "ContentHash.h"
 #include "Common.h"
 #include "DisplayCommon.h"
 #include "GeometryUtility.h"
+#include "JobServer.h"
+#include "JointChain.h"
+#include "JointFile.h"
+#include "JointPatterns.h"
+#include "JointRenameTable.h"
+#include "MediaStore.h"
+#include "MemoryStream.h"
+#include "SceneInspection.h"
+#include "SceneNodeIndex.h"
+#include "StartupProfile.h"
 #include "clara.hpp"
-#include "tinydir.h"
 
 using namespace clara;
 
@@ -36,6 +60,19 @@ struct SJointEnhancement
 
 
 std::map<std::string, SJointEnhancement> jointMap;
+
+// The joint map compiled for lookups while traversing the scene. Rebuilt whenever jointMap changes.
+JointRenameTable gJointRenames;
+
+// Prefix, suffix and glob rules, tried in file order for names with no exact entry in the joint map.
+std::vector<SJointPattern> jointPatterns;
+JointPatternSet gJointPatterns;
+
+// When -j is a chain of joint files, the renames of every file after the first, for the names the patterns give.
+JointRenameTable gJointChainTail;
+
+// Where JSON joint files are cached once validated, so later runs needn't parse them. Empty not to cache.
+std::filesystem::path gJointCachePath;
 bool isVerbose { false };
 bool applyMixamoFixes { false };
 bool addIK { false };
@@ -47,6 +84,26 @@ std::string gRemoveLeafName{ "" };
 std::string gAxis{ "" };
 double gScale = 1.0;
 
+// Only import the scene elements the requested operations need, plus any asked to be kept.
+bool gIsImportSelective { false };
+bool gIsComparingImport { false };
+SSceneElements gKeptSceneElements { false, false, false, false, false, false, false };
+
+// Patch the animation and joint renames straight into binary FBX files when nothing else needs doing to them.
+bool gIsPatchingBinary { true };
+bool gIsComparingPatch { false };
+
+// Set when the command line asks for particular array compression, which a patched file, keeping its own, can't give.
+bool gIsCompressionGiven { false };
+
+// Where embedded media is extracted to, shared by every file in the run, if anywhere.
+std::unique_ptr<MediaStore> gMediaStore;
+
+// The nodes of the scene being transformed, by name. One per thread, bulk workers transform their own scenes
+// concurrently.
+thread_local SceneNodeIndex gSceneNodes;
+bool gIsReportingDuplicateNames { false };
+
 
 
 // Multiply a quaternion by a vector.
@@ -84,6 +141,7 @@ FbxNode* AddNewParent(FbxScene* pFbxScene, FbxNode* pChildNode, const char* pare
 
     FbxNode* newParentNode = FbxNode::Create(pFbxScene, parentName);
     newParentNode->SetNodeAttribute(skeletonRootAttribute);
+    gSceneNodes.Add(newParentNode);
 
 	// insert the node as pChildNode and siblings 's new parent
     if (pCurrentParent) {
@@ -129,6 +187,7 @@ bool RemoveNode(FbxScene* pFbxScene, FbxNode* pNode)
 		pCurrentParent->AddChild(child);
 	}
 
+	gSceneNodes.Remove(pNode);
 	return pFbxScene->RemoveNode(pNode);
 }
 
@@ -138,7 +197,7 @@ void ResetBoneTransform(FbxNode* node)
 
 	if (bone) {
 		std::cout << "Bone: " << node->GetName();
-		node->SetName("root");
+		gSceneNodes.Rename(node, "root");
 		std::cout << " renamed to: " << node->GetName() << std::endl;		
 	}
 
@@ -218,18 +277,18 @@ void ApplyWeaponFix(FbxScene* pFbxScene)
 	sceneRoot->ConvertPivotAnimationRecursive(pFbxScene->GetCurrentAnimationStack(), FbxNode::eDestinationPivot, 30.0);
 }
 
-void RenameSkeleton(FbxScene* pFbxScene, FbxNode* pFbxNode, std::string indexName, std::map<std::string, SJointEnhancement> jointMap)
+void RenameSkeleton(FbxScene* pFbxScene, FbxNode* pFbxNode, const char* pNewName)
 {
 	FbxSkeleton* lSkeleton = (FbxSkeleton*)pFbxNode->GetNodeAttribute();
 
 	// See if we have a new name for the joint.
-	if (jointMap.find(indexName) != jointMap.end())
+	if (pNewName)
 	{
-		FbxString stringName = jointMap [indexName].newName.c_str();
+		FbxString stringName = pNewName;
 
 		if (isVerbose)
 			DisplayString("NEW NAME: " + stringName);
-		pFbxNode->SetName(stringName);
+		gSceneNodes.Rename(pFbxNode, stringName);
 	}
 	else
 	{
@@ -274,14 +333,14 @@ void RenameSkeleton(FbxScene* pFbxScene, FbxNode* pFbxNode, std::string indexNam
 }
 
 
-void EnhanceSkeleton(FbxScene* pFbxScene, FbxNode* pFbxNode, std::string indexName, std::map<std::string, SJointEnhancement> jointMap)
+void EnhanceSkeleton(FbxScene* pFbxScene, FbxNode* pFbxNode, uint32_t jointIndex)
 {
 	FbxSkeleton* pFBXSkeleton = (FbxSkeleton*)pFbxNode->GetNodeAttribute();
 
 	// Check to see if there is any enhancement data in the JSON file for this joint.
-	if (jointMap.find(indexName) != jointMap.end())
+	if (jointIndex != JointRenameTable::notFound)
 	{
-		//SJointEnhancement joint = jointMap [indexName];
+		//const SJointEnhancement& joint = jointMap.at(gJointRenames.GetOldName(jointIndex));
 
 		//// Physics, yo!
 		//if (!joint.physicsProxy.empty())
@@ -335,17 +394,40 @@ void EnhanceSkeleton(FbxScene* pFbxScene, FbxNode* pFbxNode, std::string indexNa
 }
 
 
-void DoSkeletonStuff(FbxScene* pFbxScene, FbxNode* pFbxNode, std::map<std::string, SJointEnhancement> jointMap)
+// The name the pattern rules, and the rest of a chain of joint files after them, give a joint with no exact entry.
+bool RenameByPattern(const char* pName, std::string& newName)
 {
-	if (jointMap.find(std::string(pFbxNode->GetName())) != jointMap.end())
-	{
-		// We're renaming the skeleton on the fly, so it's important to remember what the node 'was' called and use that for all lookups in the map.
-		auto indexName = jointMap [std::string(pFbxNode->GetName())].oldName;
+	uint32_t rule = gJointPatterns.Match(pName);
+	if (rule == JointPatternSet::notFound)
+		return false;
+
+	newName = gJointPatterns.Rename(rule, pName);
+
+	uint32_t tailIndex = gJointChainTail.Find(newName.c_str());
+	if (tailIndex != JointRenameTable::notFound)
+		newName = gJointChainTail.GetNewName(tailIndex);
+
+	return true;
+}
 
+
+void DoSkeletonStuff(FbxScene* pFbxScene, FbxNode* pFbxNode)
+{
+	// We're renaming the skeleton on the fly, so it's important to remember what the node 'was' called and use that
+	// for all lookups. The joint's index stays the same whatever the node is called.
+	uint32_t jointIndex = gJointRenames.Find(pFbxNode->GetName());
+	if (jointIndex != JointRenameTable::notFound)
+	{
 		// Rename to new skeleton standard.
-		RenameSkeleton(pFbxScene, pFbxNode, indexName, jointMap);
-		EnhanceSkeleton(pFbxScene, pFbxNode, indexName, jointMap);
+		RenameSkeleton(pFbxScene, pFbxNode, gJointRenames.GetNewName(jointIndex));
+		EnhanceSkeleton(pFbxScene, pFbxNode, jointIndex);
+		return;
 	}
+
+	// Exact names win; the patterns only rename, as they carry no enhancements.
+	std::string newName;
+	if (RenameByPattern(pFbxNode->GetName(), newName))
+		RenameSkeleton(pFbxScene, pFbxNode, newName.c_str());
 }
 
 
@@ -364,7 +446,7 @@ void InterateContent(FbxScene* pFbxScene, FbxNode* pFbxNode)
 		switch (attributeType)
 		{
 			case FbxNodeAttribute::eSkeleton:
-				DoSkeletonStuff(pFbxScene, pFbxNode, jointMap);
+				DoSkeletonStuff(pFbxScene, pFbxNode);
 				break;
 
 			default:
@@ -397,7 +479,9 @@ void RemoveLeafBones(FbxScene* pFbxScene, FbxNode* pFbxNode)
 }
 
 typedef std::map<std::string, FbxAMatrix> BoneGlobalTransform;
-BoneGlobalTransform _gBoneGlobalTransforms;
+
+// One per thread, bulk workers scale their own scenes concurrently.
+thread_local BoneGlobalTransform _gBoneGlobalTransforms;
 
 // scale bone's local translate
 void ScaleNodeRecursive(FbxScene* pFbxScene, FbxNode* pNode)
@@ -491,7 +575,7 @@ void InterateContent(FbxScene* pFbxScene)
 
 	if (gAddRoot) {
         // apply bone hierarchy fix (add a new root node)
-        FbxNode* sklRoot = sceneRootNode->FindChild(gAddRootChildName.c_str(), true, false);
+        FbxNode* sklRoot = gSceneNodes.FindBelow(sceneRootNode, gAddRootChildName.c_str());
         if (sklRoot) {
             FbxNode* newRoot = AddNewParent(pFbxScene, sklRoot, gAddRootRootName.c_str());
         }
@@ -594,34 +678,36 @@ void ApplyMixamoFixes(FbxManager* pFbxManager, FbxScene* pFbxScene)
 	FbxNode* sceneRootNode = pFbxScene->GetRootNode();
 
 	// Fix stupid names.
-	if (auto pFbxNode = pFbxScene->FindNodeByName("default"))
-		pFbxNode->SetName("Eyes");
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Tops"))
-		pFbxNode->SetName("Top");
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Bottoms"))
-		pFbxNode->SetName("Bottom");
+	if (auto pFbxNode = gSceneNodes.Find("default"))
+		gSceneNodes.Rename(pFbxNode, "Eyes");
+	if (auto pFbxNode = gSceneNodes.Find("Tops"))
+		gSceneNodes.Rename(pFbxNode, "Top");
+	if (auto pFbxNode = gSceneNodes.Find("Bottoms"))
+		gSceneNodes.Rename(pFbxNode, "Bottom");
 
 	// Add a new node and move the meshes onto it.
 	FbxNode* meshNode = FbxNode::Create(pFbxScene, "Meshes");
+	gSceneNodes.Add(meshNode);
 	sceneRootNode->AddChild(meshNode);
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Body"))
+	if (auto pFbxNode = gSceneNodes.Find("Body"))
 		meshNode->AddChild(pFbxNode);
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Bottom"))
+	if (auto pFbxNode = gSceneNodes.Find("Bottom"))
 		meshNode->AddChild(pFbxNode);
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Eyes"))
+	if (auto pFbxNode = gSceneNodes.Find("Eyes"))
 		meshNode->AddChild(pFbxNode);
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Eyelashes"))
+	if (auto pFbxNode = gSceneNodes.Find("Eyelashes"))
 		meshNode->AddChild(pFbxNode);
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Hair"))
+	if (auto pFbxNode = gSceneNodes.Find("Hair"))
 		meshNode->AddChild(pFbxNode);
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Top"))
+	if (auto pFbxNode = gSceneNodes.Find("Top"))
 		meshNode->AddChild(pFbxNode);
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Shoes"))
+	if (auto pFbxNode = gSceneNodes.Find("Shoes"))
 		meshNode->AddChild(pFbxNode);
 
 	// We also need a 'RootProxy' for scaling at some point.
 	FbxString rootProxyName("RootProxy");
 	FbxNode* skeletonRootProxyNode = FbxNode::Create(pFbxScene, rootProxyName.Buffer());
+	gSceneNodes.Add(skeletonRootProxyNode);
 	sceneRootNode->AddChild(skeletonRootProxyNode);
 
 	// Add a new node called 'Root' to parent the existing skeleton onto.
@@ -630,10 +716,11 @@ void ApplyMixamoFixes(FbxManager* pFbxManager, FbxScene* pFbxScene)
 	skeletonRootAttribute->SetSkeletonType(FbxSkeleton::eRoot);
 	FbxNode* skeletonRootNode = FbxNode::Create(pFbxScene, rootName.Buffer());
 	skeletonRootNode->SetNodeAttribute(skeletonRootAttribute);
+	gSceneNodes.Add(skeletonRootNode);
 	skeletonRootProxyNode->AddChild(skeletonRootNode);
 
 	// Reparent the hips.
-	if (auto pFbxNode = pFbxScene->FindNodeByName("Hips"))
+	if (auto pFbxNode = gSceneNodes.Find("Hips"))
 	{
 		skeletonRootNode->AddChild(pFbxNode);
 	}
@@ -655,12 +742,13 @@ void AddNewJoint(FbxManager* pFbxManager, FbxScene* pFbxScene, const char* nodeN
 
 	FbxNode* skeletonNode = FbxNode::Create(pFbxScene, newNodeName.Buffer());
 	skeletonNode->SetNodeAttribute(skeletonRootAttribute);
+	gSceneNodes.Add(skeletonNode);
 
 	// The default offset is fine in most cases.
 	skeletonNode->LclTranslation.Set(offset);
 
 	// Parent the node.
-	if (auto pParentNode = pFbxScene->FindNodeByName(parentNodeName))
+	if (auto pParentNode = gSceneNodes.Find(parentNodeName))
 	{
 		// Foot plane weights.
 		if (offsetType == 1)
@@ -715,317 +803,2018 @@ void AddIkJoints(FbxManager* pFbxManager, FbxScene* pFbxScene)
 }
 
 
-bool ProcessFile(FbxManager* pFbxManager, FbxScene* pFbxScene, FbxString fbxInFilePath, FbxString fbxOutFilePath)
+// The scene elements each operation reads or edits. Nodes and geometry are always imported; renaming, re-parenting
+// and adding joints need nothing more. Animation is always needed, as the first take is renamed after the file.
+// Adding a root, removing leaf bones and the Mixamo fixes only move, add or remove nodes, with new parents at the
+// origin, so no binding changes; removing a bone that is still bound leaves its clusters unlinked either way.
+SSceneElements GetRequiredSceneElements()
 {
-	bool result = false;
+	SSceneElements elements { false, false, false, false, false, true, true };
 
-	// Load the scene if there is one.
-	if (!fbxInFilePath.IsEmpty())
-	{
-		FBXSDK_printf("\n\nFile: %s\n\n", fbxInFilePath.Buffer());
+	// Scaling and the weapon fix rewrite the cluster link matrices, and axis conversion carries the skin bindings along
+	// with the nodes.
+	if ((abs(gScale - 1.0) > DBL_EPSILON) || !gAxis.empty() || gApplyWeaponFix)
+		elements.links = true;
 
-		if (LoadScene(pFbxManager, pFbxScene, fbxInFilePath))
-		{
-			// switch Axis
-			if (!gAxis.empty()) {
-                FbxAxisSystem axis;
-                FbxAxisSystem::ParseAxisSystem(gAxis.c_str(), axis);
-                axis.DeepConvertScene(pFbxScene);
-			}
+	return elements;
+}
 
-			// Display the scene.
-			DisplayMetaData(pFbxScene);
-			InterateContent(pFbxScene);
+// Narrow the elements LoadScene and SaveScene handle to what the current settings need. Called whenever they change.
+void ApplyImportProfile()
+{
+	if (!gIsImportSelective)
+	{
+		gSceneElements = SSceneElements();
+		return;
+	}
 
-			if (applyMixamoFixes)
-				ApplyMixamoFixes(pFbxManager, pFbxScene);
+	SSceneElements required = GetRequiredSceneElements();
+	gSceneElements.materials = required.materials || gKeptSceneElements.materials;
+	gSceneElements.textures = required.textures || gKeptSceneElements.textures;
+	gSceneElements.links = required.links || gKeptSceneElements.links;
+	gSceneElements.shapes = required.shapes || gKeptSceneElements.shapes;
+	gSceneElements.gobos = required.gobos || gKeptSceneElements.gobos;
+	gSceneElements.animation = required.animation || gKeptSceneElements.animation;
+	gSceneElements.globalSettings = required.globalSettings || gKeptSceneElements.globalSettings;
+}
 
-			// Add a set of joints for IK management.
-			if (addIK)
-				AddIkJoints(pFbxManager, pFbxScene);
+// Element names as used by --import-keep.
+std::string DescribeSceneElements(const SSceneElements& elements, bool isIncluded)
+{
+	const std::pair<const char*, bool> names [] =
+	{
+		{ "materials", elements.materials }, { "textures", elements.textures }, { "links", elements.links },
+		{ "shapes", elements.shapes }, { "gobos", elements.gobos }, { "animation", elements.animation },
+		{ "global-settings", elements.globalSettings },
+	};
 
-			// We really only want the base part of the filename. This code is windows specific and MS compiler specific.
-			char fname [255];
-			char ext [20];
-			_splitpath_s(fbxInFilePath, nullptr, 0, nullptr, 0, fname, sizeof(fname), ext, sizeof(ext));
+	std::string description;
+	for (const auto& name : names)
+	{
+		if (name.second == isIncluded)
+			description += (description.empty() ? "" : ", ") + std::string(name.first);
+	}
 
-			// Optionally, rename the animation to the filename.
-			RenameFirstAnimation(pFbxScene, fname);
+	return description.empty() ? "none" : description;
+}
 
-			// Save a copy of the scene to a new file.
-			result = SaveScene(pFbxManager, pFbxScene, fbxOutFilePath);
+bool ParseSceneElements(const std::string& text, SSceneElements& elements)
+{
+	std::stringstream textStream(text);
+	std::string item;
 
-			if (result == false)
-				FBXSDK_printf("\n\nAn error occurred while saving the scene...\n");
-		}
+	while (std::getline(textStream, item, ','))
+	{
+		if (item == "materials")
+			elements.materials = true;
+		else if (item == "textures")
+			elements.textures = true;
+		else if (item == "links")
+			elements.links = true;
+		else if (item == "shapes")
+			elements.shapes = true;
+		else if (item == "gobos")
+			elements.gobos = true;
+		else if (item == "animation")
+			elements.animation = true;
+		else if (item == "global-settings")
+			elements.globalSettings = true;
 		else
+			return false;
+	}
+
+	return true;
+}
+
+// Memory is measured as growth of the whole process, so it is only meaningful when one file is loaded at a time.
+void ReportImportProfile(FbxManager* pFbxManager, FbxString fbxInFilePath, double loadSeconds, size_t loadBytes)
+{
+	FBXSDK_printf("Selective import skipped %s: %.3f s, %.1f MB\n", DescribeSceneElements(gSceneElements, false).c_str(),
+		loadSeconds, loadBytes / (1024.0 * 1024.0));
+
+	if (!gIsComparingImport)
+		return;
+
+	// Load the whole file again alongside, to see what the skipped elements would have cost.
+	FbxScene* pFullScene = FbxScene::Create(pFbxManager, "Full Import");
+	size_t residentBefore = GetResidentBytes();
+	auto loadStart = std::chrono::steady_clock::now();
+
+	if (LoadScene(pFbxManager, pFullScene, fbxInFilePath, SSceneElements()))
+	{
+		double fullSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+		size_t residentAfter = GetResidentBytes();
+		size_t fullBytes = (residentAfter > residentBefore) ? residentAfter - residentBefore : 0;
+
+		FBXSDK_printf("Full import: %.3f s, %.1f MB; saved %.3f s and %.1f MB\n", fullSeconds, fullBytes / (1024.0 * 1024.0),
+			fullSeconds - loadSeconds, (static_cast<double>(fullBytes) - static_cast<double>(loadBytes)) / (1024.0 * 1024.0));
+	}
+
+	pFullScene->Destroy(true);
+}
+
+// Point the scene's textures and videos at the copies of their embedded media in the store. The exporter works out
+// the relative names from these.
+int RelinkEmbeddedMedia(FbxScene* pFbxScene, const std::map<std::string, std::wstring>& extractedMedia)
+{
+	int relinkedCount = 0;
+
+	auto relink = [&](const char* pFileName, const char* pRelativeFileName, const std::function<void(const char*)>& setFileName)
+	{
+		auto media = extractedMedia.find(pFileName);
+		if (media == extractedMedia.end())
+			media = extractedMedia.find(pRelativeFileName);
+		if (media == extractedMedia.end())
+			return;
+
+		char* pBlobPath = nullptr;
+		FbxWCToUTF8(media->second.c_str(), pBlobPath);
+		if (pBlobPath)
 		{
-			FBXSDK_printf("\n\nAn error occurred while loading the scene...");
+			setFileName(pBlobPath);
+			relinkedCount++;
 		}
+		delete[] pBlobPath;
+	};
+
+	for (int i = 0; i < pFbxScene->GetSrcObjectCount<FbxFileTexture>(); i++)
+	{
+		FbxFileTexture* pTexture = pFbxScene->GetSrcObject<FbxFileTexture>(i);
+		relink(pTexture->GetFileName(), pTexture->GetRelativeFileName(), [pTexture](const char* pPath)
+		{
+			pTexture->SetFileName(pPath);
+			pTexture->SetRelativeFileName("");
+		});
 	}
-	else
+
+	for (int i = 0; i < pFbxScene->GetSrcObjectCount<FbxVideo>(); i++)
 	{
-		FBXSDK_printf("\n\nUsage: ImportScene <FBX file name>\n\n");
+		FbxVideo* pVideo = pFbxScene->GetSrcObject<FbxVideo>(i);
+		relink(pVideo->GetFileName().Buffer(), pVideo->GetRelativeFileName().Buffer(), [pVideo](const char* pPath)
+		{
+			pVideo->SetFileName(pPath);
+			pVideo->SetRelativeFileName("");
+		});
 	}
 
-	return result;
+	return relinkedCount;
 }
 
-FbxString StdStr2FbxStr(std::string str)
+// Extract the file's embedded media into the store, rather than a .fbm folder of its own. ASCII files aren't read by
+// the store, so their media is left where it is.
+bool StoreEmbeddedMedia(FbxString fbxInFilePath, std::map<std::string, std::wstring>& extractedMedia)
 {
-    FbxString retStr = "";
+	wchar_t* pInputPath = nullptr;
+	FbxUTF8ToWC(fbxInFilePath.Buffer(), pInputPath);
+	std::wstring inputPath = pInputPath ? pInputPath : L"";
+	delete[] pInputPath;
 
-    char* newStr = NULL;
-    FbxAnsiToUTF8(str.c_str(), newStr);//Character encoding conversion API provided by Fbx Sdk
-    if (NULL != newStr)
-    {
-        retStr = newStr;
-        delete[] newStr;//remember to release
-    }
+	std::string error;
+	switch (gMediaStore->ExtractEmbeddedMedia(inputPath, extractedMedia, error))
+	{
+		case eMediaExtracted:
+			return true;
 
-    return retStr;
+		case eMediaUnsupported:
+			if (isVerbose)
+				FBXSDK_printf("Not storing the media embedded in %s: %s.\n", fbxInFilePath.Buffer(), error.c_str());
+			return true;
+
+		case eMediaFailed:
+			break;
+	}
+
+	FBXSDK_printf("\n\nUnable to store the media embedded in %s: %s.\n", fbxInFilePath.Buffer(), error.c_str());
+	return false;
 }
 
-FbxString WStr2FbxStr(std::wstring str)
+void ReportMediaStore()
 {
-    FbxString retStr = "";
+	SMediaStoreStats stats = gMediaStore->GetStats();
+	FBXSDK_printf("Media store: %zu embedded file(s), %.1f MB; wrote %zu new (%.1f MB), reused %zu (%.1f MB saved)\n",
+		stats.mediaCount, stats.mediaBytes / (1024.0 * 1024.0), stats.writtenCount, stats.writtenBytes / (1024.0 * 1024.0),
+		stats.reusedCount, stats.reusedBytes / (1024.0 * 1024.0));
+}
 
-    char* newStr = NULL;
-    FbxWCToUTF8(str.c_str(), newStr);//Character encoding conversion API provided by Fbx Sdk
-    if (NULL != newStr)
-    {
-        retStr = newStr;
-        delete[] newStr;//remember to release
-    }
+// Load a file to be converted. If pContentHash is given, an FBX file is imported from a mapped view and hashed from
+// it, so recording the hash costs no second read of the file. pIsHashed says whether that happened; it doesn't for
+// other formats or if the file can't be mapped.
+bool LoadInputScene(FbxManager* pFbxManager, FbxScene* pFbxScene, FbxString fbxInFilePath, uint64_t* pContentHash = nullptr,
+	bool* pIsHashed = nullptr)
+{
+	FBXSDK_printf("\n\nFile: %s\n\n", fbxInFilePath.Buffer());
 
-    return retStr;
+	std::map<std::string, std::wstring> extractedMedia;
+	if (gMediaStore && !StoreEmbeddedMedia(fbxInFilePath, extractedMedia))
+		return false;
+
+	size_t residentBefore = GetResidentBytes();
+	auto loadStart = std::chrono::steady_clock::now();
+
+	MemoryReadStream mappedInput(pFbxManager);
+	const char* pExtension = strrchr(fbxInFilePath.Buffer(), '.');
+	if (pContentHash && pExtension && (FBXSDK_stricmp(pExtension, ".fbx") == 0))
+	{
+		wchar_t* pInputPath = nullptr;
+		FbxUTF8ToWC(fbxInFilePath.Buffer(), pInputPath);
+		std::wstring inputPath = pInputPath ? pInputPath : L"";
+		delete[] pInputPath;
+
+		if (mappedInput.MapFile(inputPath))
+		{
+			ContentHash inputHash;
+			inputHash.Update(mappedInput.GetData(), mappedInput.GetSize());
+			*pContentHash = inputHash.Finish();
+			if (pIsHashed)
+				*pIsHashed = true;
+		}
+	}
+
+	bool isLoaded = mappedInput.GetData()
+		? LoadScene(pFbxManager, pFbxScene, mappedInput.GetData(), mappedInput.GetSize(), fbxInFilePath.Buffer())
+		: LoadScene(pFbxManager, pFbxScene, fbxInFilePath);
+
+	if (!isLoaded)
+	{
+		FBXSDK_printf("\n\nAn error occurred while loading the scene...");
+		return false;
+	}
+
+	if (!extractedMedia.empty())
+		FBXSDK_printf("Linked %d texture(s) and video(s) to the media store\n", RelinkEmbeddedMedia(pFbxScene, extractedMedia));
+
+	if (gIsImportSelective)
+	{
+		double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+		size_t residentAfter = GetResidentBytes();
+		ReportImportProfile(pFbxManager, fbxInFilePath, loadSeconds, (residentAfter > residentBefore) ? residentAfter - residentBefore : 0);
+	}
+
+	return true;
+}
+
+
+// Ask the OS to drop its cached copy of a file. An unbuffered open makes the file system flush and purge the file's
+// cached pages, as long as nothing else has it open or mapped, so the next read has to go to the disk.
+bool EvictFromFileCache(const std::wstring& path)
+{
+	HANDLE fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+		FILE_FLAG_NO_BUFFERING, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	CloseHandle(fileHandle);
+	return true;
 }
 
-void ProcessDirectory(FbxManager* pFbxManager, FbxScene* pFbxScene, std::wstring inputRootPath, std::wstring outputRootPath, std::wstring currentPath)
+// Time one import into a scratch scene, so the benchmark doesn't disturb the scene being worked on.
+double TimeImport(FbxManager* pFbxManager, const std::function<bool(FbxScene*)>& load, bool& succeeded)
 {
-	bool bAbort = false;
-    tinydir_dir dir;
-    if (tinydir_open(&dir, currentPath.c_str()) != -1)
-    {
-        while ((dir.has_next) && (!bAbort))
-        {
-            tinydir_file file;
-            if (tinydir_readfile(&dir, &file) != -1)
-            {				
-				if ((file.is_dir > 0) && lstrcmpiW(file.name, L".") && lstrcmpiW(file.name, L".."))
-				{
-					ProcessDirectory(pFbxManager, pFbxScene, inputRootPath, outputRootPath, file.path);
-				}				
-				else if (lstrcmpiW(file.extension, L"FBX") == 0)
-                {
-                    std::wstring outputFilePath = file.path;
-                    outputFilePath.replace(0, inputRootPath.size(), outputRootPath);
-					
-					std::filesystem::path oPath(outputFilePath);
-					oPath.remove_filename();
-					std::filesystem::create_directories(oPath);
-                    ProcessFile(pFbxManager, pFbxScene, WStr2FbxStr(file.path), WStr2FbxStr(outputFilePath));
-                }
-
-                if (tinydir_next(&dir) == -1)
-                {
-                    FBXSDK_printf("Error getting next file");
-                    bAbort = true;
-                }
-            }
-            else
-            {
-                FBXSDK_printf("Error getting file");
-                bAbort = true;
-            }
-        }
-    }
-    else
-    {
-        FBXSDK_printf("Folder not found.");
-    }
+	FbxScene* pScratchScene = FbxScene::Create(pFbxManager, "Benchmark");
+	auto loadStart = std::chrono::steady_clock::now();
+
+	succeeded = load(pScratchScene) && succeeded;
 
-    tinydir_close(&dir);    
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+	pScratchScene->Destroy(true);
+
+	return seconds;
 }
 
-int ReadJointFile(std::string &jointMetaFilePath)
+// Import the file repeatedly by name, through a mapped view and from a buffer already in memory, and compare the
+// times with the page cache cold and warm. A buffer is never cold, as the bytes are in memory before the import.
+bool BenchmarkImport(FbxManager* pFbxManager, FbxString fbxInFilePath, int runs)
 {
-	// Read joints file.
-	std::ifstream jointStream(jointMetaFilePath);
-	std::stringstream lineStream;
-	if (jointStream)
+	wchar_t* pInputPath = nullptr;
+	FbxUTF8ToWC(fbxInFilePath.Buffer(), pInputPath);
+	std::wstring inputPath = pInputPath ? pInputPath : L"";
+	delete[] pInputPath;
+
+	std::ifstream inputStream(std::filesystem::path(inputPath), std::ios::binary);
+	std::vector<char> fileBytes((std::istreambuf_iterator<char>(inputStream)), std::istreambuf_iterator<char>());
+	if (fileBytes.empty())
 	{
-		lineStream << jointStream.rdbuf();
-		jointStream.close();
+		std::cerr << "Error: Unable to read " << fbxInFilePath.Buffer() << " for the import benchmark." << std::endl;
+		return false;
 	}
-	std::string jointString = lineStream.str();
 
-	rapidjson::Document jointJSONDocument;
+	bool wasMappingInput = gIsMappingInput;
+	bool succeeded = true;
+	bool isEvicting = true;
+	std::vector<double> fileCold, fileWarm, mapCold, mapWarm, bufferWarm;
 
-	if (jointJSONDocument.Parse(jointString.c_str()).HasParseError())
+	auto loadByName = [&](bool isMapping)
 	{
-		auto error = jointJSONDocument.GetParseError();
-		std::cerr << "JSON Read Error: " << error << std::endl;
-		return 1;
-	}
-	else
+		return [&, isMapping](FbxScene* pScene)
+		{
+			gIsMappingInput = isMapping;
+			return LoadScene(pFbxManager, pScene, fbxInFilePath);
+		};
+	};
+
+	for (int run = 0; run < runs; run++)
 	{
-		if (jointJSONDocument.HasMember("joints") && jointJSONDocument["joints"].IsArray()) {
-            const rapidjson::Value& joints = jointJSONDocument["joints"];
-            for (rapidjson::SizeType i = 0; i < joints.Size(); i++)
-            {
-                assert(joints[i].IsObject());
+		isEvicting = EvictFromFileCache(inputPath) && isEvicting;
+		fileCold.push_back(TimeImport(pFbxManager, loadByName(false), succeeded));
+		fileWarm.push_back(TimeImport(pFbxManager, loadByName(false), succeeded));
 
-                SJointEnhancement newJoint;
+		isEvicting = EvictFromFileCache(inputPath) && isEvicting;
+		mapCold.push_back(TimeImport(pFbxManager, loadByName(true), succeeded));
+		mapWarm.push_back(TimeImport(pFbxManager, loadByName(true), succeeded));
+
+		bufferWarm.push_back(TimeImport(pFbxManager, [&](FbxScene* pScene)
+		{
+			return LoadScene(pFbxManager, pScene, fileBytes.data(), fileBytes.size(), fbxInFilePath.Buffer());
+		}, succeeded));
+	}
 
-                // Load up our map with the data in the JSON file.
-                newJoint.oldName = joints[i]["old-name"].GetString();
-                newJoint.newName = joints[i]["new-name"].GetString();
+	gIsMappingInput = wasMappingInput;
 
-                if (joints[i].HasMember("physics-proxy"))
-                {
-                    newJoint.physicsProxy = joints[i]["physics-proxy"].GetString();
-                }
+	auto report = [](const char* pName, std::vector<double> times)
+	{
+		if (times.empty())
+			return;
+
+		std::sort(times.begin(), times.end());
+		FBXSDK_printf("    %-14s median %.3f s, best %.3f s\n", pName, times [times.size() / 2], times.front());
+	};
+
+	FBXSDK_printf("\nImport benchmark, %d run(s) of %.1f MB\n", runs, fileBytes.size() / (1024.0 * 1024.0));
+	report("File, cold", fileCold);
+	report("File, warm", fileWarm);
+	report("Mapped, cold", mapCold);
+	report("Mapped, warm", mapWarm);
+	report("Buffer", bufferWarm);
+
+	if (!isEvicting)
+		FBXSDK_printf("The file couldn't be dropped from the cache, so the cold figures may be warm.\n");
+	if (!succeeded)
+		FBXSDK_printf("Some of the imports failed.\n");
+
+	return succeeded;
+}
 
-                if (joints[i].HasMember("ragdoll-proxy"))
-                {
-                    newJoint.ragdollProxy = joints[i]["ragdoll-proxy"].GetString();
-                }
+// The name the first animation stack is given: the base part of the input's filename.
+std::string GetAnimationName(FbxString fbxInFilePath)
+{
+	// We really only want the base part of the filename. This code is windows specific and MS compiler specific.
+	char fname [255];
+	char ext [20];
+	_splitpath_s(fbxInFilePath, nullptr, 0, nullptr, 0, fname, sizeof(fname), ext, sizeof(ext));
 
-                if (joints[i].HasMember("primitive-type"))
-                {
-                    newJoint.primitiveType = joints[i]["primitive-type"].GetString();
-                }
+	return fname;
+}
 
-                if (joints[i].HasMember("parent-node"))
-                {
-                    newJoint.parentNode = joints[i]["parent-node"].GetString();
-                }
+// Every file has its animation stack renamed, and the joint map renames skeleton nodes. When the settings ask for
+// nothing more, the renames can be patched into the file without loading it. Patched files keep their own FBX version
+// and array compression, so asking for either means loading the file.
+bool IsRenamingOnly()
+{
+	return gIsPatchingBinary && gAxis.empty() && (abs(gScale - 1.0) <= DBL_EPSILON) && !applyMixamoFixes && !addIK
+		&& !gApplyWeaponFix && !gAddRoot && gRemoveLeafName.empty() && gExportSettings.isBinary
+		&& gExportSettings.fileVersion.IsEmpty() && !gIsCompressionGiven && !gMediaStore && !gIsReportingDuplicateNames;
+}
 
-                jointMap[newJoint.oldName] = newJoint;
-            }
+// The renames RenameSkeleton and RenameFirstAnimation would make, in a form the patch can apply.
+SBinaryPatchRequest BuildPatchRequest(FbxString fbxInFilePath)
+{
+	SBinaryPatchRequest request;
+	request.animationName = GetAnimationName(fbxInFilePath);
+	request.centredNames.insert("Hips");
+
+	request.renameSkeleton = [](const std::string& name, std::string& newName)
+	{
+		uint32_t jointIndex = gJointRenames.Find(name.c_str());
+		if (jointIndex != JointRenameTable::notFound)
+		{
+			newName = gJointRenames.GetNewName(jointIndex);
+			return true;
 		}
 
-		if(jointJSONDocument.HasMember("axis") && jointJSONDocument["axis"].IsString())
-			gAxis = jointJSONDocument["axis"].GetString();
-		if (jointJSONDocument.HasMember("applyWeaponFix") && jointJSONDocument["applyWeaponFix"].IsBool())
-			gApplyWeaponFix = jointJSONDocument["applyWeaponFix"].GetBool();
-		if (jointJSONDocument.HasMember("addRoot") && jointJSONDocument["addRoot"].IsBool())
-			gAddRoot = jointJSONDocument["addRoot"].GetBool();
-        if (jointJSONDocument.HasMember("addRootChildName") && jointJSONDocument["addRootChildName"].IsString())
-            gAddRootChildName = jointJSONDocument["addRootChildName"].GetString();
-		if (jointJSONDocument.HasMember("addRootRootName") && jointJSONDocument["addRootRootName"].IsString())
-			gAddRootRootName = jointJSONDocument["addRootRootName"].GetString();
-        if (jointJSONDocument.HasMember("removeLeafName") && jointJSONDocument["removeLeafName"].IsString())
-            gRemoveLeafName = jointJSONDocument["removeLeafName"].GetString();
-	}
+		return RenameByPattern(name.c_str(), newName);
+	};
 
-	return 0;
+	return request;
 }
 
+// List the names more than one node has. Lookups by those names only ever find the first.
+void ReportDuplicateNames()
+{
+	auto duplicates = gSceneNodes.GetDuplicateNames();
+	if (duplicates.empty())
+		return;
 
-int main(int argc, char** argv)
+	FBXSDK_printf("\nDuplicate node names, where lookups find the first node only:\n");
+	for (const auto& duplicate : duplicates)
+		FBXSDK_printf("    %s (%zu nodes)\n", duplicate.first.c_str(), duplicate.second);
+}
+
+bool TransformScene(FbxManager* pFbxManager, FbxScene* pFbxScene, FbxString fbxInFilePath)
 {
-	SetConsoleOutputCP(CP_UTF8);
+	// switch Axis
+	if (!gAxis.empty()) {
+        FbxAxisSystem axis;
+        FbxAxisSystem::ParseAxisSystem(gAxis.c_str(), axis);
+        axis.DeepConvertScene(pFbxScene);
+	}
 
-	bool didEverythingSucceed { true };
-	bool isBulk { false };
-	std::string inFilePath;
-	std::string outFilePath;
-	std::string jointMetaFilePath;
+	// Every node lookup from here on goes through the index rather than scanning the scene.
+	gSceneNodes.Build(pFbxScene);
+	if (gIsReportingDuplicateNames)
+		ReportDuplicateNames();
 
-	int width = 0;
-	std::string name;
-	bool doIt = false;
-	std::string command;
+	// Display the scene.
+	DisplayMetaData(pFbxScene);
+	InterateContent(pFbxScene);
 
-	auto cli =
-		Opt(inFilePath, "input path")
-		["-i"] ["--input-files"]
-		("path to the input file(s)")
-		| Opt(outFilePath, "output path")
-		["-o"] ["--output-files"]
-		("path for the output file(s)")
-		| Opt(isBulk) ["-b"] ["--bulk"]
-		("Bulk process more than one file?")
-		| Opt(isVerbose)
-		["-v"] ["--verbose"]("Output verbose information")
-		| Opt(jointMetaFilePath, "Joint meta file")
-		["-j"] ["--joints"]
-		| Opt(addIK)
-		["-k"] ["--add-ik"]("Add standard IK bones to the model")
-		| Opt(applyMixamoFixes)
-		["-f"] ["--fixamo"]("Apply fixes to Mixamo model")
-		| Opt(gScale, "uniform scale")
-		["--scale"]("Apply uniform scale");
+	if (applyMixamoFixes)
+		ApplyMixamoFixes(pFbxManager, pFbxScene);
 
-	auto result = cli.parse(Args(argc, argv));
-	if (!result) {
-		std::cerr << "Error in command line: " << result.errorMessage() << std::endl;
-		cli.writeToStream(std::cout);
-		exit(1);
+	// Add a set of joints for IK management.
+	if (addIK)
+		AddIkJoints(pFbxManager, pFbxScene);
+
+	// Optionally, rename the animation to the filename.
+	RenameFirstAnimation(pFbxScene, GetAnimationName(fbxInFilePath).c_str());
+
+	// The scene is about to be saved and cleared, so don't keep pointers into it.
+	gSceneNodes.Clear();
+
+	return true;
+}
+
+
+// Compare two node trees by name, type and local transform, noting the first few differences.
+void CompareNodes(FbxNode* pExpectedNode, FbxNode* pActualNode, std::vector<std::string>& differences)
+{
+	const size_t maxDifferences = 10;
+	std::string name = pExpectedNode->GetName();
+
+	auto note = [&](const std::string& difference)
+	{
+		if (differences.size() < maxDifferences)
+			differences.push_back(name + ": " + difference);
+	};
+
+	FbxNodeAttribute* pExpectedAttribute = pExpectedNode->GetNodeAttribute();
+	FbxNodeAttribute* pActualAttribute = pActualNode->GetNodeAttribute();
+
+	if (name != pActualNode->GetName())
+		note(std::string("named ") + pActualNode->GetName());
+	if ((pExpectedAttribute ? pExpectedAttribute->GetAttributeType() : FbxNodeAttribute::eUnknown)
+		!= (pActualAttribute ? pActualAttribute->GetAttributeType() : FbxNodeAttribute::eUnknown))
+		note("different node attribute");
+	if (pExpectedNode->LclTranslation.Get() != pActualNode->LclTranslation.Get())
+		note("different translation");
+	if (pExpectedNode->LclRotation.Get() != pActualNode->LclRotation.Get())
+		note("different rotation");
+	if (pExpectedNode->LclScaling.Get() != pActualNode->LclScaling.Get())
+		note("different scaling");
+
+	if (pExpectedNode->GetChildCount() != pActualNode->GetChildCount())
+	{
+		note("different number of children");
+		return;
 	}
 
-	FbxString fbxInFilePath = StdStr2FbxStr(inFilePath);
-	FbxManager* pFbxManager = nullptr;
-	FbxScene* pFbxScene = nullptr;
+	for (int i = 0; i < pExpectedNode->GetChildCount(); i++)
+		CompareNodes(pExpectedNode->GetChild(i), pActualNode->GetChild(i), differences);
+}
 
-	// Prepare the FBX SDK.
-	InitializeSdkObjects(pFbxManager, pFbxScene);
-	FBXSDK_printf("\n");
+// Check a patched file against what loading, renaming and saving the input with the FBX SDK would give: the same node
+// tree, names and local transforms, and the same animation stack names.
+bool ComparePatchedScene(FbxManager* pFbxManager, FbxString fbxInFilePath, FbxString fbxOutFilePath)
+{
+	FbxScene* pExpectedScene = FbxScene::Create(pFbxManager, "Expected");
+	FbxScene* pPatchedScene = FbxScene::Create(pFbxManager, "Patched");
+	std::vector<std::string> differences;
 
-	if (jointMetaFilePath.length() > 0)
+	bool isLoaded = LoadScene(pFbxManager, pExpectedScene, fbxInFilePath)
+		&& TransformScene(pFbxManager, pExpectedScene, fbxInFilePath)
+		&& LoadScene(pFbxManager, pPatchedScene, fbxOutFilePath);
+
+	if (isLoaded)
 	{
-		if (int error = ReadJointFile(jointMetaFilePath) != 0)
+		CompareNodes(pExpectedScene->GetRootNode(), pPatchedScene->GetRootNode(), differences);
+
+		int stackCount = pExpectedScene->GetSrcObjectCount<FbxAnimStack>();
+		if (stackCount != pPatchedScene->GetSrcObjectCount<FbxAnimStack>())
+			differences.push_back("Different number of animation stacks");
+
+		for (int i = 0; (i < stackCount) && (i < pPatchedScene->GetSrcObjectCount<FbxAnimStack>()); i++)
 		{
-			std::cerr << "Joint file was mal-formed JSON." << std::endl;
-			exit(error);
+			std::string expectedName = pExpectedScene->GetSrcObject<FbxAnimStack>(i)->GetName();
+			std::string patchedName = pPatchedScene->GetSrcObject<FbxAnimStack>(i)->GetName();
+			if (expectedName != patchedName)
+				differences.push_back("Animation stack " + expectedName + " named " + patchedName);
 		}
 	}
 
-	if (!isBulk)
-	{
-		// Default output is to the same file as the input.
-		FbxString fbxOutFilePath;
-		if (outFilePath.length() > 0)
-			fbxOutFilePath = StdStr2FbxStr(outFilePath);
-		else
-			fbxOutFilePath = fbxInFilePath;
+	pPatchedScene->Destroy(true);
+	pExpectedScene->Destroy(true);
 
-		// There's only one file to process.
-		didEverythingSucceed = didEverythingSucceed && ProcessFile(pFbxManager, pFbxScene, fbxInFilePath, fbxOutFilePath);
+	if (!isLoaded)
+	{
+		FBXSDK_printf("Unable to compare %s with the FBX SDK's result.\n", fbxOutFilePath.Buffer());
+		return false;
 	}
-	else
+
+	if (differences.empty())
 	{
-		bool bAbort = false;
-		if (outFilePath.length() == 0)
-		{
-			std::cerr << "Error: You must supply an output path for bulk conversions." << std::endl;
-			cli.writeToStream(std::cout);
-			exit(1);
-		}
+		FBXSDK_printf("Patched %s matches the FBX SDK's result.\n", fbxOutFilePath.Buffer());
+		return true;
+	}
 
-		// Default to using the present directory if no file path was supplied.
-		TCHAR* tmpInputPath = nullptr;
-		size_t pReturnValue;
-		if (fbxInFilePath.IsEmpty())
-			FbxAnsiToWC(".", tmpInputPath, &pReturnValue);
-		else
-			FbxAnsiToWC(inFilePath.c_str(), tmpInputPath, &pReturnValue);
+	FBXSDK_printf("Patched %s differs from the FBX SDK's result:\n", fbxOutFilePath.Buffer());
+	for (const auto& difference : differences)
+		FBXSDK_printf("    %s\n", difference.c_str());
 
-		std::wstring inputRootPath = tmpInputPath;
-        TCHAR* tmpOutputPath = nullptr;
-        FbxAnsiToWC(outFilePath.c_str(), tmpOutputPath);
-        std::wstring outputRootPath = tmpOutputPath;
-        delete[] tmpOutputPath;
-		delete[] tmpInputPath;
+	return false;
+}
 
-		ProcessDirectory(pFbxManager, pFbxScene, inputRootPath, outputRootPath, inputRootPath);		
+// Make the renames by patching the file. If the file can't be patched, e.g. it is ASCII, nothing is written and the
+// result says so, leaving the caller to load and save it with the FBX SDK. pInfo, if given, receives what the patch
+// found out about the file, such as its skeleton.
+EBinaryPatchResult PatchNames(FbxManager* pFbxManager, FbxString fbxInFilePath, FbxString fbxOutFilePath,
+	SBinaryPatchInfo* pInfo)
+{
+	wchar_t* pInputPath = nullptr;
+	wchar_t* pOutputPath = nullptr;
+	FbxUTF8ToWC(fbxInFilePath.Buffer(), pInputPath);
+	FbxUTF8ToWC(fbxOutFilePath.Buffer(), pOutputPath);
+	std::wstring inputPath = pInputPath ? pInputPath : L"";
+	std::wstring outputPath = pOutputPath ? pOutputPath : L"";
+	delete[] pInputPath;
+	delete[] pOutputPath;
+
+	SBinaryPatchRequest request = BuildPatchRequest(fbxInFilePath);
+	auto patchStart = std::chrono::steady_clock::now();
+
+	SBinaryPatchInfo info;
+	EBinaryPatchResult result = PatchBinaryFbxNames(inputPath, outputPath, request, gExportSettings.syncPolicy, info);
+
+	switch (result)
+	{
+		case eBinaryPatchApplied:
+			FBXSDK_printf("\n\nFile: %s\n\nAnimation Stack Name: \nRenamed from %s to %s\n\n", fbxInFilePath.Buffer(),
+				info.oldName.c_str(), request.animationName.c_str());
+			if (info.renamedNodeCount > 0)
+				FBXSDK_printf("Renamed %d skeleton node(s)\n", info.renamedNodeCount);
+			FBXSDK_printf("Patched %s in %.3f s\n", fbxOutFilePath.Buffer(),
+				std::chrono::duration<double>(std::chrono::steady_clock::now() - patchStart).count());
+
+			if (pInfo)
+				*pInfo = info;
+
+			if (gIsComparingPatch && !ComparePatchedScene(pFbxManager, fbxInFilePath, fbxOutFilePath))
+				result = eBinaryPatchFailed;
+			break;
+
+		case eBinaryPatchUnsupported:
+			if (isVerbose)
+				FBXSDK_printf("Not patching %s: %s.\n", fbxInFilePath.Buffer(), info.reason.c_str());
+			break;
+
+		case eBinaryPatchFailed:
+			FBXSDK_printf("\n\nUnable to patch %s: %s.\n", fbxInFilePath.Buffer(), info.reason.c_str());
+			break;
 	}
 
-	// Destroy all objects created by the FBX SDK.
-	FBXSDK_printf("\n");
-	DestroySdkObjects(pFbxManager, didEverythingSucceed);
+	return result;
+}
 
-	return 0;
+
+bool SaveOutputScene(FbxManager* pFbxManager, FbxScene* pFbxScene, FbxString fbxOutFilePath)
+{
+	// Save a copy of the scene to a new file.
+	auto saveStart = std::chrono::steady_clock::now();
+	bool result = SaveScene(pFbxManager, pFbxScene, fbxOutFilePath);
+	double saveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - saveStart).count();
+
+	if (result == false)
+	{
+		FBXSDK_printf("\n\nAn error occurred while saving the scene...\n");
+	}
+	else
+	{
+		wchar_t* pOutFilePath = nullptr;
+		FbxUTF8ToWC(fbxOutFilePath.Buffer(), pOutFilePath);
+		std::error_code error;
+		uintmax_t fileSize = pOutFilePath ? std::filesystem::file_size(pOutFilePath, error) : 0;
+		delete[] pOutFilePath;
+
+		FBXSDK_printf("Exported %s: %.1f KB as %s in %.3f s\n", fbxOutFilePath.Buffer(), error ? 0.0 : fileSize / 1024.0,
+			gExportSettings.isBinary ? "binary" : "ASCII", saveSeconds);
+	}
+
+	return result;
+}
+
+
+bool ProcessFile(FbxManager* pFbxManager, FbxScene* pFbxScene, FbxString fbxInFilePath, FbxString fbxOutFilePath)
+{
+	bool result = false;
+
+	// Load the scene if there is one.
+	if (!fbxInFilePath.IsEmpty())
+	{
+		EBinaryPatchResult patchResult = IsRenamingOnly()
+			? PatchNames(pFbxManager, fbxInFilePath, fbxOutFilePath, nullptr) : eBinaryPatchUnsupported;
+		if (patchResult != eBinaryPatchUnsupported)
+			return patchResult == eBinaryPatchApplied;
+
+		result = LoadInputScene(pFbxManager, pFbxScene, fbxInFilePath)
+			&& TransformScene(pFbxManager, pFbxScene, fbxInFilePath)
+			&& SaveOutputScene(pFbxManager, pFbxScene, fbxOutFilePath);
+	}
+	else
+	{
+		FBXSDK_printf("\n\nUsage: ImportScene <FBX file name>\n\n");
+	}
+
+	return result;
+}
+
+FbxString StdStr2FbxStr(std::string str)
+{
+    FbxString retStr = "";
+
+    char* newStr = NULL;
+    FbxAnsiToUTF8(str.c_str(), newStr);//Character encoding conversion API provided by Fbx Sdk
+    if (NULL != newStr)
+    {
+        retStr = newStr;
+        delete[] newStr;//remember to release
+    }
+
+    return retStr;
+}
+
+FbxString WStr2FbxStr(std::wstring str)
+{
+    FbxString retStr = "";
+
+    char* newStr = NULL;
+    FbxWCToUTF8(str.c_str(), newStr);//Character encoding conversion API provided by Fbx Sdk
+    if (NULL != newStr)
+    {
+        retStr = newStr;
+        delete[] newStr;//remember to release
+    }
+
+    return retStr;
+}
+
+void CreateOutputDirectory(const SBulkFile& file)
+{
+	std::filesystem::path oPath(file.outputPath);
+	oPath.remove_filename();
+	std::filesystem::create_directories(oPath);
+}
+
+// Parse "load,transform,save" worker counts for --pipeline.
+bool ParsePipelineWidths(const std::string& text, SPipelineWidths& widths)
+{
+	std::stringstream textStream(text);
+	int* stageWidths [] = { &widths.load, &widths.transform, &widths.save };
+	std::string item;
+
+	for (int* pWidth : stageWidths)
+	{
+		if (!std::getline(textStream, item, ','))
+			return false;
+
+		try
+		{
+			*pWidth = std::stoi(item);
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+
+		if (*pWidth < 1)
+			return false;
+	}
+
+	return !std::getline(textStream, item, ',');
+}
+
+// Accepts an SDK version string such as FBX201400, the year of the FBX release, or the file format number.
+bool ParseFbxFileVersion(const std::string& text, FbxString& fileVersion)
+{
+	static const std::map<std::string, const char*> versionNames =
+	{
+		{ "2011", FBX_2011_00_COMPATIBLE }, { "7.1", FBX_2011_00_COMPATIBLE },
+		{ "2012", FBX_2012_00_COMPATIBLE }, { "7.2", FBX_2012_00_COMPATIBLE },
+		{ "2013", FBX_2013_00_COMPATIBLE }, { "7.3", FBX_2013_00_COMPATIBLE },
+		{ "2014", FBX_2014_00_COMPATIBLE }, { "7.4", FBX_2014_00_COMPATIBLE },
+		{ "2016", FBX_2016_00_COMPATIBLE }, { "7.5", FBX_2016_00_COMPATIBLE },
+	};
+
+	auto version = versionNames.find(text);
+	if (version != versionNames.end())
+	{
+		fileVersion = version->second;
+		return true;
+	}
+
+	// Anything else of the right shape is left to SaveScene, which reports versions the SDK can't write.
+	if ((text.size() == 9) && (text.compare(0, 3, "FBX") == 0))
+	{
+		fileVersion = text.c_str();
+		return true;
+	}
+
+	return false;
+}
+
+// Shards are numbered from one on the command line, as in "--shard 2/4".
+bool ParseShard(const std::string& text, SBulkShard& shard)
+{
+	size_t slash = text.find('/');
+	if (slash == std::string::npos)
+		return false;
+
+	try
+	{
+		size_t used;
+		int index = std::stoi(text.substr(0, slash), &used);
+		if (used != slash)
+			return false;
+
+		int count = std::stoi(text.substr(slash + 1), &used);
+		if (used != text.size() - slash - 1)
+			return false;
+
+		if ((count < 1) || (index < 1) || (index > count))
+			return false;
+
+		shard.index = index - 1;
+		shard.count = count;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+// Skeleton node names as they are before any renaming; these are what the joint map is matched against.
+void CollectSkeletonNames(FbxNode* pFbxNode, std::vector<std::string>& names)
+{
+	FbxNodeAttribute* pAttribute = pFbxNode->GetNodeAttribute();
+	if (pAttribute && pAttribute->GetAttributeType() == FbxNodeAttribute::eSkeleton)
+		names.push_back(pFbxNode->GetName());
+
+	for (int i = 0; i < pFbxNode->GetChildCount(); i++)
+		CollectSkeletonNames(pFbxNode->GetChild(i), names);
+}
+
+void RecordSkeleton(BulkManifest& manifest, FbxScene* pFbxScene, const SBulkFile& file)
+{
+	std::vector<std::string> names;
+	CollectSkeletonNames(pFbxScene->GetRootNode(), names);
+	manifest.RecordSkeleton(file, names);
+}
+
+// Load a bulk input and tell the manifest what it needs to know about the file, hashed from the bytes just loaded.
+bool LoadBulkInput(BulkManifest& manifest, FbxManager* pFbxManager, FbxScene* pFbxScene, const SBulkFile& file)
+{
+	uint64_t contentHash = 0;
+	bool isHashed = false;
+	if (!LoadInputScene(pFbxManager, pFbxScene, WStr2FbxStr(file.inputPath), &contentHash, &isHashed))
+		return false;
+
+	RecordSkeleton(manifest, pFbxScene, file);
+	if (isHashed)
+		manifest.RecordContentHash(file, contentHash);
+
+	return true;
+}
+
+// Hash everything that decides what a bulk run writes, for the incremental manifest. Any new setting that changes
+// the output must be added here, or files will be wrongly skipped after it changes.
+SManifestConfig BuildManifestConfig(FbxManager* pFbxManager)
+{
+	SManifestConfig config;
+	config.toolVersion = std::string(FBXTOOL_VERSION) + " FBX SDK " + pFbxManager->GetVersion();
+
+	ContentHash options;
+	options.UpdateField(gAxis);
+	options.UpdateField(std::to_string(gScale));
+	options.UpdateField(applyMixamoFixes ? "fixamo" : "");
+	options.UpdateField(addIK ? "add-ik" : "");
+	options.UpdateField(gApplyWeaponFix ? "weapon-fix" : "");
+	options.UpdateField(gAddRoot ? "add-root" : "");
+	options.UpdateField(gAddRootChildName);
+	options.UpdateField(gAddRootRootName);
+	options.UpdateField(gRemoveLeafName);
+	options.UpdateField(gExportSettings.isBinary ? "binary" : "ascii");
+	options.UpdateField(gExportSettings.fileVersion.Buffer());
+	options.UpdateField(gExportSettings.isCompressingArrays ? std::to_string(gExportSettings.compressionLevel) : "uncompressed");
+	options.UpdateField(std::to_string(gExportSettings.compressionMinSize));
+	options.UpdateField(DescribeSceneElements(gSceneElements, true));
+	options.UpdateField(gIsPatchingBinary ? "patch" : "");
+	options.UpdateField(gMediaStore ? WStr2FbxStr(gMediaStore->GetDirectory()).Buffer() : "");
+
+	// The patterns can rename any node, so they're part of every file's options rather than rules of their own.
+	for (const auto& pattern : jointPatterns)
+	{
+		options.UpdateField(pattern.pattern);
+		options.UpdateField(pattern.newName);
+	}
+	for (uint32_t i = 0; !jointPatterns.empty() && (i < gJointChainTail.GetSize()); i++)
+	{
+		options.UpdateField(gJointChainTail.GetOldName(i));
+		options.UpdateField(gJointChainTail.GetNewName(i));
+	}
+	config.optionsHash = options.Finish();
+
+	for (const auto& joint : jointMap)
+	{
+		ContentHash rule;
+		rule.UpdateField(joint.second.newName);
+		rule.UpdateField(joint.second.physicsProxy);
+		rule.UpdateField(joint.second.ragdollProxy);
+		rule.UpdateField(joint.second.primitiveType);
+		rule.UpdateField(joint.second.parentNode);
+		config.ruleHashes [joint.first] = rule.Finish();
+	}
+
+	return config;
+}
+
+// Find the input files by scanning the input folder, or from the file list if there is one. Returns the number of
+// listed files that couldn't be used.
+size_t ScanInputFiles(const std::wstring& inputRootPath, const std::wstring& outputRootPath, const SBulkOptions& options,
+	BulkFileVisitor visitor)
+{
+	if (options.fileListPath.empty())
+	{
+		EnumerateBulkDirectory(inputRootPath, outputRootPath, options.scanThreadCount, visitor);
+		return 0;
+	}
+
+	if (options.fileListPath == "-")
+		return ReadBulkFileList(std::cin, inputRootPath, outputRootPath, visitor);
+
+	std::ifstream listStream(options.fileListPath);
+	if (!listStream)
+	{
+		std::cerr << "Error: Unable to read the file list " << options.fileListPath << "." << std::endl;
+		return 1;
+	}
+
+	return ReadBulkFileList(listStream, inputRootPath, outputRootPath, visitor);
+}
+
+// Report on a file, or every file under a folder, from the headers alone. Writes JSON lines to stdout.
+bool InspectPath(const std::wstring& inputPath, const SBulkOptions& options)
+{
+	std::wstring inputRootPath = inputPath;
+	BulkFileFeed feed;
+	size_t failed = 0;
+	std::thread scanThread;
+
+	std::error_code error;
+	if (std::filesystem::is_directory(inputPath, error) || !options.fileListPath.empty())
+	{
+		scanThread = std::thread([&]()
+		{
+			failed += ScanInputFiles(inputRootPath, inputRootPath, options, [&feed](const SBulkFile& file) { feed.Push(file); });
+			feed.Close();
+		});
+	}
+	else
+	{
+		inputRootPath = std::filesystem::path(inputPath).parent_path().wstring();
+		feed.Push({ inputPath, inputPath, 0 });
+		feed.Close();
+	}
+
+	size_t failedInspections = InspectFiles(feed, options.jobCount, inputRootPath, std::cout);
+
+	if (scanThread.joinable())
+		scanThread.join();
+
+	return (failed + failedInspections) == 0;
+}
+
+void ProcessDirectory(FbxManager*& pFbxManager, FbxScene*& pFbxScene, std::wstring inputRootPath, std::wstring outputRootPath,
+	const SBulkOptions& options, SBulkResult& result)
+{
+	std::wstring shardTag = GetShardTag(options.shard);
+
+	BulkManifest manifest(inputRootPath, outputRootPath, BuildManifestConfig(pFbxManager), shardTag);
+	if (!options.isFullRebuild)
+		manifest.Load();
+
+	BulkJournal journal(inputRootPath, outputRootPath, shardTag);
+	if (!journal.Open(options.isResuming))
+		std::cerr << "Error: Unable to open the bulk journal, this run can not be resumed." << std::endl;
+
+	// Anything finished before a crash, or unchanged since the last run, is skipped before it is ever loaded. Files
+	// that were in flight during a crash are held back and retried on their own at the end. Called from the scanning
+	// threads, and returns true for a file that should be processed now.
+	std::mutex sortMutex;
+	std::vector<SBulkFile> foundFiles;
+	std::vector<SBulkFile> files;
+	std::vector<SBulkFile> suspectFiles;
+	std::vector<SBulkFile> quarantinedFiles;
+	auto sortFile = [&](const SBulkFile& file)
+	{
+		bool isQuarantined = journal.IsQuarantined(file);
+		bool isWanted = !isQuarantined && !journal.IsCompleted(file)
+			&& (options.isFullRebuild || manifest.NeedsProcessing(file));
+		if (isWanted)
+			manifest.Forget(file);
+
+		bool isSuspect = isWanted && journal.IsSuspect(file);
+
+		std::lock_guard<std::mutex> lock(sortMutex);
+		foundFiles.push_back(file);
+		if (isQuarantined)
+			quarantinedFiles.push_back(file);
+		else if (isSuspect)
+			suspectFiles.push_back(file);
+		else if (isWanted)
+			files.push_back(file);
+
+		return isWanted && !isSuspect;
+	};
+
+	size_t badListEntries = 0;
+	auto scan = [&](BulkFileVisitor visitor)
+	{
+		std::chrono::steady_clock::time_point scanStart = std::chrono::steady_clock::now();
+		badListEntries = ScanInputFiles(inputRootPath, outputRootPath, options, visitor);
+
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - scanStart).count();
+	};
+
+	// The pipeline and size-balanced shards need the whole list before they start; otherwise files are processed as
+	// soon as the scan finds them.
+	bool isStreamed = !options.isPipelined && !options.shard.isBySize;
+	double scanSeconds = 0.0;
+	std::vector<SBulkFile> treeFiles;
+	std::mutex treeMutex;
+	BulkFileFeed feed;
+	std::thread scanThread;
+
+	if (isStreamed)
+	{
+		scanThread = std::thread([&]()
+		{
+			scanSeconds = scan([&](const SBulkFile& file)
+			{
+				if (IsInHashShard(GetBulkRelativePath(inputRootPath, file.inputPath), options.shard) && sortFile(file))
+					feed.Push(file);
+			});
+			feed.Close();
+		});
+	}
+	else
+	{
+		scanSeconds = scan([&treeFiles, &treeMutex](const SBulkFile& file)
+		{
+			std::lock_guard<std::mutex> lock(treeMutex);
+			treeFiles.push_back(file);
+		});
+
+		for (const auto& file : SelectShard(treeFiles, inputRootPath, options.shard))
+			sortFile(file);
+	}
+
+	auto finishFile = [&manifest, &journal](const SBulkFile& file, bool succeeded)
+	{
+		manifest.RecordResult(file, succeeded);
+		journal.Finished(file, succeeded);
+	};
+
+	// Run a file's work with an exception counted as a failure like any other, so the journal shows the file finished
+	// instead of leaving it looking like a crash for the next --resume to retry and eventually quarantine.
+	auto guardFile = [&finishFile](const SBulkFile& file, const std::function<bool()>& work)
+	{
+		try
+		{
+			return work();
+		}
+		catch (const std::exception& exception)
+		{
+			FBXSDK_printf("\n\nAn exception occurred while processing the file: %s\n", exception.what());
+		}
+		catch (...)
+		{
+			FBXSDK_printf("\n\nAn unknown exception occurred while processing the file.\n");
+		}
+
+		finishFile(file, false);
+		return false;
+	};
+
+	// A rename-only run patches the names straight into the output where it can, without loading the file. Returns
+	// true if the file was dealt with that way, finished and with its result set.
+	auto tryPatchFile = [&manifest, &finishFile](FbxManager* pManager, const SBulkFile& file, bool& fileResult)
+	{
+		if (!IsRenamingOnly())
+			return false;
+
+		CreateOutputDirectory(file);
+
+		SBinaryPatchInfo info;
+		EBinaryPatchResult patchResult = PatchNames(pManager, WStr2FbxStr(file.inputPath), WStr2FbxStr(file.outputPath), &info);
+		if (patchResult == eBinaryPatchUnsupported)
+			return false;
+
+		if (patchResult == eBinaryPatchApplied)
+		{
+			manifest.RecordSkeleton(file, info.skeletonNames);
+			if (info.hasContentHash)
+				manifest.RecordContentHash(file, info.contentHash);
+		}
+
+		fileResult = (patchResult == eBinaryPatchApplied);
+		finishFile(file, fileResult);
+		return true;
+	};
+
+	auto processFile = [&manifest, &journal, &finishFile, &guardFile, &tryPatchFile](FbxManager* pManager, FbxScene* pScene,
+		const SBulkFile& file)
+	{
+		journal.Started(file);
+
+		return guardFile(file, [&]()
+		{
+			bool fileResult = false;
+			if (tryPatchFile(pManager, file, fileResult))
+				return fileResult;
+
+			CreateOutputDirectory(file);
+
+			FbxString fbxInFilePath = WStr2FbxStr(file.inputPath);
+			fileResult = LoadBulkInput(manifest, pManager, pScene, file);
+			if (fileResult)
+			{
+				fileResult = TransformScene(pManager, pScene, fbxInFilePath)
+					&& SaveOutputScene(pManager, pScene, WStr2FbxStr(file.outputPath));
+			}
+
+			finishFile(file, fileResult);
+			return fileResult;
+		});
+	};
+
+	if (options.isPipelined)
+	{
+		SBulkStages stages;
+		stages.load = [&manifest, &journal, &finishFile, &guardFile, &tryPatchFile](FbxManager* pManager, FbxScene* pScene,
+			const SBulkFile& file)
+		{
+			journal.Started(file);
+
+			EBulkLoadResult loadResult = eBulkLoadFailed;
+			guardFile(file, [&]()
+			{
+				bool fileResult = false;
+				if (tryPatchFile(pManager, file, fileResult))
+				{
+					loadResult = fileResult ? eBulkLoadFinished : eBulkLoadFailed;
+					return fileResult;
+				}
+
+				if (!LoadBulkInput(manifest, pManager, pScene, file))
+				{
+					finishFile(file, false);
+					return false;
+				}
+
+				loadResult = eBulkLoaded;
+				return true;
+			});
+
+			return loadResult;
+		};
+		stages.transform = [&finishFile, &guardFile](FbxManager* pManager, FbxScene* pScene, const SBulkFile& file)
+		{
+			return guardFile(file, [&]()
+			{
+				bool stageResult = TransformScene(pManager, pScene, WStr2FbxStr(file.inputPath));
+				if (!stageResult)
+					finishFile(file, false);
+
+				return stageResult;
+			});
+		};
+		stages.save = [&finishFile, &guardFile](FbxManager* pManager, FbxScene* pScene, const SBulkFile& file)
+		{
+			return guardFile(file, [&]()
+			{
+				CreateOutputDirectory(file);
+				bool stageResult = SaveOutputScene(pManager, pScene, WStr2FbxStr(file.outputPath));
+				finishFile(file, stageResult);
+
+				return stageResult;
+			});
+		};
+
+		result = ProcessBulkPipeline(pFbxManager, pFbxScene, files, options.pipelineWidths, stages);
+	}
+	else if (isStreamed)
+	{
+		result = ProcessBulkStream(pFbxManager, pFbxScene, feed, options.jobCount, processFile);
+		scanThread.join();
+	}
+	else
+	{
+		result = ProcessBulkFiles(pFbxManager, pFbxScene, files, options.jobCount, processFile);
+	}
+
+	result.scanSeconds = scanSeconds;
+	if (options.shard.count > 1)
+	{
+		FBXSDK_printf("\n\nShard %d of %d: %zu files.\n", options.shard.index + 1, options.shard.count, foundFiles.size());
+		manifest.RetainOnly(foundFiles);
+	}
+
+	// One at a time, so if a suspect crashes the process again the journal blames it and nothing else.
+	if (!suspectFiles.empty())
+	{
+		FBXSDK_printf("\n\nRetrying %zu file(s) that were in flight during an earlier crash.\n", suspectFiles.size());
+
+		SBulkResult suspectResult = ProcessBulkFiles(pFbxManager, pFbxScene, suspectFiles, 1, processFile);
+		result.succeeded += suspectResult.succeeded;
+		result.failed += suspectResult.failed;
+		result.makespanSeconds += suspectResult.makespanSeconds;
+		result.sceneStats.Merge(suspectResult.sceneStats);
+	}
+
+	result.skipped = foundFiles.size() - files.size() - suspectFiles.size() - quarantinedFiles.size();
+	result.quarantined = quarantinedFiles.size();
+	result.failed += badListEntries;
+
+	journal.Close();
+	if (!manifest.Save(&result))
+		std::cerr << "Error: Unable to write the bulk manifest." << std::endl;
+
+	DisplayBulkResult(result);
+	ReportQuarantinedFiles(outputRootPath, quarantinedFiles, inputRootPath, shardTag);
+}
+
+// Fold the manifests left by every shard of a distributed run into the main manifest, and report on the run as a
+// whole. The main manifest is only replaced once every shard has finished with the same settings.
+bool MergeShardManifests(FbxManager* pFbxManager, std::wstring inputRootPath, std::wstring outputRootPath, int shardCount)
+{
+	BulkManifest manifest(inputRootPath, outputRootPath, BuildManifestConfig(pFbxManager));
+	std::vector<std::wstring> shardPaths;
+	SBulkResult total;
+	bool isComplete { true };
+
+	FBXSDK_printf("Merging %d shard manifests.\n", shardCount);
+
+	for (int shardIndex = 0; shardIndex < shardCount; shardIndex++)
+	{
+		SBulkShard shard;
+		shard.index = shardIndex;
+		shard.count = shardCount;
+
+		std::wstring shardPath = manifest.GetManifestPath(GetShardTag(shard));
+		SBulkResult shardResult;
+		if (!manifest.MergeFrom(shardPath, &shardResult))
+		{
+			std::cerr << "Error: Shard " << shardIndex + 1 << " of " << shardCount << " has no usable manifest." << std::endl;
+			isComplete = false;
+			continue;
+		}
+		shardPaths.push_back(shardPath);
+
+		FBXSDK_printf("    Shard %d: %zu succeeded, %zu failed, %zu skipped, %zu quarantined, %d workers, %.2f s\n",
+			shardIndex + 1, shardResult.succeeded, shardResult.failed, shardResult.skipped, shardResult.quarantined,
+			shardResult.workers, shardResult.makespanSeconds);
+
+		total.succeeded += shardResult.succeeded;
+		total.failed += shardResult.failed;
+		total.skipped += shardResult.skipped;
+		total.quarantined += shardResult.quarantined;
+		total.workers += shardResult.workers;
+
+		// The shards run side by side, so the run takes as long as its slowest shard.
+		total.makespanSeconds = (std::max)(total.makespanSeconds, shardResult.makespanSeconds);
+	}
+
+	if (!isComplete)
+		return false;
+
+	if (!manifest.Save(&total))
+	{
+		std::cerr << "Error: Unable to write the bulk manifest." << std::endl;
+		return false;
+	}
+
+	// The next sharded run starts each shard from the merged manifest.
+	for (const auto& shardPath : shardPaths)
+	{
+		std::error_code error;
+		std::filesystem::remove(shardPath, error);
+	}
+
+	FBXSDK_printf("\n\nDistributed run complete: %zu files, %zu succeeded, %zu failed, %zu skipped, %zu quarantined.\n",
+		total.succeeded + total.failed + total.skipped + total.quarantined, total.succeeded, total.failed, total.skipped,
+		total.quarantined);
+	FBXSDK_printf("    Workers: %d across %d shards\n", total.workers, shardCount);
+	FBXSDK_printf("    Makespan: %.2f s\n", total.makespanSeconds);
+
+	return (total.failed == 0) && (total.quarantined == 0);
+}
+
+// Build the table and patterns InterateContent looks joints up in from the joint map and pattern rules.
+bool CompileJointRenames()
+{
+	std::vector<std::pair<std::string, std::string>> renames;
+	renames.reserve(jointMap.size());
+	for (const auto& joint : jointMap)
+		renames.emplace_back(joint.first, joint.second.newName);
+
+	gJointRenames = JointRenameTable(renames);
+
+	std::string error;
+	if (!gJointPatterns.Compile(jointPatterns, error))
+	{
+		std::cerr << "Error: " << error << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int ReadJointJsonFile(const std::string& jointMetaFilePath, SJointMapping& mapping, std::map<std::string, SJointEnhancement>& enhancements)
+{
+	SJointFile jointFile;
+	bool isFromCache = false;
+	std::string error;
+	if (!LoadJointFile(jointMetaFilePath, gJointCachePath, jointFile, isFromCache, error))
+	{
+		std::cerr << "Error: " << error << std::endl;
+		return 1;
+	}
+
+	if (isVerbose && isFromCache)
+		FBXSDK_printf("Read %s from the joint cache.\n", jointMetaFilePath.c_str());
+
+	for (const auto& joint : jointFile.joints)
+	{
+		if (!AddJointRename(mapping, joint.oldName, joint.newName, error))
+		{
+			std::cerr << "Error: " << error << std::endl;
+			return 1;
+		}
+
+		SJointEnhancement& enhancement = enhancements [joint.oldName];
+		enhancement.oldName = joint.oldName;
+		enhancement.newName = joint.newName;
+		enhancement.physicsProxy = joint.physicsProxy;
+		enhancement.ragdollProxy = joint.ragdollProxy;
+		enhancement.primitiveType = joint.primitiveType;
+		enhancement.parentNode = joint.parentNode;
+	}
+
+	// Pattern rules rename whole families of joints, e.g. stripping "mixamorig:" from every name.
+	mapping.patterns.insert(mapping.patterns.end(), jointFile.patterns.begin(), jointFile.patterns.end());
+
+	gAxis = jointFile.axis.value_or(gAxis);
+	gApplyWeaponFix = jointFile.applyWeaponFix.value_or(gApplyWeaponFix);
+	gAddRoot = jointFile.addRoot.value_or(gAddRoot);
+	gAddRootChildName = jointFile.addRootChildName.value_or(gAddRootChildName);
+	gAddRootRootName = jointFile.addRootRootName.value_or(gAddRootRootName);
+	gRemoveLeafName = jointFile.removeLeafName.value_or(gRemoveLeafName);
+
+	return 0;
+}
+
+// Read the joint files passed to -j, composing a chain of them into one set of renames. Settings such as the axis
+// are taken from the last file in the chain that has them.
+int ReadJointFile(std::string &jointMetaFilePath)
+{
+	std::vector<SJointMapping> mappings;
+	std::vector<std::map<std::string, SJointEnhancement>> enhancements;
+
+	for (const auto& path : SplitJointFileList(jointMetaFilePath))
+	{
+		mappings.emplace_back();
+		mappings.back().path = path;
+		enhancements.emplace_back();
+
+		std::string error;
+		if (std::filesystem::path(path).extension() == ".txt")
+		{
+			if (!ReadJointTextFile(path, mappings.back(), error))
+			{
+				std::cerr << "Error: " << error << std::endl;
+				return 1;
+			}
+		}
+		else if (int jsonError = ReadJointJsonFile(path, mappings.back(), enhancements.back()))
+		{
+			return jsonError;
+		}
+	}
+
+	SComposedJointChain chain;
+	std::string error;
+	if (!ComposeJointChain(mappings, chain, error))
+	{
+		std::cerr << "Error: " << error << std::endl;
+		return 1;
+	}
+
+	for (const auto& composed : chain.joints)
+	{
+		// The enhancements come from the first file with an entry for the name the joint had at that point.
+		SJointEnhancement joint;
+		for (size_t stage = 0; stage < enhancements.size(); stage++)
+		{
+			auto enhancement = enhancements [stage].find(composed.names [stage]);
+			if (enhancement != enhancements [stage].end())
+			{
+				joint = enhancement->second;
+				break;
+			}
+		}
+
+		joint.oldName = composed.names.front();
+		joint.newName = composed.names.back();
+		jointMap[joint.oldName] = joint;
+	}
+
+	if (!mappings.empty())
+		jointPatterns.insert(jointPatterns.end(), mappings [0].patterns.begin(), mappings [0].patterns.end());
+	gJointChainTail = JointRenameTable(chain.tail);
+
+	return CompileJointRenames() ? 0 : 1;
+}
+
+// Everything a joint file sets. The server keeps one for each joint file it has read and swaps it in per job.
+struct SJointConfig
+{
+	std::map<std::string, SJointEnhancement> jointMap;
+	JointRenameTable jointRenames;
+	std::vector<SJointPattern> jointPatterns;
+	JointPatternSet compiledPatterns;
+	JointRenameTable chainTail;
+	std::string axis;
+	bool applyWeaponFix { false };
+	bool addRoot { false };
+	std::string addRootChildName;
+	std::string addRootRootName { "root" };
+	std::string removeLeafName;
+};
+
+SJointConfig CaptureJointConfig()
+{
+	SJointConfig config;
+	config.jointMap = jointMap;
+	config.jointRenames = gJointRenames;
+	config.jointPatterns = jointPatterns;
+	config.compiledPatterns = gJointPatterns;
+	config.chainTail = gJointChainTail;
+	config.axis = gAxis;
+	config.applyWeaponFix = gApplyWeaponFix;
+	config.addRoot = gAddRoot;
+	config.addRootChildName = gAddRootChildName;
+	config.addRootRootName = gAddRootRootName;
+	config.removeLeafName = gRemoveLeafName;
+
+	return config;
+}
+
+void ApplyJointConfig(const SJointConfig& config)
+{
+	jointMap = config.jointMap;
+	gJointRenames = config.jointRenames;
+	jointPatterns = config.jointPatterns;
+	gJointPatterns = config.compiledPatterns;
+	gJointChainTail = config.chainTail;
+	gAxis = config.axis;
+	gApplyWeaponFix = config.applyWeaponFix;
+	gAddRoot = config.addRoot;
+	gAddRootChildName = config.addRootChildName;
+	gAddRootRootName = config.addRootRootName;
+	gRemoveLeafName = config.removeLeafName;
+}
+
+// A parsed joint file, and the timestamp it had when read so an edit is picked up by the next job.
+struct SCachedJointConfig
+{
+	std::filesystem::file_time_type modifiedTime;
+	SJointConfig config;
+};
+
+std::string GetAbsoluteUTF8Path(const std::string& path)
+{
+	if (path.empty())
+		return path;
+
+	std::error_code error;
+	std::u8string absolutePath = std::filesystem::absolute(std::filesystem::path(path), error).u8string();
+
+	return std::string(absolutePath.begin(), absolutePath.end());
+}
+
+// Run as a resident server, converting one file per request with the manager, plugins and joint files kept loaded
+// between requests.
+bool ServeJobs(FbxManager*& pFbxManager, FbxScene*& pFbxScene, const std::string& pipeName)
+{
+	std::map<std::string, SCachedJointConfig> jointConfigs;
+	SSceneLifecycleStats sceneStats;
+
+	bool isServed = RunJobServer(pipeName, [&](const SServerJob& job, SServerJobResult& result)
+	{
+		auto stepStart = std::chrono::steady_clock::now();
+		auto finishStep = [&stepStart]()
+		{
+			auto now = std::chrono::steady_clock::now();
+			double seconds = std::chrono::duration<double>(now - stepStart).count();
+			stepStart = now;
+
+			return seconds;
+		};
+
+		// One job running out of memory on a huge scene, or otherwise throwing, fails that job rather than the server.
+		try
+		{
+			if (job.jointFilePath.empty())
+			{
+				ApplyJointConfig(SJointConfig());
+			}
+			else
+			{
+				// A chain is re-read when any of its files is edited.
+				std::filesystem::file_time_type modifiedTime;
+				for (const auto& path : SplitJointFileList(job.jointFilePath))
+				{
+					wchar_t* pWidePath = nullptr;
+					FbxUTF8ToWC(path.c_str(), pWidePath);
+					std::wstring widePath = pWidePath ? pWidePath : L"";
+					delete[] pWidePath;
+
+					std::error_code error;
+					modifiedTime = (std::max)(modifiedTime, std::filesystem::last_write_time(widePath, error));
+				}
+
+				auto cached = jointConfigs.find(job.jointFilePath);
+				if ((cached == jointConfigs.end()) || (cached->second.modifiedTime != modifiedTime))
+				{
+					char* pAnsiPath = nullptr;
+					FbxUTF8ToAnsi(job.jointFilePath.c_str(), pAnsiPath);
+					std::string ansiPath = pAnsiPath ? pAnsiPath : "";
+					delete[] pAnsiPath;
+
+					// ReadJointFile adds to whatever is set, so start from the defaults.
+					ApplyJointConfig(SJointConfig());
+					if (ReadJointFile(ansiPath) != 0)
+					{
+						jointConfigs.erase(job.jointFilePath);
+						result.error = "Joint file was mal-formed.";
+						return;
+					}
+
+					cached = jointConfigs.insert_or_assign(job.jointFilePath, SCachedJointConfig { modifiedTime, CaptureJointConfig() }).first;
+				}
+
+				ApplyJointConfig(cached->second.config);
+			}
+
+			gScale = job.scale;
+			applyMixamoFixes = job.applyMixamoFixes;
+			addIK = job.addIK;
+			ApplyImportProfile();
+			result.configSeconds = finishStep();
+
+			FbxString fbxInFilePath(job.inputPath.c_str());
+			if (!LoadInputScene(pFbxManager, pFbxScene, fbxInFilePath))
+				result.error = "Unable to load the input file.";
+			result.loadSeconds = finishStep();
+
+			if (result.error.empty() && !TransformScene(pFbxManager, pFbxScene, fbxInFilePath))
+				result.error = "Unable to transform the scene.";
+			result.transformSeconds = finishStep();
+
+			if (result.error.empty() && !SaveOutputScene(pFbxManager, pFbxScene, FbxString(job.outputPath.c_str())))
+				result.error = "Unable to save the output file.";
+			result.saveSeconds = finishStep();
+		}
+		catch (const std::exception& exception)
+		{
+			result.error = std::string("The job failed: ") + exception.what();
+		}
+		catch (...)
+		{
+			result.error = "The job failed with an unknown exception.";
+		}
+
+		result.succeeded = result.error.empty();
+		ResetScene(pFbxManager, pFbxScene, sceneStats);
+	});
+
+	DisplaySceneLifecycleStats(sceneStats);
+	return isServed;
+}
+
+
+// The rig --rename-benchmark looks up, and the joint file it uses unless -j gives another, found in the working
+// directory as in the examples.
+const int benchmarkRigBoneCount = 500;
+const char* benchmarkJointFilePath = "mixamo-to-autodesk.json";
+
+// The meshes --inflate-benchmark makes when it isn't given a file, across the sizes pooled inflation is meant for.
+const int inflateBenchmarkVertexCounts [] = { 100000, 500000, 1000000, 2000000 };
+
+// Save a grid mesh of each size to a temporary binary file with its arrays compressed, and time inflating its arrays
+// as for a file given with -i. The files are deleted afterwards.
+bool BenchmarkGeneratedMeshes(FbxManager* pFbxManager, int threadCount, int runs)
+{
+	SExportSettings exportSettings = gExportSettings;
+	gExportSettings.isBinary = true;
+	gExportSettings.isCompressingArrays = true;
+
+	bool succeeded = true;
+	for (int vertexCount : inflateBenchmarkVertexCounts)
+	{
+		int side = static_cast<int>(ceil(sqrt(static_cast<double>(vertexCount))));
+		std::filesystem::path meshPath = std::filesystem::temp_directory_path() / ("fbxtool-inflate-" + std::to_string(vertexCount) + ".fbx");
+
+		FbxScene* pMeshScene = FbxScene::Create(pFbxManager, "InflateBenchmark");
+		CreateGrid(pMeshScene, "Grid", side);
+		bool isSaved = SaveScene(pFbxManager, pMeshScene, WStr2FbxStr(meshPath.wstring()).Buffer());
+		pMeshScene->Destroy(true);
+
+		if (!isSaved)
+		{
+			std::cerr << "Error: Unable to save the " << vertexCount << " vertex mesh for the inflation benchmark." << std::endl;
+			succeeded = false;
+			break;
+		}
+
+		FBXSDK_printf("\nGrid mesh of %d vertices and %d quads, compressed at level %d", side * side, (side - 1) * (side - 1),
+			gExportSettings.compressionLevel);
+		succeeded = BenchmarkArrayInflation(meshPath.wstring(), threadCount, runs) && succeeded;
+
+		std::error_code error;
+		std::filesystem::remove(meshPath, error);
+	}
+
+	gExportSettings = exportSettings;
+	return succeeded;
+}
+
+int main(int argc, char** argv)
+{
+	BeginStartupProfile();
+	SetConsoleOutputCP(CP_UTF8);
+
+	bool isLoadingPluginsEagerly { false };
+	bool isInspecting { false };
+	bool isReadingRecords { false };
+	int importBenchmarkRuns { 0 };
+	int inflateBenchmarkRuns { 0 };
+	int renameBenchmarkRuns { 0 };
+	std::string keptSceneElements;
+	std::string exportFormat;
+	std::string fileVersion;
+	int compressionLevel { 1 };
+	bool isSavingDirectly { false };
+	bool isAlwaysLoading { false };
+	std::string syncPolicy;
+	std::string mediaStorePath;
+	std::string jointCachePath;
+	bool didEverythingSucceed { true };
+	bool isBulk { false };
+	SBulkOptions bulkOptions;
+	bool isJobCountGiven { false };
+	std::string pipelineWidths;
+	int queueDepth { 2 };
+	std::string sceneResetMode;
+	int maxResidentMB { 0 };
+	std::string shard;
+	std::string shardBy;
+	int mergeShardCount { 0 };
+	bool isServer { false };
+	bool isSubmit { false };
+	bool isStopServer { false };
+	std::string pipeName { "fbxtool" };
+	std::string inFilePath;
+	std::string outFilePath;
+	std::string jointMetaFilePath;
+
+	int width = 0;
+	std::string name;
+	bool doIt = false;
+	std::string command;
+
+	auto cli =
+		Opt(inFilePath, "input path")
+		["-i"] ["--input-files"]
+		("path to the input file(s)")
+		| Opt(outFilePath, "output path")
+		["-o"] ["--output-files"]
+		("path for the output file(s)")
+		| Opt(isBulk) ["-b"] ["--bulk"]
+		("Bulk process more than one file?")
+		| Opt([&](int workers) { bulkOptions.jobCount = workers; isJobCountGiven = true; }, "workers")
+		["--jobs"]("Number of parallel workers for bulk processing, 0 for one per core")
+		| Opt(pipelineWidths, "load,transform,save")
+		["--pipeline"]("Bulk process as a load, transform, save pipeline with this many workers per stage")
+		| Opt(queueDepth, "files")
+		["--queue-depth"]("Number of files allowed to wait between pipeline stages")
+		| Opt(sceneResetMode, "recycle|recreate")
+		["--scene-reset"]("How bulk workers empty their scene between files")
+		| Opt(maxResidentMB, "megabytes")
+		["--max-resident-mb"]("Rebuild the FBX manager when resident memory goes over this")
+		| Opt(bulkOptions.isFullRebuild)
+		["--full"]("Process every file, even those the bulk manifest says are up to date")
+		| Opt(bulkOptions.isResuming)
+		["--resume"]("Continue an interrupted bulk run from its journal")
+		| Opt(gQuarantineCrashCount, "crashes")
+		["--quarantine-after"]("Skip files that have crashed a resumed bulk run this many times")
+		| Opt(bulkOptions.fileListPath, "list file")
+		["--file-list"]("Bulk process the files named in this list, one per line, instead of scanning the input path; - reads stdin")
+		| Opt(bulkOptions.scanThreadCount, "threads")
+		["--scan-threads"]("Number of directories listed at once while scanning the input path")
+		| Opt(shard, "K/N")
+		["--shard"]("Bulk process only the Kth of N deterministic slices of the input")
+		| Opt(shardBy, "hash|size")
+		["--shard-by"]("Slice the input by path hash, or into bins of equal total size")
+		| Opt(mergeShardCount, "shards")
+		["--merge-shards"]("Merge the manifests of a bulk run split into this many shards, and report on it")
+		| Opt(isInspecting)
+		["--inspect"]("Print each file's version, animation stacks and creator as JSON lines, without loading the scenes")
+		| Opt(isReadingRecords)
+		["--read-records"]("Print a binary FBX file's meta-data, animation stacks and skeleton from its records, without the FBX SDK")
+		| Opt(isServer)
+		["--serve"]("Stay resident and convert files sent over a named pipe by --submit")
+		| Opt(isSubmit)
+		["--submit"]("Send this conversion to a resident server instead of running it here")
+		| Opt(isStopServer)
+		["--stop-server"]("Ask a resident server to exit")
+		| Opt(pipeName, "name")
+		["--pipe"]("Name of the pipe used by --serve, --submit and --stop-server")
+		| Opt(gIsImportSelective)
+		["--selective-import"]("Only import the scene elements the requested operations need; the rest are left out of the output")
+		| Opt(keptSceneElements, "elements")
+		["--import-keep"]("Scene elements to import anyway with --selective-import, e.g. materials,textures,links,shapes")
+		| Opt(gIsComparingImport)
+		["--import-compare"]("Also time a full import of each file, to show what --selective-import saves")
+		| Opt(gIsMappingInput)
+		["--map-input"]("Read FBX files through a memory mapped view rather than letting the FBX SDK read them")
+		| Opt(inflateBenchmarkRuns, "runs")
+		["--inflate-benchmark"]("Time inflating a binary FBX file's arrays on one thread and on --jobs threads (one per core by default), or without -i, those of generated meshes of 100k to 2M vertices")
+		| Opt(renameBenchmarkRuns, "runs")
+		["--rename-benchmark"]("Time looking up the joint file's renames, mixamo-to-autodesk.json unless -j says otherwise, for a 500 bone rig, by map and by compiled table")
+		| Opt(importBenchmarkRuns, "runs")
+		["--import-benchmark"]("Time importing the input file by name, mapped and from memory, instead of processing it")
+		| Opt(exportFormat, "binary|ascii")
+		["--format"]("Write binary FBX files, the default, or ASCII ones")
+		| Opt(fileVersion, "version")
+		["--fbx-version"]("FBX file version to write, e.g. 2014, 7.4 or FBX201400")
+		| Opt([&](int level) { compressionLevel = level; gIsCompressionGiven = true; }, "level")
+		["--compress-arrays"]("zlib level from 1 to 9 for large arrays in binary files, 0 to turn compression off")
+		| Opt([&](int bytes) { gExportSettings.compressionMinSize = bytes; gIsCompressionGiven = true; }, "bytes")
+		["--compress-min-size"]("Only compress arrays of at least this many bytes")
+		| Opt(isAlwaysLoading)
+		["--always-load"]("Load and save every file with the FBX SDK, even when renaming the animation and joints is all there is to do")
+		| Opt(gIsComparingPatch)
+		["--patch-compare"]("Check each patched file against what loading and saving it with the FBX SDK would give")
+		| Opt(gIsReportingDuplicateNames)
+		["--report-duplicate-names"]("List node names held by more than one node, where lookups by name only find the first")
+		| Opt(isSavingDirectly)
+		["--direct-save"]("Let the FBX SDK write straight to the output path, rather than publishing complete files by renaming them into place")
+		| Opt(syncPolicy, "none|data|full")
+		["--fsync"]("Force each published file, or the file and its rename, to disk before moving on")
+		| Opt(mediaStorePath, "directory")
+		["--media-store"]("Extract embedded media into this directory, one file per distinct content, and link the output to it")
+		| Opt(jointCachePath, "directory|none")
+		["--joint-cache"]("Where validated JSON joint files are cached, so later runs skip parsing them; the temporary folder by default")
+		| Opt(isLoadingPluginsEagerly)
+		["--load-plugins"]("Load every plugin at start-up rather than when a file first needs one")
+		| Opt(gIsProfilingStartup)
+		["--startup-profile"]("Show where the time goes before the first file is processed")
+		| Opt(isVerbose)
+		["-v"] ["--verbose"]("Output verbose information")
+		| Opt(jointMetaFilePath, "Joint meta file")
+		["-j"] ["--joints"]("Joint file, or a comma separated chain of them applied in order, in JSON or old=new text")
+		| Opt(addIK)
+		["-k"] ["--add-ik"]("Add standard IK bones to the model")
+		| Opt(applyMixamoFixes)
+		["-f"] ["--fixamo"]("Apply fixes to Mixamo model")
+		| Opt(gScale, "uniform scale")
+		["--scale"]("Apply uniform scale");
+
+	auto result = cli.parse(Args(argc, argv));
+	if (!result) {
+		std::cerr << "Error in command line: " << result.errorMessage() << std::endl;
+		cli.writeToStream(std::cout);
+		exit(1);
+	}
+
+	if (exportFormat == "ascii")
+		gExportSettings.isBinary = false;
+	else if (exportFormat.length() > 0 && exportFormat != "binary")
+	{
+		std::cerr << "Error: --format must be binary or ascii." << std::endl;
+		cli.writeToStream(std::cout);
+		exit(1);
+	}
+
+	if (fileVersion.length() > 0 && !ParseFbxFileVersion(fileVersion, gExportSettings.fileVersion))
+	{
+		std::cerr << "Error: --fbx-version expects a version such as 2014, 7.4 or FBX201400." << std::endl;
+		cli.writeToStream(std::cout);
+		exit(1);
+	}
+
+	if (compressionLevel < 0 || compressionLevel > 9)
+	{
+		std::cerr << "Error: --compress-arrays expects a level from 0 to 9." << std::endl;
+		cli.writeToStream(std::cout);
+		exit(1);
+	}
+	if (keptSceneElements.length() > 0 && !ParseSceneElements(keptSceneElements, gKeptSceneElements))
+	{
+		std::cerr << "Error: --import-keep expects a list of materials, textures, links, shapes, gobos, animation or global-settings." << std::endl;
+		cli.writeToStream(std::cout);
+		exit(1);
+	}
+
+	if (syncPolicy == "data")
+		gExportSettings.syncPolicy = eFileSyncData;
+	else if (syncPolicy == "full")
+		gExportSettings.syncPolicy = eFileSyncFull;
+	else if (syncPolicy.length() > 0 && syncPolicy != "none")
+	{
+		std::cerr << "Error: --fsync must be none, data or full." << std::endl;
+		cli.writeToStream(std::cout);
+		exit(1);
+	}
+
+	gExportSettings.isCompressingArrays = (compressionLevel > 0);
+	gExportSettings.isPublishingAtomically = !isSavingDirectly;
+	gIsPatchingBinary = !isAlwaysLoading;
+
+	if (mediaStorePath.length() > 0)
+	{
+		wchar_t* pMediaStorePath = nullptr;
+		FbxAnsiToWC(mediaStorePath.c_str(), pMediaStorePath);
+		gMediaStore = std::make_unique<MediaStore>(std::filesystem::absolute(pMediaStorePath).wstring(), gExportSettings.syncPolicy);
+		delete[] pMediaStorePath;
+
+		gIsExtractingEmbeddedMedia = false;
+	}
+	gExportSettings.compressionLevel = (std::max)(compressionLevel, 1);
+
+	if (jointCachePath.empty())
+	{
+		gJointCachePath = GetDefaultJointCacheDirectory();
+	}
+	else if (jointCachePath != "none")
+	{
+		wchar_t* pJointCachePath = nullptr;
+		FbxAnsiToWC(jointCachePath.c_str(), pJointCachePath);
+		gJointCachePath = pJointCachePath ? pJointCachePath : L"";
+		delete[] pJointCachePath;
+	}
+
+	gIsLoadingPluginsLazily = !isLoadingPluginsEagerly;
+	MarkStartupPhase("Parse command line");
+
+	// Clients never touch the FBX SDK, which is the point: the server has it loaded already.
+	if (isSubmit || isStopServer)
+	{
+		SServerJob job;
+		job.isShutdown = isStopServer;
+		job.inputPath = GetAbsoluteUTF8Path(inFilePath);
+		job.outputPath = GetAbsoluteUTF8Path(outFilePath);
+		for (const auto& path : SplitJointFileList(jointMetaFilePath))
+			job.jointFilePath += (job.jointFilePath.empty() ? "" : ",") + GetAbsoluteUTF8Path(path);
+		job.scale = gScale;
+		job.applyMixamoFixes = applyMixamoFixes;
+		job.addIK = addIK;
+
+		EndStartupProfile();
+
+		SServerJobResult jobResult;
+		if (!SendServerJob(pipeName, job, jobResult))
+		{
+			std::cerr << "Error: Unable to reach a server on the pipe " << pipeName << "." << std::endl;
+			return 1;
+		}
+
+		if (!isStopServer)
+			DisplayServerJobResult(jobResult);
+
+		return jobResult.succeeded ? 0 : 1;
+	}
+
+	if (sceneResetMode == "recreate")
+		gSceneResetMode = eSceneRecreate;
+	else if (sceneResetMode.length() > 0 && sceneResetMode != "recycle")
+	{
+		std::cerr << "Error: --scene-reset must be recycle or recreate." << std::endl;
+		cli.writeToStream(std::cout);
+		exit(1);
+	}
+	gMaxResidentBytes = static_cast<size_t>((std::max)(maxResidentMB, 0)) << 20;
+
+	if (isInspecting)
+	{
+		EndStartupProfile();
+
+		wchar_t* pInputPath = nullptr;
+		FbxAnsiToWC(inFilePath.empty() ? "." : inFilePath.c_str(), pInputPath);
+		std::wstring inputPath = pInputPath ? pInputPath : L".";
+		delete[] pInputPath;
+
+		return InspectPath(inputPath, bulkOptions) ? 0 : 1;
+	}
+
+	if (isReadingRecords)
+	{
+		EndStartupProfile();
+
+		wchar_t* pInputPath = nullptr;
+		FbxAnsiToWC(inFilePath.c_str(), pInputPath);
+		std::wstring inputPath = pInputPath ? pInputPath : L"";
+		delete[] pInputPath;
+
+		return DisplayBinaryFbxFile(inputPath) ? 0 : 1;
+	}
+
+	// The pooled inflation is compared against one thread, so unlike bulk runs it uses every core unless told otherwise.
+	int inflateThreadCount = isJobCountGiven ? bulkOptions.jobCount : 0;
+
+	if ((inflateBenchmarkRuns > 0) && (inFilePath.length() > 0))
+	{
+		EndStartupProfile();
+
+		wchar_t* pInputPath = nullptr;
+		FbxAnsiToWC(inFilePath.c_str(), pInputPath);
+		std::wstring inputPath = pInputPath ? pInputPath : L"";
+		delete[] pInputPath;
+
+		return BenchmarkArrayInflation(inputPath, inflateThreadCount, inflateBenchmarkRuns) ? 0 : 1;
+	}
+
+	if (renameBenchmarkRuns > 0)
+	{
+		EndStartupProfile();
+
+		if (jointMetaFilePath.empty())
+			jointMetaFilePath = benchmarkJointFilePath;
+
+		if (ReadJointFile(jointMetaFilePath) != 0)
+		{
+			std::cerr << "Error: --rename-benchmark needs a joint file, " << benchmarkJointFilePath << " by default, or one given with -j." << std::endl;
+			return 1;
+		}
+
+		std::vector<std::pair<std::string, std::string>> renames;
+		for (const auto& joint : jointMap)
+			renames.emplace_back(joint.first, joint.second.newName);
+
+		BenchmarkJointRenames(renames, benchmarkRigBoneCount, renameBenchmarkRuns);
+		return 0;
+	}
+
+	FbxString fbxInFilePath = StdStr2FbxStr(inFilePath);
+	FbxManager* pFbxManager = nullptr;
+	FbxScene* pFbxScene = nullptr;
+
+	// Prepare the FBX SDK.
+	InitializeSdkObjects(pFbxManager, pFbxScene);
+	FBXSDK_printf("\n");
+
+	if (isServer)
+	{
+		EndStartupProfile();
+		didEverythingSucceed = ServeJobs(pFbxManager, pFbxScene, pipeName);
+		DestroySdkObjects(pFbxManager, didEverythingSucceed);
+
+		return didEverythingSucceed ? 0 : 1;
+	}
+
+	// Without an input file, the inflation benchmark makes its own meshes, which needs the FBX SDK.
+	if (inflateBenchmarkRuns > 0)
+	{
+		EndStartupProfile();
+		didEverythingSucceed = BenchmarkGeneratedMeshes(pFbxManager, inflateThreadCount, inflateBenchmarkRuns);
+		DestroySdkObjects(pFbxManager, didEverythingSucceed);
+
+		return didEverythingSucceed ? 0 : 1;
+	}
+
+	if (jointMetaFilePath.length() > 0)
+	{
+		if (int error = ReadJointFile(jointMetaFilePath) != 0)
+		{
+			std::cerr << "Joint file was mal-formed." << std::endl;
+			exit(error);
+		}
+	}
+	ApplyImportProfile();
+	if (gIsImportSelective)
+		FBXSDK_printf("Selective import of %s.\n", DescribeSceneElements(gSceneElements, true).c_str());
+	MarkStartupPhase("Read joint file");
+	EndStartupProfile();
+
+	if (!isBulk)
+	{
+		// Default output is to the same file as the input.
+		FbxString fbxOutFilePath;
+		if (outFilePath.length() > 0)
+			fbxOutFilePath = StdStr2FbxStr(outFilePath);
+		else
+			fbxOutFilePath = fbxInFilePath;
+
+		// There's only one file to process.
+		if (importBenchmarkRuns > 0)
+			didEverythingSucceed = BenchmarkImport(pFbxManager, fbxInFilePath, importBenchmarkRuns);
+		else
+			didEverythingSucceed = didEverythingSucceed && ProcessFile(pFbxManager, pFbxScene, fbxInFilePath, fbxOutFilePath);
+	}
+	else
+	{
+		bool bAbort = false;
+		if (outFilePath.length() == 0)
+		{
+			std::cerr << "Error: You must supply an output path for bulk conversions." << std::endl;
+			cli.writeToStream(std::cout);
+			exit(1);
+		}
+
+		// Default to using the present directory if no file path was supplied.
+		TCHAR* tmpInputPath = nullptr;
+		size_t pReturnValue;
+		if (fbxInFilePath.IsEmpty())
+			FbxAnsiToWC(".", tmpInputPath, &pReturnValue);
+		else
+			FbxAnsiToWC(inFilePath.c_str(), tmpInputPath, &pReturnValue);
+
+		std::wstring inputRootPath = tmpInputPath;
+        TCHAR* tmpOutputPath = nullptr;
+        FbxAnsiToWC(outFilePath.c_str(), tmpOutputPath);
+        std::wstring outputRootPath = tmpOutputPath;
+        delete[] tmpOutputPath;
+		delete[] tmpInputPath;
+
+		if (pipelineWidths.length() > 0)
+		{
+			bulkOptions.isPipelined = true;
+			if (!ParsePipelineWidths(pipelineWidths, bulkOptions.pipelineWidths) || queueDepth < 1)
+			{
+				std::cerr << "Error: --pipeline expects three worker counts, e.g. 2,4,2." << std::endl;
+				cli.writeToStream(std::cout);
+				exit(1);
+			}
+			bulkOptions.pipelineWidths.queueDepth = queueDepth;
+		}
+
+		if (bulkOptions.scanThreadCount < 1)
+			bulkOptions.scanThreadCount = 1;
+
+		if (shard.length() > 0 && !ParseShard(shard, bulkOptions.shard))
+		{
+			std::cerr << "Error: --shard expects a shard number and count, e.g. 2/4." << std::endl;
+			cli.writeToStream(std::cout);
+			exit(1);
+		}
+
+		if (shardBy == "size")
+			bulkOptions.shard.isBySize = true;
+		else if (shardBy.length() > 0 && shardBy != "hash")
+		{
+			std::cerr << "Error: --shard-by must be hash or size." << std::endl;
+			cli.writeToStream(std::cout);
+			exit(1);
+		}
+
+		if (mergeShardCount > 0)
+		{
+			didEverythingSucceed = didEverythingSucceed && MergeShardManifests(pFbxManager, inputRootPath, outputRootPath, mergeShardCount);
+		}
+		else
+		{
+			SBulkResult bulkResult;
+			ProcessDirectory(pFbxManager, pFbxScene, inputRootPath, outputRootPath, bulkOptions, bulkResult);
+			didEverythingSucceed = didEverythingSucceed && (bulkResult.failed == 0) && (bulkResult.quarantined == 0);
+		}
+	}
+
+	if (gMediaStore)
+		ReportMediaStore();
+
+	// Destroy all objects created by the FBX SDK.
+	FBXSDK_printf("\n");
+	DestroySdkObjects(pFbxManager, didEverythingSucceed);
+
+	return didEverythingSucceed ? 0 : 1;
 }
@@ -1,2 +1,4 @@
 #pragma once
 
+// Bump when a change alters the files the tool writes, so bulk manifests know to reprocess everything.
+#define FBXTOOL_VERSION "1.2.0"
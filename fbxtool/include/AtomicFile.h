@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+// How hard a published file is pushed to disk before it replaces the old one.
+enum EFileSyncPolicy
+{
+	// Leave it to the OS. A crash can't leave a truncated file, but a power cut may lose the newest files.
+	eFileSyncNone,
+
+	// Force the file's contents to disk before it is renamed into place.
+	eFileSyncData,
+
+	// Also wait for the rename itself to reach the disk.
+	eFileSyncFull
+};
+
+
+// A name for a temporary file beside the path, so it can be renamed over the path without crossing volumes.
+std::wstring GetTemporaryPath(const std::wstring& path);
+
+
+/**
+Rename a finished temporary file over the path in a single step, so readers see either the old file or the whole new
+one. The temporary file is deleted if it can't be renamed.
+
+\param 		   	temporaryPath	The finished file, normally from GetTemporaryPath.
+\param 		   	path		 	Where the file is published.
+\param 		   	syncPolicy   	How much to sync before returning.
+\return	False if the file couldn't be synced or renamed.
+**/
+bool CommitTemporaryFile(const std::wstring& temporaryPath, const std::wstring& path, EFileSyncPolicy syncPolicy);
+
+
+// Write the data to a temporary file with one large write, then commit it over the path.
+bool PublishFile(const std::wstring& path, const void* pData, size_t size, EFileSyncPolicy syncPolicy);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// One array property of a binary FBX file, with its elements inflated.
+struct SBinaryFbxArray
+{
+	// The record holding the array, e.g. Vertices, PolygonVertexIndex or KeyValueFloat.
+	std::string recordName;
+
+	// f, d, l, i or b, as in SBinaryFbxProperty.
+	char type { 0 };
+	uint32_t arrayLength { 0 };
+	bool isCompressed { false };
+
+	// Where the stored elements start in the file, and how many bytes they take there.
+	uint64_t dataOffset { 0 };
+	uint32_t storedSize { 0 };
+
+	// arrayLength elements, as little endian values of the type.
+	std::vector<char> elements;
+};
+
+
+struct SBinaryFbxArrayStats
+{
+	size_t arrayCount { 0 };
+	size_t compressedCount { 0 };
+	uint64_t storedBytes { 0 };
+	uint64_t inflatedBytes { 0 };
+
+	int threadCount { 0 };
+	double findSeconds { 0.0 };
+	double inflateSeconds { 0.0 };
+};
+
+
+/**
+Read every array of a binary FBX file, such as vertices, indices, weights and animation keys, without the FBX SDK.
+The records are walked once to find the arrays and the size of each one inflated, then the arrays are inflated across
+a pool of threads, largest first, each straight into a buffer of its final size. Only the inflation benchmark calls
+this; conversions load files with the FBX SDK, which inflates the arrays itself.
+
+\param 		   	fileBytes  	The whole file, already in memory.
+\param 		   	threadCount	Threads to inflate with, 0 for one per core.
+\param [out]	arrays	   	The arrays in the order they are stored.
+\param [out]	stats	   	How much was read and inflated, and how long it took.
+\param [out]	error	   	Why the file couldn't be read.
+**/
+bool ReadBinaryFbxArrays(const std::vector<char>& fileBytes, int threadCount, std::vector<SBinaryFbxArray>& arrays,
+	SBinaryFbxArrayStats& stats, std::string& error);
+
+
+// Time reading a file's arrays on one thread and on threadCount, runs times each, and check both give the same data.
+bool BenchmarkArrayInflation(const std::wstring& path, int threadCount, int runs);
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+
+// Print a binary FBX file's meta-data, creator, animation stacks and skeleton in the same layout as DisplayMetaData,
+// straight from its records and without the FBX SDK. Returns false, after saying why, if the file can't be read.
+bool DisplayBinaryFbxFile(const std::wstring& path);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "AtomicFile.h"
+
+
+enum EBinaryPatchResult
+{
+	eBinaryPatchApplied,
+
+	// The file can't be patched safely, e.g. it is ASCII or has no animation stack. Nothing was written, and the
+	// file should go through the FBX SDK instead.
+	eBinaryPatchUnsupported,
+
+	// The file looked patchable but couldn't be read or written.
+	eBinaryPatchFailed
+};
+
+
+// What to change in the file.
+struct SBinaryPatchRequest
+{
+	// The first animation stack's new name.
+	std::string animationName;
+
+	// Gives the new name for a skeleton node from its name in the file, or returns false to leave it be. Other
+	// nodes, and the skeleton node attributes, keep their names, as they do when the scene is loaded and renamed.
+	std::function<bool(const std::string& name, std::string& newName)> renameSkeleton;
+
+	// Renamed skeleton nodes that end up with one of these names have the X and Z of their translation zeroed.
+	std::set<std::string> centredNames;
+};
+
+
+// What patching found out about the file.
+struct SBinaryPatchInfo
+{
+	// The first animation stack's name before patching.
+	std::string oldName;
+
+	int renamedNodeCount { 0 };
+
+	// The skeleton nodes, so a bulk run can record them without loading the scene.
+	std::vector<std::string> skeletonNames;
+
+	// The input's ContentHash, taken as it was copied, so a bulk run needn't read the file again to record it.
+	bool hasContentHash { false };
+	uint64_t contentHash { 0 };
+
+	// Why the file couldn't be patched.
+	std::string reason;
+};
+
+
+/**
+Rename the first animation stack and any skeleton nodes of a binary FBX file without loading it, by rewriting just the
+records that carry the names: the stack itself, its take, the document's active stack and the skeleton's Model
+records. FBX 7 files connect objects by ID, so a node's name is stored nowhere else. Everything else is copied through
+unchanged, with the end offsets of the records around each change adjusted for the new lengths. The output is
+published through a temporary file, so the input and output may be the same file.
+
+\param 		   	inputPath 	The binary FBX file to read.
+\param 		   	outputPath	Where the patched file goes.
+\param 		   	request   	The new names.
+\param 		   	syncPolicy	How the output is pushed to disk.
+\param [out]	info	  	The old names and skeleton, or the reason the file was left alone.
+**/
+EBinaryPatchResult PatchBinaryFbxNames(const std::wstring& inputPath, const std::wstring& outputPath,
+	const SBinaryPatchRequest& request, EFileSyncPolicy syncPolicy, SBinaryPatchInfo& info);
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+
+// The magic string and version that start every binary FBX file, before the first record.
+const size_t binaryFbxHeaderSize = 27;
+
+
+// One property of a binary FBX record. Only the members that suit the type are set.
+struct SBinaryFbxProperty
+{
+	// Y, C, I and L are integers, F and D numbers, S and R strings and raw data, and f, d, l, i and b arrays.
+	char type { 0 };
+
+	int64_t integer { 0 };
+	double number { 0.0 };
+
+	// The bytes of a string or raw data, or an array's elements as stored. They point into the reader's buffer, so
+	// they are only valid until the visitor returns.
+	const char* pData { nullptr };
+	size_t size { 0 };
+
+	// Arrays only. An encoding of 1 means the elements are zlib compressed.
+	uint32_t arrayLength { 0 };
+	uint32_t encoding { 0 };
+
+	// Where the property starts in the file, at its type code.
+	uint64_t offset { 0 };
+
+	bool IsArray() const;
+	std::string GetString() const;
+
+	// Object names are stored with their class as "name\x00\x01class". This is the name alone.
+	std::string GetObjectName() const;
+};
+
+
+struct SBinaryFbxRecord
+{
+	std::string name;
+
+	// Zero for the top level records, such as Objects and Connections.
+	int depth { 0 };
+
+	// Where the record starts and ends in the file. The end includes the record's children.
+	uint64_t offset { 0 };
+	uint64_t endOffset { 0 };
+
+	std::vector<SBinaryFbxProperty> properties;
+};
+
+
+// Receives the records of a binary FBX file in the order they are stored, parents before their children.
+class BinaryFbxVisitor
+{
+public:
+	virtual ~BinaryFbxVisitor() {}
+
+	// Called with a record and its properties, before its children. Return false to skip the children.
+	virtual bool BeginRecord(const SBinaryFbxRecord& record) = 0;
+
+	// Called once the record's children have been visited or skipped. The properties are gone by then.
+	virtual void EndRecord(const std::string& /*name*/, int /*depth*/) {}
+};
+
+
+/**
+Walks the node records of a binary FBX file without the FBX SDK. The file is read front to back, and only the record
+being visited has its properties in memory, so the memory needed is set by the largest record, not the file.
+Arrays are handed over as stored; nothing is decompressed. ASCII FBX files aren't supported.
+**/
+class BinaryFbxReader
+{
+public:
+	explicit BinaryFbxReader(std::istream& stream);
+
+	// Read the header and visit every record. False if the file isn't binary FBX or is damaged; see GetError.
+	bool Read(BinaryFbxVisitor& visitor);
+
+	// The file version, e.g. 7400 for FBX 2014. Set once the header has been read.
+	uint32_t GetVersion() const { return mVersion; }
+
+	const std::string& GetError() const { return mError; }
+
+private:
+	bool ReadHeader();
+	bool ReadRecordList(BinaryFbxVisitor& visitor, int depth, uint64_t listEnd);
+	bool ParseProperties(SBinaryFbxRecord& record, uint64_t propertyCount, uint64_t payloadOffset);
+	bool ReadBytes(void* pData, size_t size);
+	bool SkipTo(uint64_t offset);
+	bool Fail(const std::string& message);
+
+	std::istream& mStream;
+	uint32_t mVersion { 0 };
+
+	// The offset into the file, counted as it is read, so streams that can't tell their position still work.
+	uint64_t mPosition { 0 };
+
+	// Holds the properties of the record being visited, reused from one record to the next.
+	std::vector<char> mPayload;
+
+	std::string mError;
+};
+
+
+// Read a binary FBX file, from a path in the form the rest of the tool uses.
+bool ReadBinaryFbxFile(const std::wstring& path, BinaryFbxVisitor& visitor, std::string& error);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <string>
+
+#include "BulkProcessing.h"
+
+
+// Called for each input file found, from whichever scanning thread found it.
+typedef std::function<void(const SBulkFile& file)> BulkFileVisitor;
+
+
+/**
+Find every FBX file under the input root. Directories are listed by several threads at once, so on a network share
+the round trips overlap rather than queueing one directory at a time. Files are passed to the visitor as soon as they
+are found, with their size filled in from the directory listing. Returns once the whole tree has been listed.
+
+\param 		   	inputRootPath 	The folder to scan.
+\param 		   	outputRootPath	Output paths mirror the input tree under this folder.
+\param 		   	threadCount   	Number of directories listed at once.
+\param 		   	visitor		  	Called once per file, from any scanning thread.
+**/
+void EnumerateBulkDirectory(const std::wstring& inputRootPath, const std::wstring& outputRootPath, int threadCount,
+	BulkFileVisitor visitor);
+
+
+/**
+Read the input files from a list, one UTF-8 path per line, instead of scanning for them. Paths may be relative to the
+input root or absolute paths inside it; a path is inside the root when its leading components match the root's,
+ignoring case, and nothing after them climbs back out with "..". Blank lines are ignored.
+
+\return	The number of lines naming a file that is missing or outside the input root.
+**/
+size_t ReadBulkFileList(std::istream& listStream, const std::wstring& inputRootPath, const std::wstring& outputRootPath,
+	BulkFileVisitor visitor);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BulkProcessing.h"
+
+
+// What the journal knows about one file from earlier attempts at the run.
+struct SJournalState
+{
+	bool isCompleted { false };
+	bool isFailed { false };
+
+	// Times the file was started but never finished, i.e. it was in flight when the process died.
+	int crashes { 0 };
+};
+
+
+/**
+An append-only record of which bulk files have been started, completed or failed. Every record reaches the OS as
+soon as it is written, so a crash inside the FBX SDK leaves the file that caused it marked as started; the journal is
+only forced to disk every few records, which covers power loss without paying for a sync per file. Each shard of a
+sharded run keeps its own journal, named with the shard tag, as the nodes share one output root.
+**/
+class BulkJournal
+{
+public:
+	BulkJournal(const std::wstring& inputRootPath, const std::wstring& outputRootPath, const std::wstring& shardTag = std::wstring());
+	~BulkJournal();
+
+	// Read the existing journal and keep appending to it. Without a resume the journal starts empty.
+	bool Open(bool isResuming);
+	void Close();
+
+	// True if an earlier attempt completed the file.
+	bool IsCompleted(const SBulkFile& file) const;
+
+	// True if the file has crashed the process often enough that it should no longer be attempted.
+	bool IsQuarantined(const SBulkFile& file) const;
+
+	// True if the file was in flight during an earlier crash, but not often enough to be quarantined.
+	bool IsSuspect(const SBulkFile& file) const;
+
+	void Started(const SBulkFile& file);
+	void Finished(const SBulkFile& file, bool succeeded);
+
+	std::wstring GetJournalPath() const;
+
+private:
+	SJournalState GetState(const SBulkFile& file) const;
+	void Append(char event, const std::string& relativePath);
+
+	std::wstring mInputRootPath;
+	std::wstring mOutputRootPath;
+	std::wstring mShardTag;
+	std::map<std::string, SJournalState> mStates;
+
+	std::mutex mMutex;
+	void* mFileHandle { nullptr };
+	int mUnsyncedRecords { 0 };
+};
+
+
+// A file that has crashed the process this many times is skipped by later resumes.
+extern int gQuarantineCrashCount;
+
+
+// Write the quarantined files to a list beside the journal and print them.
+void ReportQuarantinedFiles(const std::wstring& outputRootPath, const std::vector<SBulkFile>& files,
+	const std::wstring& inputRootPath, const std::wstring& shardTag = std::wstring());
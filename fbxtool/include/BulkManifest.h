@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "BulkProcessing.h"
+
+
+// The settings that decide what a bulk run writes. Joint rules are hashed one by one so a change to a single rule
+// only invalidates the files whose skeletons contain that joint.
+struct SManifestConfig
+{
+	std::string toolVersion;
+
+	// Everything except the joint rules: axis, scale, flags and so on.
+	uint64_t optionsHash { 0 };
+
+	// Joint rules keyed by the name they match.
+	std::map<std::string, uint64_t> ruleHashes;
+};
+
+
+// What the manifest remembers about one input file.
+struct SManifestEntry
+{
+	uintmax_t size { 0 };
+	int64_t modifiedTime { 0 };
+	uint64_t contentHash { 0 };
+
+	// Skeleton node names as loaded, before any renaming. Files sharing a rig share the set.
+	std::shared_ptr<const std::set<std::string>> pSkeletonNames;
+};
+
+
+/**
+Tracks which files in the output tree are up to date, so a bulk run can skip them without loading them. The
+manifest lives in the output root and is rewritten at the end of each run. A sharded run writes its own manifest,
+named with the shard tag, and the shards are merged back into the main manifest once every node has finished.
+**/
+class BulkManifest
+{
+public:
+	BulkManifest(const std::wstring& inputRootPath, const std::wstring& outputRootPath, const SManifestConfig& config,
+		const std::wstring& shardTag = std::wstring());
+
+	// Read the previous run's manifest, if there is one, and work out which joint rules have changed since. A shard
+	// without a manifest of its own starts from the main one.
+	void Load();
+
+	// Drop the entries for every file not in the list, so a shard's manifest only speaks for the files it owns.
+	void RetainOnly(const std::vector<SBulkFile>& files);
+
+	/**
+	Take the entries from another manifest written with the same settings, along with the totals of the run that
+	wrote it. Entries already held are replaced.
+
+	\param 		   	path   	The manifest to merge.
+	\param [out]	pRun   	If not null, receives the totals saved with the manifest.
+	\return	False if the manifest is missing, unreadable or was written with different settings.
+	**/
+	bool MergeFrom(const std::wstring& path, SBulkResult* pRun = nullptr);
+
+	// True if the file changed, its output is missing, or a setting that can affect it has changed. A file that was
+	// only touched has its new time remembered, so later runs don't hash it again. Safe to call from any thread.
+	bool NeedsProcessing(const SBulkFile& file);
+
+	// Drop a file's entry before it is reprocessed, so if the attempt fails in any way the next run retries it.
+	void Forget(const SBulkFile& file);
+
+	// Remember the skeleton of a file that has just been loaded. Safe to call from any worker.
+	void RecordSkeleton(const SBulkFile& file, const std::vector<std::string>& skeletonNames);
+
+	// Remember the ContentHash of a file's input, taken while it was being read anyway. Safe to call from any worker.
+	void RecordContentHash(const SBulkFile& file, uint64_t contentHash);
+
+	// Record the outcome for a file. Failed files are forgotten so the next run retries them. A file that succeeded
+	// without its hash being recorded is read again to hash it. Safe to call from any worker.
+	void RecordResult(const SBulkFile& file, bool succeeded);
+
+	// Write the manifest, with the run's totals if given so a later merge can report on them.
+	bool Save(const SBulkResult* pRun = nullptr) const;
+
+	std::wstring GetManifestPath() const;
+
+	// The path of the manifest for another shard of the same run, or the main manifest for an empty tag.
+	std::wstring GetManifestPath(const std::wstring& shardTag) const;
+
+private:
+	std::string GetRelativePath(const SBulkFile& file) const;
+
+	std::wstring mInputRootPath;
+	std::wstring mOutputRootPath;
+	std::wstring mShardTag;
+	SManifestConfig mConfig;
+
+	// Set when something other than individual joint rules changed, which invalidates every file.
+	bool mIsEverythingChanged { false };
+	std::set<std::string> mChangedRules;
+
+	mutable std::mutex mMutex;
+	std::map<std::string, SManifestEntry> mEntries;
+	std::map<std::string, std::shared_ptr<const std::set<std::string>>> mPendingSkeletons;
+	std::map<std::string, uint64_t> mPendingHashes;
+};
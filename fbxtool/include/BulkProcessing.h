@@ -0,0 +1,209 @@
+#pragma once
+
+#include <fbxsdk.h>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "SceneLifecycle.h"
+
+
+// An input file found by a bulk run, and where its output should be written.
+struct SBulkFile
+{
+	std::wstring inputPath;
+	std::wstring outputPath;
+	uintmax_t size { 0 };
+};
+
+
+// Totals for a bulk run, used to build the process exit code and the scheduling report.
+struct SBulkResult
+{
+	size_t succeeded { 0 };
+	size_t failed { 0 };
+	size_t skipped { 0 };
+	size_t quarantined { 0 };
+	size_t steals { 0 };
+	int workers { 0 };
+
+	// Wall-clock time from the first file starting to the last file finishing.
+	double makespanSeconds { 0.0 };
+
+	// Time taken to find the input files. Streamed runs overlap this with the makespan.
+	double scanSeconds { 0.0 };
+
+	// Worker time spent idle because the queues were empty while other workers were still busy.
+	double stragglerSeconds { 0.0 };
+
+	// Pipelined runs only: time each stage's workers spent working, and waiting on their neighbours.
+	double stageBusySeconds [3] { 0.0, 0.0, 0.0 };
+	double stageStallSeconds [3] { 0.0, 0.0, 0.0 };
+	int stageWidths [3] { 0, 0, 0 };
+	bool isPipelined { false };
+
+	SSceneLifecycleStats sceneStats;
+};
+
+
+// Processes a single file using the manager and scene owned by the calling worker.
+typedef std::function<bool(FbxManager* pFbxManager, FbxScene* pFbxScene, const SBulkFile& file)> BulkFileProcessor;
+
+
+/**
+Run the processor over every file, spread across a pool of workers. Files are sorted largest first and dealt out with
+the longest-processing-time rule into one deque per worker; a worker whose deque runs dry steals from the busiest
+one. Worker zero runs on the calling thread with the supplied manager and scene; every other worker creates its own
+through InitializeSdkObjects, as FBX SDK objects must never be shared between threads. Each worker resets its scene
+with ResetScene after every file, which may replace the supplied scene and manager.
+
+\param 		   	files	 	The files to process, with their sizes filled in.
+\param 		   	jobCount 	Number of workers. Zero means one per hardware thread.
+\param 		   	processor	Called once per file, returns false on failure.
+**/
+SBulkResult ProcessBulkFiles(FbxManager*& pFbxManager, FbxScene*& pFbxScene, std::vector<SBulkFile> files, int jobCount,
+	BulkFileProcessor processor);
+
+
+/**
+Files handed from a scan that is still running to the workers processing them. The scan never waits on the workers.
+Of the files found so far, the largest is handed out first; without the whole list up front that is as close to
+largest first as a streamed run can get.
+**/
+class BulkFileFeed
+{
+public:
+	void Push(const SBulkFile& file);
+
+	// No more files will be pushed.
+	void Close();
+
+	// Wait for the next file. Returns false once the feed is closed and drained.
+	bool Pop(SBulkFile& file);
+
+private:
+	std::mutex mMutex;
+	std::condition_variable mNotEmpty;
+	std::vector<SBulkFile> mFiles;
+	bool mIsClosed { false };
+};
+
+
+/**
+Run the processor over files from a feed as they arrive, so processing starts while the scan is still running. Workers
+are set up as for ProcessBulkFiles, and each takes the next file from the feed whenever it is free.
+
+\param 		   	feed	 	Closed by the scan once every file has been pushed.
+\param 		   	jobCount 	Number of workers. Zero means one per hardware thread.
+\param 		   	processor	Called once per file, returns false on failure.
+**/
+SBulkResult ProcessBulkStream(FbxManager*& pFbxManager, FbxScene*& pFbxScene, BulkFileFeed& feed, int jobCount,
+	BulkFileProcessor processor);
+
+
+// Worker counts for each stage of a pipelined bulk run, and how many files may wait between stages.
+struct SPipelineWidths
+{
+	int load { 1 };
+	int transform { 1 };
+	int save { 1 };
+	int queueDepth { 2 };
+};
+
+
+// The slice of a bulk run handled by this process when one conversion is spread over several machines. Every node
+// enumerates the same input tree and picks its files by the same rule, so the slices never overlap and no coordinator
+// is needed.
+struct SBulkShard
+{
+	// Zero based, although the command line counts shards from one.
+	int index { 0 };
+	int count { 1 };
+
+	// Deal files into bins of roughly equal total size, rather than by a hash of their path.
+	bool isBySize { false };
+};
+
+
+// Command line settings for a bulk run.
+struct SBulkOptions
+{
+	int jobCount { 1 };
+	bool isPipelined { false };
+	SPipelineWidths pipelineWidths;
+
+	// Ignore the manifest and process every file.
+	bool isFullRebuild { false };
+
+	// Carry on from the journal of an interrupted run.
+	bool isResuming { false };
+
+	SBulkShard shard;
+
+	// Read the input files from this list instead of scanning the input folder. "-" reads from stdin.
+	std::string fileListPath;
+
+	// Directories listed at once while scanning the input folder.
+	int scanThreadCount { 8 };
+};
+
+
+// What the load stage did with a file. A file the load stage dealt with completely, such as one whose names were
+// patched without loading it, skips the other stages.
+enum EBulkLoadResult
+{
+	eBulkLoadFailed,
+	eBulkLoaded,
+	eBulkLoadFinished
+};
+
+typedef std::function<EBulkLoadResult(FbxManager* pFbxManager, FbxScene* pFbxScene, const SBulkFile& file)> BulkFileLoader;
+
+
+// The three phases of processing a file. A scene loaded by one stage is handed to the next along with the manager
+// that owns it, so each stage only ever touches a manager that no other thread is using at the time.
+struct SBulkStages
+{
+	BulkFileLoader load;
+	BulkFileProcessor transform;
+	BulkFileProcessor save;
+};
+
+
+/**
+Run the files through a load, transform, save pipeline with bounded queues between the stages, so the export of one
+file overlaps the import of the next. Each file in flight holds a manager and scene from a fixed pool sized to the
+stage widths plus the queues, which also caps how many scenes are resident at once. Scenes are reset with ResetScene
+on their way back to the pool. The supplied manager and scene become the first entry of the pool.
+**/
+SBulkResult ProcessBulkPipeline(FbxManager*& pFbxManager, FbxScene*& pFbxScene, std::vector<SBulkFile> files,
+	const SPipelineWidths& widths, SBulkStages stages);
+
+
+// A file's path relative to the input root, in UTF-8 with forward slashes. Used to key the manifest and journal.
+std::string GetBulkRelativePath(const std::wstring& inputRootPath, const std::wstring& inputPath);
+
+
+/**
+Pick out the files belonging to one shard. By path hash a file always lands in the same shard however the rest of
+the tree changes. By size the files are dealt largest first to whichever bin holds the fewest bytes, which balances
+the work far better but moves files between shards when the tree changes. Both only depend on the relative paths and
+sizes, so every node reaches the same split.
+**/
+std::vector<SBulkFile> SelectShard(const std::vector<SBulkFile>& files, const std::wstring& inputRootPath, const SBulkShard& shard);
+
+
+// True if a file with this relative path belongs to the shard when sharding by path hash.
+bool IsInHashShard(const std::string& relativePath, const SBulkShard& shard);
+
+
+// Suffix that keeps the files a shard writes to the output root apart from its neighbours', e.g. ".shard-2-of-4".
+// Empty when the run is not sharded.
+std::wstring GetShardTag(const SBulkShard& shard);
+
+
+// Print the totals and scheduling statistics for a bulk run.
+void DisplayBulkResult(const SBulkResult& result);
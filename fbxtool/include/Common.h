@@ -12,13 +12,69 @@
 #define _COMMON_H
 
 #include <fbxsdk.h>
+#include "AtomicFile.h"
+
+// How SaveScene writes FBX files when it isn't given a format.
+struct SExportSettings
+{
+	bool isBinary { true };
+
+	// A file version such as FBX_2014_00_COMPATIBLE, or empty for the SDK's own version.
+	FbxString fileVersion;
+
+	// Binary files only: zlib compress arrays of at least compressionMinSize bytes, at a level from 1 to 9.
+	bool isCompressingArrays { true };
+	int compressionLevel { 1 };
+	int compressionMinSize { 1024 };
+
+	// Export to memory or a temporary file, and only rename the result over the output once it is complete, so a
+	// crash can never leave a truncated file where other tools will find it.
+	bool isPublishingAtomically { true };
+	EFileSyncPolicy syncPolicy { eFileSyncNone };
+};
+
+extern SExportSettings gExportSettings;
+
+// The optional parts of a scene that LoadScene reads and SaveScene writes. Anything not imported is missing from the
+// scene, so it is not exported either.
+struct SSceneElements
+{
+	bool materials { true };
+	bool textures { true };
+
+	// Skins and clusters binding meshes to the skeleton.
+	bool links { true };
+
+	// Blend shapes.
+	bool shapes { true };
+	bool gobos { true };
+	bool animation { true };
+	bool globalSettings { true };
+};
+
+extern SSceneElements gSceneElements;
+
+// Have LoadScene hand FBX files to the importer as a memory mapped view, instead of letting the SDK read them by name.
+extern bool gIsMappingInput;
+
+// Let the importer extract media embedded in FBX files into a .fbm folder beside each file. Turned off when the media
+// goes to a shared store instead.
+extern bool gIsExtractingEmbeddedMedia;
+
+// Defer loading the plugin directory until a file needs a reader or writer the SDK doesn't have built in.
+extern bool gIsLoadingPluginsLazily;
 
 void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene);
+void LoadPlugins(FbxManager* pManager);
 void DestroySdkObjects(FbxManager* pManager, bool pExitStatus);
 void CreateAndFillIOSettings(FbxManager* pManager);
 
 bool SaveScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, int pFileFormat=-1, bool pEmbedMedia=false);
-bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename);
+bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, const SSceneElements& pElements=gSceneElements);
+
+// Import an FBX file the caller already holds in memory. The name is only used in messages.
+bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const void* pData, size_t pSize, const char* pName,
+    const SSceneElements& pElements=gSceneElements);
 
 #endif // #ifndef _COMMON_H
 
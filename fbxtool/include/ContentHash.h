@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// A fast, non-cryptographic 64 bit hash that can be fed in pieces. Used to tell whether files and settings have
+// changed, never for security.
+class ContentHash
+{
+public:
+	explicit ContentHash(uint64_t seed = 0);
+
+	void Update(const void* pData, size_t size);
+	void Update(const std::string& text);
+
+	// Hash a value with a separator, so ("ab", "c") and ("a", "bc") don't collide.
+	void UpdateField(const std::string& text);
+
+	uint64_t Finish() const;
+
+private:
+	void MixBlock(uint64_t block);
+
+	uint64_t mState;
+	uint64_t mTotalSize { 0 };
+	unsigned char mTail [8];
+	size_t mTailSize { 0 };
+};
+
+
+uint64_t HashString(const std::string& text);
+
+
+// Hash the contents of a file. Returns false if the file could not be read.
+bool HashFile(const std::wstring& path, uint64_t& hash);
+
+
+std::string HashToHex(uint64_t hash);
+uint64_t HexToHash(const char* pText);
@@ -25,4 +25,12 @@ FbxNode * CreatePyramid(FbxScene * pScene, const char * pName, double pBottomWid
 
 FbxNode* CreateCube(FbxScene* pScene, const char* pName, FbxDouble3& pLclTranslation);
 
+/** Create a rippled grid of quads, with a normal and a UV per control point, and attach it to a node.
+  * /param pScene The scene in which the grid mesh is created.
+  * /param pName The name of the grid mesh and the node to which the grid is attached.
+  * /param pSide The number of control points along each side, so the grid has pSide * pSide of them.
+  * /return Return the node to which the grid mesh is attached.
+  */
+FbxNode* CreateGrid(FbxScene* pScene, const char* pName, int pSide);
+
 #endif // INCLUDE_GEOMETRY_UTILITY_H_
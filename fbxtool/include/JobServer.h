@@ -0,0 +1,62 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+
+// One conversion asked of a resident server. Paths are absolute and UTF-8, as the server has its own working folder.
+struct SServerJob
+{
+	std::string inputPath;
+	std::string outputPath;
+	std::string jointFilePath;
+	double scale { 1.0 };
+	bool applyMixamoFixes { false };
+	bool addIK { false };
+
+	// Ask the server to finish the job queue and exit, rather than convert anything.
+	bool isShutdown { false };
+};
+
+
+// The server's reply to a job, with the time spent in each step.
+struct SServerJobResult
+{
+	bool succeeded { false };
+	std::string error;
+
+	// Reading the joint file, which is skipped while it stays unchanged.
+	double configSeconds { 0.0 };
+	double loadSeconds { 0.0 };
+	double transformSeconds { 0.0 };
+	double saveSeconds { 0.0 };
+
+	// From the request arriving to the reply being sent.
+	double totalSeconds { 0.0 };
+};
+
+
+// Runs one job on the server's resident manager and scene.
+typedef std::function<void(const SServerJob& job, SServerJobResult& result)> ServerJobHandler;
+
+
+/**
+Serve jobs over a local named pipe until a client asks for a shutdown. Each connection carries one request and one
+reply, each a single line of JSON. Jobs run one after another on the calling thread, as they share the process wide
+conversion settings; clients arriving meanwhile wait for the pipe. A client has a few seconds to send its request and
+to take the reply, after which it is dropped, so one that connects and says nothing can't hold up the rest. A handler
+that throws fails its job rather than the server. Remote clients are refused.
+
+\param 		   	pipeName	The pipe is created as \\.\pipe\<pipeName>.
+\param 		   	handler 	Called for each job.
+\return	False if the pipe could not be created.
+**/
+bool RunJobServer(const std::string& pipeName, ServerJobHandler handler);
+
+
+// Send a job to a running server and wait for its reply. Returns false if the server could not be reached.
+bool SendServerJob(const std::string& pipeName, const SServerJob& job, SServerJobResult& result);
+
+
+// Print the reply to a job.
+void DisplayServerJobResult(const SServerJobResult& result);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "JointPatterns.h"
+
+
+// The rules of one joint file, in the order the file gives them.
+struct SJointMapping
+{
+	std::string path;
+	std::vector<std::pair<std::string, std::string>> renames;
+	std::vector<SJointPattern> patterns;
+};
+
+
+// Where one joint name is taken by a chain of joint files.
+struct SComposedJoint
+{
+	// The name before the first file and after each file in turn, so the last is the final name.
+	std::vector<std::string> names;
+};
+
+
+// A chain of joint files composed into direct renames, so a scene can be renamed in one pass.
+struct SComposedJointChain
+{
+	// Every name any file of the chain renames.
+	std::vector<SComposedJoint> joints;
+
+	// The chain after the first file, for the names the first file's patterns give.
+	std::vector<std::pair<std::string, std::string>> tail;
+};
+
+
+// Split the joint files passed to -j, given as a comma separated list applied in order.
+std::vector<std::string> SplitJointFileList(const std::string& list);
+
+
+/**
+Read a joint file in the text format, one old=new pair per line. Blank lines and lines starting with # are skipped.
+
+\param 		   	path   	The file.
+\param [out]	mapping	Its renames.
+\param [out]	error  	Why it couldn't be read.
+**/
+bool ReadJointTextFile(const std::string& path, SJointMapping& mapping, std::string& error);
+
+
+// Add a rename to a mapping. False if the mapping already gives the old name a different new name.
+bool AddJointRename(SJointMapping& mapping, const std::string& oldName, const std::string& newName, std::string& error);
+
+
+/**
+Compose a chain of joint files, each applied to the names the one before it gave, into direct renames. A name that no
+file renames is left alone by that file, and passed on to the next.
+
+Pattern rules are only allowed in the first file, since the names a pattern gives can't be known until a scene is
+loaded; they are run through the rest of the chain then, using the tail.
+
+\param 		   	mappings	The joint files, in the order they are applied.
+\param [out]	chain   	The composed renames.
+\param [out]	error   	Why the chain can't be composed: a pattern rule after the first file, or a chain that
+                        	takes a name back to one it already had.
+**/
+bool ComposeJointChain(const std::vector<SJointMapping>& mappings, SComposedJointChain& chain, std::string& error);
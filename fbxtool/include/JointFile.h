@@ -0,0 +1,57 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "JointPatterns.h"
+
+
+// An exact entry of a joint file.
+struct SJointFileJoint
+{
+	std::string oldName;
+	std::string newName;
+	std::string physicsProxy;
+	std::string ragdollProxy;
+	std::string primitiveType;
+	std::string parentNode;
+};
+
+
+// Everything a JSON joint file holds. Settings the file leaves out are empty, so a chain keeps an earlier file's.
+struct SJointFile
+{
+	std::vector<SJointFileJoint> joints;
+
+	// The prefix, suffix and glob rules, as patterns, in file order.
+	std::vector<SJointPattern> patterns;
+
+	std::optional<std::string> axis;
+	std::optional<bool> applyWeaponFix;
+	std::optional<bool> addRoot;
+	std::optional<std::string> addRootChildName;
+	std::optional<std::string> addRootRootName;
+	std::optional<std::string> removeLeafName;
+};
+
+
+/**
+Load a JSON joint file. The JSON is parsed in place and checked against the joint file schema, so a wrong type or a
+missing name is reported with where it is in the file rather than asserting. Once checked, the contents are written to
+the cache in a compact binary form named by a hash of the file, and any later load of the same content reads that
+instead, without parsing JSON at all.
+
+\param 		   	path		  	The joint file.
+\param 		   	cacheDirectory	Where the binary forms are kept, or empty not to cache. Created if need be.
+\param [out]	jointFile	  	The file's contents.
+\param [out]	isFromCache   	True if the contents came from the cache.
+\param [out]	error		  	Why the file couldn't be loaded.
+**/
+bool LoadJointFile(const std::string& path, const std::filesystem::path& cacheDirectory, SJointFile& jointFile, bool& isFromCache,
+	std::string& error);
+
+
+// The cache directory used unless --joint-cache says otherwise, in the temporary folder.
+std::filesystem::path GetDefaultJointCacheDirectory();
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// A joint rule that matches names by pattern rather than spelling out each one.
+struct SJointPattern
+{
+	// A glob, where * matches any run of characters and ? any one character. Each wildcard is a capture group,
+	// numbered from 1 left to right.
+	std::string pattern;
+
+	// The new name, where $1 to $9 insert what the groups matched and $$ is a dollar sign.
+	std::string newName;
+};
+
+
+/**
+The pattern rules of a joint file, compiled together into one DFA, so a node name is matched against every rule in a
+single pass over its characters, however many rules there are. When several rules match, the first in the file wins.
+The DFA is built in full up front, so it can be shared by any number of threads without locking.
+**/
+class JointPatternSet
+{
+public:
+	static constexpr uint32_t notFound = UINT32_MAX;
+
+	JointPatternSet();
+
+	// Compile the rules. False if a rule uses a group it doesn't have, or the rules are too tangled to compile.
+	bool Compile(const std::vector<SJointPattern>& patterns, std::string& error);
+
+	// The index of the first rule matching the name, or notFound. Doesn't allocate.
+	uint32_t Match(const char* pName) const;
+
+	// The new name a matching rule gives the name.
+	std::string Rename(uint32_t rule, const char* pName) const;
+
+	bool IsEmpty() const { return mPatterns.empty(); }
+	const std::vector<SJointPattern>& GetPatterns() const { return mPatterns; }
+
+private:
+	std::vector<SJointPattern> mPatterns;
+
+	// Each rule's pattern as tokens: a byte, or one of the wildcards.
+	std::vector<std::vector<int>> mTokens;
+
+	// Bytes that appear in a pattern each have a class of their own; every other byte shares class 0.
+	uint8_t mByteClasses [256];
+	size_t mClassCount { 1 };
+
+	// The DFA: mClassCount transitions per state, and the rule each state accepts, if any. State 0 matches nothing
+	// and never leaves itself.
+	std::vector<uint32_t> mTransitions;
+	std::vector<uint32_t> mAccepts;
+	uint32_t mStartState { 0 };
+};
+
+
+// Turn the prefix and suffix rules of a joint file into patterns. Only the part matched by the prefix or suffix
+// changes; the rest of the name is kept.
+SJointPattern MakePrefixPattern(const std::string& oldPrefix, const std::string& newPrefix);
+SJointPattern MakeSuffixPattern(const std::string& oldSuffix, const std::string& newSuffix);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/**
+The joint renames from a joint file, compiled once into a form that can be queried for every node of a scene without
+allocating. Names are interned into a single buffer, and found through an open addressing hash table of indices, so a
+lookup is one hash of the node's name and, almost always, one comparison.
+**/
+class JointRenameTable
+{
+public:
+	static constexpr uint32_t notFound = UINT32_MAX;
+
+	JointRenameTable();
+
+	// Compile pairs of old and new names. If an old name appears twice, the later pair wins.
+	explicit JointRenameTable(const std::vector<std::pair<std::string, std::string>>& renames);
+
+	// The index of the joint with this old name, or notFound.
+	uint32_t Find(const char* pName) const;
+
+	// Null terminated, and valid for as long as the table is.
+	const char* GetOldName(uint32_t index) const;
+	const char* GetNewName(uint32_t index) const;
+
+	size_t GetSize() const { return mEntries.size(); }
+	bool IsEmpty() const { return mEntries.empty(); }
+
+private:
+	struct SEntry
+	{
+		uint64_t hash { 0 };
+		uint32_t oldName { 0 };
+		uint32_t oldLength { 0 };
+		uint32_t newName { 0 };
+	};
+
+	uint32_t Intern(const std::string& name);
+
+	// Every name, each followed by a null.
+	std::string mNames;
+	std::vector<SEntry> mEntries;
+
+	// Indices into mEntries, or notFound for an empty slot. The size is a power of two at least twice the entries.
+	std::vector<uint32_t> mSlots;
+	uint64_t mSlotMask { 0 };
+};
+
+
+/**
+Time looking up every bone of a synthetic rig, once the way the joint map used to be searched, copying the map for
+each node and searching it by string, and once through a compiled table.
+
+\param 		   	renames  	The renames to look up, e.g. from a joint file.
+\param 		   	boneCount	Bones in the rig. The first ones use the renames' old names, the rest miss.
+\param 		   	runs	 	How many times to traverse the rig each way.
+**/
+void BenchmarkJointRenames(const std::vector<std::pair<std::string, std::string>>& renames, int boneCount, int runs);
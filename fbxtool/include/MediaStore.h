@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "AtomicFile.h"
+
+
+enum EMediaExtractResult
+{
+	eMediaExtracted,
+
+	// The file isn't binary FBX, so its media was left alone.
+	eMediaUnsupported,
+
+	// The file was damaged, or a blob couldn't be written.
+	eMediaFailed
+};
+
+
+struct SMediaStoreStats
+{
+	// Embedded files found in the inputs.
+	size_t mediaCount { 0 };
+	uint64_t mediaBytes { 0 };
+
+	// Distinct contents written to the store this run.
+	size_t writtenCount { 0 };
+	uint64_t writtenBytes { 0 };
+
+	// Media whose content was already in the store, so nothing was written.
+	size_t reusedCount { 0 };
+	uint64_t reusedBytes { 0 };
+};
+
+
+/**
+A directory of media files, each named by a hash of its content, which the media embedded in FBX files is extracted
+into. A texture embedded in a thousand files is written once, and each output file refers to the shared copy instead
+of carrying its own. Blobs are published atomically, so several workers, or several runs, can share a store.
+**/
+class MediaStore
+{
+public:
+	MediaStore(const std::wstring& directory, EFileSyncPolicy syncPolicy);
+
+	/**
+	Stream a binary FBX file and extract the content of every embedded video or texture into the store, skipping any
+	content already there. Nothing is decompressed or loaded beyond one record at a time.
+
+	\param 		   	fbxPath  	The binary FBX file.
+	\param [out]	extracted	The store path for each embedded file, keyed by both the absolute and relative file
+	                        	names the FBX file records for it.
+	\param [out]	error	 	Why the media couldn't be extracted.
+	**/
+	EMediaExtractResult ExtractEmbeddedMedia(const std::wstring& fbxPath, std::map<std::string, std::wstring>& extracted, std::string& error);
+
+	const std::wstring& GetDirectory() const { return mDirectory; }
+
+	SMediaStoreStats GetStats() const;
+
+private:
+	// Put one blob in the store, if its content isn't there already, and return its path.
+	bool StoreBlob(const char* pData, size_t size, const std::string& fileName, std::wstring& blobPath);
+
+	std::wstring mDirectory;
+	EFileSyncPolicy mSyncPolicy;
+
+	// Guards writing blobs and the stats.
+	mutable std::mutex mMutex;
+	SMediaStoreStats mStats;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <fbxsdk.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+// The SDK widened stream positions to 64 bits in 2019.
+#if FBXSDK_VERSION_MAJOR >= 2019
+typedef FbxInt64 FbxStreamPosition;
+#else
+typedef long FbxStreamPosition;
+#endif
+
+
+/**
+An FbxStream that serves an FBX file from memory, so the importer reads it without any file calls of its own. The
+bytes are either a view of the file mapped by the stream, or a buffer the caller already holds and keeps alive for as
+long as the stream is used.
+**/
+class MemoryReadStream : public FbxStream
+{
+public:
+	explicit MemoryReadStream(FbxManager* pManager);
+	MemoryReadStream(FbxManager* pManager, const void* pData, size_t size);
+	~MemoryReadStream();
+
+	MemoryReadStream(const MemoryReadStream&) = delete;
+	MemoryReadStream& operator=(const MemoryReadStream&) = delete;
+
+	// Map the whole file read only, with the OS told it will be read front to back. False if the file can't be
+	// opened or is empty.
+	bool MapFile(const std::wstring& path);
+
+	const char* GetData() const { return mpData; }
+	size_t GetSize() const { return mSize; }
+
+	EState GetState() override;
+	bool Open(void* pStreamData) override;
+	bool Close() override;
+	bool Flush() override;
+	size_t Write(const void* pData, FbxUInt64 pSize) override;
+	size_t Read(void* pData, FbxUInt64 pSize) const override;
+	char* ReadString(char* pBuffer, int pMaxSize, bool pStopAtFirstWhiteSpace = false) override;
+	int GetReaderID() const override;
+	int GetWriterID() const override;
+	void Seek(const FbxInt64& pOffset, const FbxFile::ESeekPos& pSeekPos) override;
+	FbxStreamPosition GetPosition() const override;
+	void SetPosition(FbxStreamPosition pPosition) override;
+	int GetError() const override;
+	void ClearError() override;
+
+private:
+	void Unmap();
+
+	int mReaderID { -1 };
+	const char* mpData { nullptr };
+	size_t mSize { 0 };
+	void* mMappingHandle { nullptr };
+
+	EState mState { eClosed };
+
+	// Read is const in the FbxStream interface.
+	mutable size_t mPosition { 0 };
+	mutable int mError { 0 };
+};
+
+
+/**
+An FbxStream that an exporter writes into a buffer which grows as needed, so the file can be written out with one
+large write once the export has finished. Opening the stream empties the buffer, as opening a file for writing would.
+**/
+class MemoryWriteStream : public FbxStream
+{
+public:
+	explicit MemoryWriteStream(int writerID);
+
+	const char* GetData() const { return mBuffer.data(); }
+	size_t GetSize() const { return mBuffer.size(); }
+
+	EState GetState() override;
+	bool Open(void* pStreamData) override;
+	bool Close() override;
+	bool Flush() override;
+	size_t Write(const void* pData, FbxUInt64 pSize) override;
+	size_t Read(void* pData, FbxUInt64 pSize) const override;
+	int GetReaderID() const override;
+	int GetWriterID() const override;
+	void Seek(const FbxInt64& pOffset, const FbxFile::ESeekPos& pSeekPos) override;
+	FbxStreamPosition GetPosition() const override;
+	void SetPosition(FbxStreamPosition pPosition) override;
+	int GetError() const override;
+	void ClearError() override;
+
+private:
+	int mWriterID { -1 };
+	std::vector<char> mBuffer;
+	EState mState { eClosed };
+
+	// The writer seeks back to fill in offsets, so writes land at the position rather than always at the end.
+	mutable size_t mPosition { 0 };
+	mutable int mError { 0 };
+};
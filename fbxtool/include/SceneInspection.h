@@ -0,0 +1,32 @@
+#pragma once
+
+#include <fbxsdk.h>
+#include <ostream>
+#include <string>
+
+#include "BulkProcessing.h"
+
+
+/**
+Describe a file from its header alone: file version, animation stacks with their time spans, and the applications
+that created and last saved it. FbxImporter::Initialize reads all of this without importing the scene, which is
+where nearly all the time goes on a full load.
+
+\param 		   	pManager  	Manager used to create the importer.
+\param 		   	pFilename 	UTF-8 path of the file to inspect.
+\param 		   	name	  	How the file is named in the output.
+\param [out]	line	  	One line of JSON. Files that can't be read get a line with an "error" member.
+\return	False if the file couldn't be read.
+**/
+bool InspectFile(FbxManager* pManager, const char* pFilename, const std::string& name, std::string& line);
+
+
+/**
+Inspect every file from the feed, spread over a pool of threads with a manager each, and write one JSON line per file
+to the stream as each finishes. Nothing else is written to the stream, so the output can be piped straight into other
+tools.
+
+\param 		   	inputRootPath	Files are named by their path relative to this.
+\return	The number of files that couldn't be read.
+**/
+size_t InspectFiles(BulkFileFeed& feed, int jobCount, const std::wstring& inputRootPath, std::ostream& outputStream);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <fbxsdk.h>
+#include <cstddef>
+
+
+// How a bulk worker gets an empty scene for its next file.
+enum ESceneResetMode
+{
+	// Clear the existing scene, keeping the scene object itself.
+	eSceneRecycle,
+
+	// Destroy the scene and create a new one, as a fresh process would.
+	eSceneRecreate
+};
+
+
+// Counters for scene resets, kept per worker and merged at the end of a bulk run.
+struct SSceneLifecycleStats
+{
+	size_t recycles { 0 };
+	size_t recreates { 0 };
+	size_t managerRecreates { 0 };
+	double recycleSeconds { 0.0 };
+	double recreateSeconds { 0.0 };
+
+	// Process resident memory measured straight after each kind of reset. The process figure is shared between
+	// workers, so these are only comparable with each other, not attributable to a single scene.
+	double recycleResidentBytes { 0.0 };
+	double recreateResidentBytes { 0.0 };
+	size_t peakResidentBytes { 0 };
+
+	void Merge(const SSceneLifecycleStats& other);
+};
+
+
+extern ESceneResetMode gSceneResetMode;
+
+// Resident memory, in bytes, above which a worker also rebuilds its manager. Zero disables the cap.
+extern size_t gMaxResidentBytes;
+
+
+/**
+Empty the scene ready for the next file. LoadScene imports into whatever the scene already holds, so without this a
+reused scene accumulates every file it has seen. In recycle mode one reset in every few is done as a full recreate
+so the report can compare the two; if resident memory is still above the cap afterwards the manager is rebuilt too.
+
+\param [in,out]	pManager	The worker's manager. Replaced if the memory cap forces a rebuild.
+\param [in,out]	pScene  	The worker's scene. May be replaced by a new scene.
+\param [in,out]	stats   	The worker's counters.
+**/
+void ResetScene(FbxManager*& pManager, FbxScene*& pScene, SSceneLifecycleStats& stats);
+
+
+// Current resident memory (working set) of the process.
+size_t GetResidentBytes();
+
+
+// Print a comparison of recycling against recreating scenes.
+void DisplaySceneLifecycleStats(const SSceneLifecycleStats& stats);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <fbxsdk.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+/**
+The nodes of a scene by name, so looking a node up doesn't scan the whole scene the way FbxScene::FindNodeByName and
+FbxNode::FindChild do. Built once a scene is loaded, and kept up to date by making every rename, added node and
+removed node go through it. Nodes are kept in scene order, so where several share a name, Find returns the one
+FindNodeByName would have.
+**/
+class SceneNodeIndex
+{
+public:
+	// Index every node of the scene, replacing whatever was indexed before.
+	void Build(FbxScene* pFbxScene);
+
+	// Forget the scene, before it is cleared or destroyed.
+	void Clear();
+
+	// The first node with the name, or null.
+	FbxNode* Find(const char* pName) const;
+
+	// The node with the name that pRoot->FindChild(pName, true) would find, or null. FindChild searches the hierarchy
+	// rather than the scene, checking each node's children before any of theirs, so it can pick a different node from
+	// Find when several share the name.
+	FbxNode* FindBelow(FbxNode* pRoot, const char* pName) const;
+
+	// Index a node just added to the scene. It comes after every node already indexed.
+	void Add(FbxNode* pNode);
+
+	// Stop indexing a node that is being removed from the scene.
+	void Remove(FbxNode* pNode);
+
+	// Rename a node, keeping its place in scene order.
+	void Rename(FbxNode* pNode, const char* pNewName);
+
+	// Each name held by more than one node, with how many hold it.
+	std::vector<std::pair<std::string, size_t>> GetDuplicateNames() const;
+
+	size_t GetSize() const { return mOrders.size(); }
+
+private:
+	// Each node's position in scene order, and the nodes with each name in that order.
+	std::unordered_map<FbxNode*, uint64_t> mOrders;
+	std::unordered_map<std::string, std::map<uint64_t, FbxNode*>> mNodes;
+	uint64_t mNextOrder { 0 };
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+
+// Print a breakdown of start-up time once the tool is ready to work on its first file.
+extern bool gIsProfilingStartup;
+
+
+/**
+Start timing at the top of main. The time between the process being created and main being reached, which covers
+loading the executable and the FBX SDK DLL, is taken from the OS and becomes the first phase.
+**/
+void BeginStartupProfile();
+
+
+// End the phase in progress and start the next. Phases are back to back, so each mark names what was just finished.
+// Ignored once the start-up is over, so code shared with worker threads can mark phases freely.
+void MarkStartupPhase(const char* pPhaseName);
+
+
+// Stop recording phases, and print them if profiling was asked for.
+void EndStartupProfile();
@@ -0,0 +1,276 @@
+#include "BinaryFbxFixture.h"
+
+#include <cstring>
+
+
+// The ID and magic the FBX SDK writes into the footer.
+static const unsigned char footerId [16] =
+	{ 0xfa, 0xbc, 0xab, 0x09, 0xd0, 0xc8, 0xd4, 0x66, 0xb1, 0x76, 0xfb, 0x83, 0x1c, 0xf7, 0x26, 0x7e };
+static const unsigned char footerMagic [16] =
+	{ 0xf8, 0x5a, 0x8c, 0x6a, 0xde, 0xf5, 0xd9, 0x7e, 0xec, 0xe9, 0x0c, 0xe3, 0x75, 0x8f, 0x29, 0x0b };
+
+// FBX times are counted in ticks of 1/46186158000 of a second.
+static const int64_t ticksPerSecond = 46186158000;
+
+
+template<typename T>
+static void Append(std::string& bytes, T value)
+{
+	bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+
+SFixtureRecord& SFixtureRecord::Bool(bool value)
+{
+	properties += 'C';
+	Append<uint8_t>(properties, value ? 1 : 0);
+	propertyCount++;
+	return *this;
+}
+
+
+SFixtureRecord& SFixtureRecord::Integer(int32_t value)
+{
+	properties += 'I';
+	Append(properties, value);
+	propertyCount++;
+	return *this;
+}
+
+
+SFixtureRecord& SFixtureRecord::Long(int64_t value)
+{
+	properties += 'L';
+	Append(properties, value);
+	propertyCount++;
+	return *this;
+}
+
+
+SFixtureRecord& SFixtureRecord::Number(double value)
+{
+	properties += 'D';
+	Append(properties, value);
+	propertyCount++;
+	return *this;
+}
+
+
+SFixtureRecord& SFixtureRecord::String(const std::string& value)
+{
+	properties += 'S';
+	Append(properties, static_cast<uint32_t>(value.size()));
+	properties += value;
+	propertyCount++;
+	return *this;
+}
+
+
+SFixtureRecord& SFixtureRecord::Doubles(const std::vector<double>& values)
+{
+	properties += 'd';
+	Append(properties, static_cast<uint32_t>(values.size()));
+	Append<uint32_t>(properties, 0);
+	Append(properties, static_cast<uint32_t>(values.size() * sizeof(double)));
+	for (double value : values)
+		Append(properties, value);
+	propertyCount++;
+	return *this;
+}
+
+
+SFixtureRecord& SFixtureRecord::Child(const SFixtureRecord& child)
+{
+	children.push_back(child);
+	return *this;
+}
+
+
+size_t GetFixtureRecordHeaderSize(uint32_t version)
+{
+	return ((version >= 7500) ? 3 * sizeof(uint64_t) : 3 * sizeof(uint32_t)) + sizeof(uint8_t);
+}
+
+
+static void WriteRecordHeader(std::string& file, size_t at, uint64_t endOffset, uint64_t propertyCount, uint64_t propertyListSize,
+	uint8_t nameLength, uint32_t version)
+{
+	std::string header;
+	if (version >= 7500)
+	{
+		Append(header, endOffset);
+		Append(header, propertyCount);
+		Append(header, propertyListSize);
+	}
+	else
+	{
+		Append(header, static_cast<uint32_t>(endOffset));
+		Append(header, static_cast<uint32_t>(propertyCount));
+		Append(header, static_cast<uint32_t>(propertyListSize));
+	}
+	Append(header, nameLength);
+
+	file.replace(at, header.size(), header);
+}
+
+
+static void WriteRecord(std::string& file, const SFixtureRecord& record, int depth, uint32_t version, std::vector<SFixtureLayout>* pLayout)
+{
+	size_t headerSize = GetFixtureRecordHeaderSize(version);
+	size_t start = file.size();
+
+	// The layout is in visiting order, so a record's entry goes in before its children's.
+	size_t layoutIndex = pLayout ? pLayout->size() : 0;
+	if (pLayout)
+		pLayout->push_back(SFixtureLayout());
+
+	file.append(headerSize, '\0');
+	file += record.name;
+	file += record.properties;
+
+	if (!record.children.empty())
+	{
+		for (const auto& child : record.children)
+			WriteRecord(file, child, depth + 1, version, pLayout);
+
+		file.append(headerSize, '\0');
+	}
+
+	WriteRecordHeader(file, start, file.size(), record.propertyCount, record.properties.size(),
+		static_cast<uint8_t>(record.name.size()), version);
+
+	if (pLayout)
+	{
+		SFixtureLayout& layout = (*pLayout) [layoutIndex];
+		layout.name = record.name;
+		layout.depth = depth;
+		layout.offset = start;
+		layout.endOffset = file.size();
+		layout.propertyCount = record.propertyCount;
+		layout.propertyListSize = record.properties.size();
+	}
+}
+
+
+std::string WriteBinaryFbxFixture(const std::vector<SFixtureRecord>& records, uint32_t version, std::vector<SFixtureLayout>* pLayout)
+{
+	std::string file("Kaydara FBX Binary  \0\x1a\0", 23);
+	Append(file, version);
+
+	if (pLayout)
+		pLayout->clear();
+
+	for (const auto& record : records)
+		WriteRecord(file, record, 0, version, pLayout);
+
+	file.append(GetFixtureRecordHeaderSize(version), '\0');
+
+	// Four zeros, then as many more as bring the version to a multiple of 16 bytes, at least one.
+	file.append(reinterpret_cast<const char*>(footerId), sizeof(footerId));
+	file.append(4, '\0');
+	file.append(16 - (file.size() % 16), '\0');
+	Append(file, version);
+	file.append(120, '\0');
+	file.append(reinterpret_cast<const char*>(footerMagic), sizeof(footerMagic));
+
+	return file;
+}
+
+
+// A property as a P record: the name, type, label and flags, then the values.
+static SFixtureRecord MakeProperty(const std::string& name, const std::string& type)
+{
+	return SFixtureRecord("P").String(name).String(type).String("").String("");
+}
+
+
+// Object names are stored with their class, as "name\x00\x01class".
+static std::string MakeObjectName(const std::string& name, const char* pClassName)
+{
+	return name + std::string("\x00\x01", 2) + pClassName;
+}
+
+
+static SFixtureRecord MakeTranslation(const double translation [3])
+{
+	return MakeProperty("Lcl Translation", "Lcl Translation").Number(translation [0]).Number(translation [1]).Number(translation [2]);
+}
+
+
+std::vector<SFixtureRecord> MakeCharacterRecords(const SCharacterFixture& character)
+{
+	const std::string& animationName = character.animationName;
+	const int64_t stackId = 900;
+	const int64_t meshId = 800;
+	const int64_t geometryId = 810;
+
+	SFixtureRecord header("FBXHeaderExtension");
+	header.Child(SFixtureRecord("FBXHeaderVersion").Integer(1003));
+	header.Child(SFixtureRecord("SceneInfo").String(MakeObjectName("GlobalInfo", "SceneInfo")).String("UserData")
+		.Child(SFixtureRecord("MetaData")
+			.Child(SFixtureRecord("Version").Integer(100))
+			.Child(SFixtureRecord("Title").String("Walk"))
+			.Child(SFixtureRecord("Author").String("Fixture")))
+		.Child(SFixtureRecord("Properties70")
+			.Child(MakeProperty("Original|ApplicationName", "KString").String("fbxtool tests"))));
+
+	SFixtureRecord documents("Documents");
+	documents.Child(SFixtureRecord("Count").Integer(1));
+	documents.Child(SFixtureRecord("Document").Long(1).String("Scene").String("Scene")
+		.Child(SFixtureRecord("Properties70")
+			.Child(MakeProperty("SourceObject", "object"))
+			.Child(MakeProperty("ActiveAnimStackName", "KString").String(animationName)))
+		.Child(SFixtureRecord("RootNode").Long(0)));
+
+	SFixtureRecord objects("Objects");
+	SFixtureRecord connections("Connections");
+
+	for (size_t i = 0; i < character.boneNames.size(); i++)
+	{
+		const std::string& boneName = character.boneNames [i];
+		const std::string& attributeName = (i < character.attributeNames.size()) ? character.attributeNames [i] : boneName;
+		const double boneTranslation [3] { 0.0, 10.0, 0.5 };
+		int64_t boneId = 100 + static_cast<int64_t>(i);
+
+		objects.Child(SFixtureRecord("NodeAttribute").Long(boneId + 100).String(MakeObjectName(attributeName, "NodeAttribute"))
+			.String("LimbNode")
+			.Child(SFixtureRecord("TypeFlags").String("Skeleton")));
+
+		objects.Child(SFixtureRecord("Model").Long(boneId).String(MakeObjectName(boneName, "Model")).String("LimbNode")
+			.Child(SFixtureRecord("Version").Integer(232))
+			.Child(SFixtureRecord("Properties70")
+				.Child(MakeTranslation((i == 0) ? character.rootTranslation : boneTranslation))
+				.Child(MakeProperty("Size", "double").Number(100.0)))
+			.Child(SFixtureRecord("Shading").Bool(true)));
+
+		connections.Child(SFixtureRecord("C").String("OO").Long(boneId + 100).Long(boneId));
+		connections.Child(SFixtureRecord("C").String("OO").Long(boneId).Long((i == 0) ? 0 : boneId - 1));
+	}
+
+	objects.Child(SFixtureRecord("Geometry").Long(geometryId).String(MakeObjectName("Body", "Geometry")).String("Mesh")
+		.Child(SFixtureRecord("Vertices").Doubles({ 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0 })));
+
+	const double meshTranslation [3] { 0.0, 0.0, 0.0 };
+	objects.Child(SFixtureRecord("Model").Long(meshId).String(MakeObjectName("Body", "Model")).String("Mesh")
+		.Child(SFixtureRecord("Properties70")
+			.Child(MakeTranslation(meshTranslation))));
+
+	objects.Child(SFixtureRecord("AnimationStack").Long(stackId).String(MakeObjectName(animationName, "AnimStack")).String("")
+		.Child(SFixtureRecord("Properties70")
+			.Child(MakeProperty("LocalStart", "KTime").Long(0))
+			.Child(MakeProperty("LocalStop", "KTime").Long(ticksPerSecond * 3 / 2))));
+
+	objects.Child(SFixtureRecord("AnimationLayer").Long(stackId + 1).String(MakeObjectName("BaseLayer", "AnimLayer")).String(""));
+
+	connections.Child(SFixtureRecord("C").String("OO").Long(geometryId).Long(meshId));
+	connections.Child(SFixtureRecord("C").String("OO").Long(meshId).Long(0));
+	connections.Child(SFixtureRecord("C").String("OO").Long(stackId + 1).Long(stackId));
+
+	SFixtureRecord takes("Takes");
+	takes.Child(SFixtureRecord("Current").String(animationName));
+	takes.Child(SFixtureRecord("Take").String(animationName)
+		.Child(SFixtureRecord("FileName").String(animationName + ".tak"))
+		.Child(SFixtureRecord("LocalTime").Long(0).Long(ticksPerSecond * 3 / 2)));
+
+	return { header, documents, SFixtureRecord("Creator").String("FBX SDK/FBX Plugins version 2020.2"), objects, connections, takes };
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// A record to write into a binary FBX fixture. Properties are encoded as they are added.
+struct SFixtureRecord
+{
+	explicit SFixtureRecord(const std::string& recordName) : name(recordName) {}
+
+	SFixtureRecord& Bool(bool value);
+	SFixtureRecord& Integer(int32_t value);
+	SFixtureRecord& Long(int64_t value);
+	SFixtureRecord& Number(double value);
+	SFixtureRecord& String(const std::string& value);
+
+	// An uncompressed array of doubles.
+	SFixtureRecord& Doubles(const std::vector<double>& values);
+
+	SFixtureRecord& Child(const SFixtureRecord& child);
+
+	std::string name;
+	uint32_t propertyCount { 0 };
+	std::string properties;
+	std::vector<SFixtureRecord> children;
+};
+
+
+// Where a record ended up in a written fixture, in the order the reader visits them.
+struct SFixtureLayout
+{
+	std::string name;
+	int depth { 0 };
+	uint64_t offset { 0 };
+	uint64_t endOffset { 0 };
+	uint32_t propertyCount { 0 };
+	uint64_t propertyListSize { 0 };
+};
+
+
+// The bytes every binary FBX file starts with, and the size of a record header for each layout.
+const size_t fixtureHeaderSize = 27;
+size_t GetFixtureRecordHeaderSize(uint32_t version);
+
+
+/**
+Write records as a binary FBX file the way the FBX SDK lays one out: the header, the records with an empty record
+closing each list of children, then the footer with its zeros aligning the version to 16 bytes. Version 7500 and later
+use 64 bit record offsets, earlier versions 32 bit ones.
+
+\param 		   	records	The top level records.
+\param 		   	version	The file version, e.g. 7400.
+\param [out]	pLayout	Where each record was written, if wanted.
+**/
+std::string WriteBinaryFbxFixture(const std::vector<SFixtureRecord>& records, uint32_t version,
+	std::vector<SFixtureLayout>* pLayout = nullptr);
+
+
+// What the character fixture is called and where its first bone sits.
+struct SCharacterFixture
+{
+	std::string animationName { "mixamo.com" };
+	std::vector<std::string> boneNames { "mixamorig:Hips", "mixamorig:Spine", "mixamorig:Head" };
+
+	// The names of the bones' skeleton attributes, if not the bones' own.
+	std::vector<std::string> attributeNames;
+
+	double rootTranslation [3] { 1.5, 90.0, -2.25 };
+};
+
+
+// A small skinned character as an exporter writes it: the header extension, the document with its active stack, a
+// chain of bones with their attributes, a mesh, one animation stack, the connections and the take.
+std::vector<SFixtureRecord> MakeCharacterRecords(const SCharacterFixture& character);
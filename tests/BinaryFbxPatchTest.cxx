@@ -0,0 +1,536 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "BinaryFbxFixture.h"
+#include "BinaryFbxPatch.h"
+#include "BinaryFbxReader.h"
+#include "ContentHash.h"
+#include "TestCheck.h"
+
+
+static const uint32_t testedVersions [] = { 7400, 7500 };
+
+// The footer's ID, and its version, 120 zeros and magic after the zeros that align them.
+static const size_t footerIdSize = 16;
+static const size_t footerTrailerSize = 4 + 120 + 16;
+
+
+static std::filesystem::path GetTestPath(const char* pName)
+{
+	return std::filesystem::temp_directory_path() / (std::string("fbxtool-patch-test-") + pName + ".fbx");
+}
+
+
+static void WriteFile(const std::filesystem::path& path, const std::string& bytes)
+{
+	std::ofstream fileStream(path, std::ios::binary | std::ios::trunc);
+	fileStream.write(bytes.data(), bytes.size());
+}
+
+
+static std::string ReadFile(const std::filesystem::path& path)
+{
+	std::ifstream fileStream(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(fileStream), std::istreambuf_iterator<char>());
+}
+
+
+// Patch the file through the file system, as the tool does, and return what was written.
+static EBinaryPatchResult PatchFixture(const std::string& input, const SBinaryPatchRequest& request, SBinaryPatchInfo& info,
+	std::string& output)
+{
+	std::filesystem::path inputPath = GetTestPath("input");
+	std::filesystem::path outputPath = GetTestPath("output");
+	WriteFile(inputPath, input);
+	std::filesystem::remove(outputPath);
+
+	EBinaryPatchResult result = PatchBinaryFbxNames(inputPath.wstring(), outputPath.wstring(), request, eFileSyncNone, info);
+	output = std::filesystem::exists(outputPath) ? ReadFile(outputPath) : std::string();
+
+	std::filesystem::remove(inputPath);
+	std::filesystem::remove(outputPath);
+	return result;
+}
+
+
+// Finds where the top level records end, which is where the closing empty record and the footer start.
+class TopLevelVisitor : public BinaryFbxVisitor
+{
+public:
+	bool BeginRecord(const SBinaryFbxRecord& record) override
+	{
+		recordsEnd = record.endOffset;
+		return false;
+	}
+
+	uint64_t recordsEnd { 0 };
+};
+
+
+// The footer must have the FBX SDK's layout: the ID, 5 to 20 zeros ending on a 16 byte boundary, then the version,
+// 120 zeros and the magic.
+static void CheckFooter(const std::string& file, uint32_t version)
+{
+	std::istringstream stream(file);
+	BinaryFbxReader reader(stream);
+	TopLevelVisitor visitor;
+	CHECK(reader.Read(visitor));
+
+	size_t footerStart = static_cast<size_t>(visitor.recordsEnd) + GetFixtureRecordHeaderSize(version);
+	CHECK(file.size() > footerStart + footerIdSize + footerTrailerSize);
+	if (file.size() <= footerStart + footerIdSize + footerTrailerSize)
+		return;
+
+	size_t versionOffset = file.size() - footerTrailerSize;
+	size_t zeroCount = versionOffset - footerStart - footerIdSize;
+	CHECK((zeroCount >= 5) && (zeroCount <= 20));
+	CHECK_EQUAL(size_t(0), versionOffset % 16);
+	CHECK(file.find_first_not_of('\0', footerStart + footerIdSize) == versionOffset);
+
+	uint32_t footerVersion = 0;
+	memcpy(&footerVersion, &file [versionOffset], sizeof(footerVersion));
+	CHECK_EQUAL(version, footerVersion);
+}
+
+
+// The bytes a property takes in its record's property list.
+static uint64_t GetStoredSize(const SBinaryFbxProperty& property)
+{
+	switch (property.type)
+	{
+		case 'Y': return 1 + 2;
+		case 'C': return 1 + 1;
+		case 'I': case 'F': return 1 + 4;
+		case 'L': case 'D': return 1 + 8;
+		case 'S': case 'R': return 1 + 4 + property.size;
+	}
+
+	return 1 + 3 * 4 + property.size;
+}
+
+
+struct SPatchedRecord
+{
+	SFixtureLayout layout;
+	uint64_t storedPropertySize { 0 };
+	std::vector<std::string> strings;
+	std::vector<double> numbers;
+};
+
+
+// Keeps every record of the patched file, with its string and number properties.
+class PatchedFileVisitor : public BinaryFbxVisitor
+{
+public:
+	bool BeginRecord(const SBinaryFbxRecord& record) override
+	{
+		SPatchedRecord patched;
+		patched.layout.name = record.name;
+		patched.layout.depth = record.depth;
+		patched.layout.offset = record.offset;
+		patched.layout.endOffset = record.endOffset;
+		patched.layout.propertyCount = static_cast<uint32_t>(record.properties.size());
+
+		for (const auto& property : record.properties)
+		{
+			patched.storedPropertySize += GetStoredSize(property);
+			if (property.type == 'S')
+				patched.strings.push_back(property.GetString());
+			if (property.type == 'D')
+				patched.numbers.push_back(property.number);
+		}
+
+		records.push_back(patched);
+		return true;
+	}
+
+	// The strings of every record with the name, one after another.
+	std::vector<std::string> GetStrings(const std::string& name, size_t index) const
+	{
+		std::vector<std::string> strings;
+		for (const auto& record : records)
+		{
+			if ((record.layout.name == name) && (index < record.strings.size()))
+				strings.push_back(record.strings [index]);
+		}
+		return strings;
+	}
+
+	std::vector<SPatchedRecord> records;
+};
+
+
+// Every record's properties must fill the space up to its first child or its end, each child must start where the one
+// before ends, and a list of children must close with an empty record just before its parent's end.
+static void CheckRecordLayout(const std::string& file, const std::vector<SPatchedRecord>& records, uint32_t version, uint64_t recordsEnd)
+{
+	const uint64_t headerSize = GetFixtureRecordHeaderSize(version);
+	const size_t fieldSize = (version >= 7500) ? sizeof(uint64_t) : sizeof(uint32_t);
+	uint64_t expectedOffset = fixtureHeaderSize;
+	std::vector<uint64_t> parentEnds;
+
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const SFixtureLayout& layout = records [i].layout;
+
+		// Lists that ended before this record are closed by their empty record.
+		while (static_cast<int>(parentEnds.size()) > layout.depth)
+		{
+			CHECK_EQUAL(parentEnds.back(), expectedOffset + headerSize);
+			expectedOffset = parentEnds.back();
+			parentEnds.pop_back();
+		}
+
+		CHECK_EQUAL(expectedOffset, layout.offset);
+
+		// The property list size in the record's header is the third of its numbers.
+		uint64_t propertyListSize = 0;
+		memcpy(&propertyListSize, &file [static_cast<size_t>(layout.offset) + 2 * fieldSize], fieldSize);
+		CHECK_EQUAL(records [i].storedPropertySize, propertyListSize);
+
+		uint64_t propertyEnd = layout.offset + headerSize + layout.name.size() + records [i].storedPropertySize;
+		bool hasChildren = (i + 1 < records.size()) && (records [i + 1].layout.depth > layout.depth);
+		if (hasChildren)
+		{
+			CHECK_EQUAL(propertyEnd, records [i + 1].layout.offset);
+			parentEnds.push_back(layout.endOffset);
+		}
+		else
+		{
+			CHECK_EQUAL(propertyEnd, layout.endOffset);
+		}
+
+		expectedOffset = hasChildren ? propertyEnd : layout.endOffset;
+	}
+
+	while (!parentEnds.empty())
+	{
+		CHECK_EQUAL(parentEnds.back(), expectedOffset + headerSize);
+		expectedOffset = parentEnds.back();
+		parentEnds.pop_back();
+	}
+
+	CHECK_EQUAL(recordsEnd, expectedOffset);
+}
+
+
+// Read a patched file back and check its layout, its property list sizes against their properties, and its footer.
+static void ReadPatchedFile(const std::string& file, uint32_t version, PatchedFileVisitor& visitor)
+{
+	std::istringstream stream(file);
+	BinaryFbxReader reader(stream);
+	CHECK(reader.Read(visitor));
+	CHECK(reader.GetError().empty());
+	CHECK_EQUAL(version, reader.GetVersion());
+
+	uint64_t recordsEnd = 0;
+	for (const auto& record : visitor.records)
+	{
+		if (record.layout.depth == 0)
+			recordsEnd = record.layout.endOffset;
+	}
+	CheckRecordLayout(file, visitor.records, version, recordsEnd);
+
+	CheckFooter(file, version);
+}
+
+
+static void TestRenamesSkeleton(uint32_t version)
+{
+	SCharacterFixture character;
+	std::string input = WriteBinaryFbxFixture(MakeCharacterRecords(character), version);
+
+	// One name shrinks and is centred, one grows, one is left alone.
+	const std::string longSpineName = "Spine_With_A_Name_Much_Longer_Than_Before";
+	SBinaryPatchRequest request;
+	request.animationName = "Walk_Forward_Loop";
+	request.centredNames = { "Hips" };
+	request.renameSkeleton = [&](const std::string& name, std::string& newName)
+	{
+		if (name == "mixamorig:Hips")
+			newName = "Hips";
+		else if (name == "mixamorig:Spine")
+			newName = longSpineName;
+		else
+			return false;
+
+		return true;
+	};
+
+	SBinaryPatchInfo info;
+	std::string output;
+	CHECK_EQUAL(eBinaryPatchApplied, PatchFixture(input, request, info, output));
+	CHECK(info.reason.empty());
+	CHECK_EQUAL(std::string("mixamo.com"), info.oldName);
+	CHECK_EQUAL(2, info.renamedNodeCount);
+	CHECK(info.skeletonNames == character.boneNames);
+
+	PatchedFileVisitor visitor;
+	ReadPatchedFile(output, version, visitor);
+
+	// Only the nodes are renamed; their skeleton attributes and the mesh keep their names.
+	const std::string modelSuffix = std::string("\x00\x01", 2) + "Model";
+	std::vector<std::string> expectedModels = { "Hips" + modelSuffix, longSpineName + modelSuffix, "mixamorig:Head" + modelSuffix, "Body" + modelSuffix };
+	CHECK(visitor.GetStrings("Model", 0) == expectedModels);
+
+	const std::string attributeSuffix = std::string("\x00\x01", 2) + "NodeAttribute";
+	std::vector<std::string> expectedAttributes;
+	for (const auto& name : character.boneNames)
+		expectedAttributes.push_back(name + attributeSuffix);
+	CHECK(visitor.GetStrings("NodeAttribute", 0) == expectedAttributes);
+
+	CHECK(visitor.GetStrings("AnimationStack", 0) == std::vector<std::string> { "Walk_Forward_Loop" + std::string("\x00\x01", 2) + "AnimStack" });
+	CHECK(visitor.GetStrings("Current", 0) == std::vector<std::string> { "Walk_Forward_Loop" });
+	CHECK(visitor.GetStrings("Take", 0) == std::vector<std::string> { "Walk_Forward_Loop" });
+	CHECK(visitor.GetStrings("FileName", 0) == std::vector<std::string> { "Walk_Forward_Loop.tak" });
+
+	// The active stack is the fifth property of its P record.
+	bool hasActiveStack = false;
+	for (const auto& record : visitor.records)
+	{
+		if ((record.layout.name == "P") && (record.strings [0] == "ActiveAnimStackName"))
+			hasActiveStack = (record.strings.size() == 5) && (record.strings [4] == "Walk_Forward_Loop");
+	}
+	CHECK(hasActiveStack);
+
+	// Hips is centred on X and Z; the other bones keep their translations.
+	std::vector<std::vector<double>> translations;
+	for (const auto& record : visitor.records)
+	{
+		if ((record.layout.name == "P") && (record.strings [0] == "Lcl Translation"))
+			translations.push_back(record.numbers);
+	}
+	CHECK_EQUAL(size_t(4), translations.size());
+	if (translations.size() == 4)
+	{
+		CHECK((translations [0] == std::vector<double> { 0.0, 90.0, 0.0 }));
+		CHECK((translations [1] == std::vector<double> { 0.0, 10.0, 0.5 }));
+		CHECK((translations [2] == std::vector<double> { 0.0, 10.0, 0.5 }));
+	}
+
+	// Byte for byte what an exporter would write with the new names.
+	SCharacterFixture renamed;
+	renamed.animationName = "Walk_Forward_Loop";
+	renamed.boneNames = { "Hips", longSpineName, "mixamorig:Head" };
+	renamed.attributeNames = character.boneNames;
+	renamed.rootTranslation [0] = 0.0;
+	renamed.rootTranslation [2] = 0.0;
+	CHECK(output == WriteBinaryFbxFixture(MakeCharacterRecords(renamed), version));
+}
+
+
+// A full rig with every name patched, growing and shrinking in turn, so the end offsets of the records around each
+// change move by different amounts.
+static void TestRenamesLargeRig(uint32_t version)
+{
+	SCharacterFixture character;
+	SCharacterFixture renamed;
+	character.boneNames.clear();
+	renamed.boneNames.clear();
+	for (int i = 0; i < 200; i++)
+	{
+		character.boneNames.push_back("mixamorig:Joint" + std::to_string(i));
+		renamed.boneNames.push_back((i % 2 == 0) ? "J" + std::to_string(i) : "Character1_Joint_Number_" + std::to_string(i));
+	}
+	renamed.attributeNames = character.boneNames;
+	renamed.animationName = "m";
+
+	SBinaryPatchRequest request;
+	request.animationName = renamed.animationName;
+	request.renameSkeleton = [&](const std::string& name, std::string& newName)
+	{
+		int index = std::stoi(name.substr(strlen("mixamorig:Joint")));
+		newName = renamed.boneNames [index];
+		return true;
+	};
+
+	std::string input = WriteBinaryFbxFixture(MakeCharacterRecords(character), version);
+
+	SBinaryPatchInfo info;
+	std::string output;
+	CHECK_EQUAL(eBinaryPatchApplied, PatchFixture(input, request, info, output));
+	CHECK_EQUAL(200, info.renamedNodeCount);
+
+	PatchedFileVisitor visitor;
+	ReadPatchedFile(output, version, visitor);
+
+	std::vector<std::string> models = visitor.GetStrings("Model", 0);
+	CHECK_EQUAL(size_t(201), models.size());
+	for (size_t i = 0; (i < 200) && (i < models.size()); i++)
+		CHECK_EQUAL(renamed.boneNames [i] + std::string("\x00\x01", 2) + "Model", models [i]);
+
+	CHECK(output == WriteBinaryFbxFixture(MakeCharacterRecords(renamed), version));
+}
+
+
+// Only nodes renamed to a centred name are centred, not ones that already had it.
+static void TestCentresOnlyRenamedNodes(uint32_t version)
+{
+	SCharacterFixture character;
+	character.boneNames = { "Hips", "mixamorig:Spine" };
+	std::string input = WriteBinaryFbxFixture(MakeCharacterRecords(character), version);
+
+	SBinaryPatchRequest request;
+	request.animationName = "Idle";
+	request.centredNames = { "Hips" };
+	request.renameSkeleton = [](const std::string& name, std::string& newName)
+	{
+		newName = "Spine";
+		return name == "mixamorig:Spine";
+	};
+
+	SBinaryPatchInfo info;
+	std::string output;
+	CHECK_EQUAL(eBinaryPatchApplied, PatchFixture(input, request, info, output));
+
+	PatchedFileVisitor visitor;
+	ReadPatchedFile(output, version, visitor);
+
+	SCharacterFixture renamed = character;
+	renamed.animationName = "Idle";
+	renamed.boneNames = { "Hips", "Spine" };
+	renamed.attributeNames = character.boneNames;
+	CHECK(output == WriteBinaryFbxFixture(MakeCharacterRecords(renamed), version));
+}
+
+
+// A file patched over itself ends up the same as one patched to a new path.
+static void TestPatchesInPlace(uint32_t version)
+{
+	std::string input = WriteBinaryFbxFixture(MakeCharacterRecords(SCharacterFixture()), version);
+
+	SBinaryPatchRequest request;
+	request.animationName = "Run";
+
+	SBinaryPatchInfo info;
+	std::string expected;
+	CHECK_EQUAL(eBinaryPatchApplied, PatchFixture(input, request, info, expected));
+
+	std::filesystem::path path = GetTestPath("in-place");
+	WriteFile(path, input);
+	CHECK_EQUAL(eBinaryPatchApplied, PatchBinaryFbxNames(path.wstring(), path.wstring(), request, eFileSyncNone, info));
+	CHECK(ReadFile(path) == expected);
+	std::filesystem::remove(path);
+}
+
+
+// Files the patch can't handle are left for the FBX SDK, with nothing written.
+static void TestRefusesWhatItCantPatch(uint32_t version)
+{
+	SBinaryPatchRequest request;
+	request.animationName = "Run";
+
+	SBinaryPatchInfo info;
+	std::string output;
+	CHECK_EQUAL(eBinaryPatchUnsupported, PatchFixture("; FBX 7.4.0 project file\n", request, info, output));
+	CHECK(output.empty());
+
+	// No animation stack.
+	std::vector<SFixtureRecord> records = MakeCharacterRecords(SCharacterFixture());
+	for (auto& record : records)
+	{
+		if (record.name == "Objects")
+		{
+			record.children.erase(std::remove_if(record.children.begin(), record.children.end(),
+				[](const SFixtureRecord& child) { return child.name == "AnimationStack"; }), record.children.end());
+		}
+	}
+	info = SBinaryPatchInfo();
+	CHECK_EQUAL(eBinaryPatchUnsupported, PatchFixture(WriteBinaryFbxFixture(records, version), request, info, output));
+	CHECK_EQUAL(std::string("The file has no animation stack"), info.reason);
+	CHECK(output.empty());
+
+	// A name with a null in it.
+	std::string input = WriteBinaryFbxFixture(MakeCharacterRecords(SCharacterFixture()), version);
+	request.renameSkeleton = [](const std::string&, std::string& newName) { newName = std::string("Hips\0", 5); return true; };
+	info = SBinaryPatchInfo();
+	CHECK_EQUAL(eBinaryPatchUnsupported, PatchFixture(input, request, info, output));
+	CHECK(output.empty());
+
+	// A damaged file.
+	input.resize(input.size() / 2);
+	request.renameSkeleton = nullptr;
+	info = SBinaryPatchInfo();
+	CHECK_EQUAL(eBinaryPatchUnsupported, PatchFixture(input, request, info, output));
+	CHECK(!info.reason.empty());
+	CHECK(output.empty());
+}
+
+
+static void TestKeepsFooterAligned(uint32_t version)
+{
+	std::string input = WriteBinaryFbxFixture(MakeCharacterRecords(SCharacterFixture()), version);
+	CheckFooter(input, version);
+
+	// The animation name is stored in five places, so names of 16 lengths move the end of the records by every amount
+	// modulo 16, both shorter and longer.
+	for (size_t length = 1; length <= 16; length++)
+	{
+		SCharacterFixture character;
+		character.animationName = std::string(length, 'a');
+
+		SBinaryPatchRequest request;
+		request.animationName = character.animationName;
+
+		SBinaryPatchInfo info;
+		std::string output;
+		CHECK_EQUAL(eBinaryPatchApplied, PatchFixture(input, request, info, output));
+		CheckFooter(output, version);
+
+		// Nothing but the name has changed, so the file is what an exporter would have written with that name.
+		CHECK(output == WriteBinaryFbxFixture(MakeCharacterRecords(character), version));
+	}
+}
+
+
+// The patch hashes the input as it copies it, and the hash is the one HashFile gives, so a bulk run can record it
+// without reading the file again. The rig is large enough to take more than one copy buffer.
+static void TestHashesInput(uint32_t version)
+{
+	SCharacterFixture character;
+	character.boneNames.clear();
+	for (int i = 0; i < 5000; i++)
+		character.boneNames.push_back("mixamorig:Bone" + std::to_string(i));
+
+	std::string input = WriteBinaryFbxFixture(MakeCharacterRecords(character), version);
+	CHECK(input.size() > (1 << 20));
+
+	std::filesystem::path path = GetTestPath("hashed");
+	WriteFile(path, input);
+	uint64_t fileHash = 0;
+	CHECK(HashFile(path.wstring(), fileHash));
+	std::filesystem::remove(path);
+
+	SBinaryPatchRequest request;
+	request.animationName = "Run";
+	request.renameSkeleton = [](const std::string& name, std::string& newName) { newName = name.substr(10); return true; };
+	request.centredNames.insert("Bone0");
+
+	SBinaryPatchInfo info;
+	std::string output;
+	CHECK_EQUAL(eBinaryPatchApplied, PatchFixture(input, request, info, output));
+	CHECK(info.hasContentHash);
+	CHECK_EQUAL(fileHash, info.contentHash);
+	CHECK_EQUAL(HashString(input), info.contentHash);
+}
+
+
+int main()
+{
+	for (uint32_t version : testedVersions)
+	{
+		TestRenamesSkeleton(version);
+		TestRenamesLargeRig(version);
+		TestCentresOnlyRenamedNodes(version);
+		TestPatchesInPlace(version);
+		TestRefusesWhatItCantPatch(version);
+		TestKeepsFooterAligned(version);
+		TestHashesInput(version);
+	}
+
+	return FinishTests("BinaryFbxPatchTest");
+}
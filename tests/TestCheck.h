@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+
+// The checks that failed in this test program. main returns whether there were any.
+inline int gFailedCheckCount = 0;
+
+inline void ReportFailedCheck(const char* pFile, int line, const std::string& what)
+{
+	std::fprintf(stderr, "%s(%d): check failed: %s\n", pFile, line, what.c_str());
+	gFailedCheckCount++;
+}
+
+// Test functions carry on past a failed check, so one run reports every problem.
+#define CHECK(condition) \
+	do { if (!(condition)) ReportFailedCheck(__FILE__, __LINE__, #condition); } while (false)
+
+#define CHECK_EQUAL(expected, actual) \
+	do { if (!((expected) == (actual))) ReportFailedCheck(__FILE__, __LINE__, #actual " == " #expected); } while (false)
+
+inline int FinishTests(const char* pName)
+{
+	if (gFailedCheckCount > 0)
+		std::fprintf(stderr, "%s: %d checks failed.\n", pName, gFailedCheckCount);
+	else
+		std::printf("%s: all checks passed.\n", pName);
+
+	return (gFailedCheckCount > 0) ? 1 : 0;
+}